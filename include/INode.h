@@ -44,12 +44,14 @@ struct OutsForAmount {
 struct TransactionShortInfo {
   Crypto::Hash txId;
   TransactionPrefix txPrefix;
+  std::vector<uint32_t> globalIndexes; // empty if the node did not send them
 };
 
 struct BlockShortEntry {
   Crypto::Hash blockHash;
   bool hasBlock;
   CryptoNote::Block block;
+  std::vector<uint32_t> baseTransactionGlobalIndexes; // empty if the node did not send them
   std::vector<TransactionShortInfo> txsShortInfo;
 };
 
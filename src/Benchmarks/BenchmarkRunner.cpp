@@ -0,0 +1,90 @@
+// Copyright (c) 2011-2017 The Cryptonote developers
+// Copyright (c) 2017-2018 The Circle Foundation & Conceal Devs
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "BenchmarkRunner.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+#include "Serialization/SerializationOverloads.h"
+
+namespace CryptoNote {
+
+void BenchmarkResult::serialize(ISerializer& s) {
+  KV_MEMBER(name)
+  KV_MEMBER(operationsPerSample)
+  KV_MEMBER(samples)
+  KV_MEMBER(nanosecondsPerOperation)
+  KV_MEMBER(minNanosecondsPerOperation)
+  KV_MEMBER(maxNanosecondsPerOperation)
+}
+
+void BenchmarkReport::serialize(ISerializer& s) {
+  KV_MEMBER(samples)
+  KV_MEMBER(minSampleMilliseconds)
+  KV_MEMBER(results)
+}
+
+BenchmarkRunner::BenchmarkRunner(const std::string& filter, uint64_t samples, uint64_t minSampleMilliseconds) : filter(filter) {
+  report.samples = std::max<uint64_t>(samples, 1);
+  report.minSampleMilliseconds = minSampleMilliseconds;
+}
+
+bool BenchmarkRunner::isSelected(const std::string& name) const {
+  return name.find(filter) != std::string::npos;
+}
+
+void BenchmarkRunner::run(const std::string& name, const Body& body, uint64_t operationsPerIteration) {
+  if (!isSelected(name)) {
+    return;
+  }
+
+  const double minSampleTime = static_cast<double>(report.minSampleMilliseconds) * 1e6;
+  uint64_t iterations = 1;
+  for (;;) {
+    double time = measure(body, iterations);
+    if (time >= minSampleTime) {
+      break;
+    }
+
+    // jump close to the target once the time is big enough to extrapolate from
+    uint64_t factor = time * 10 < minSampleTime ? 2 : static_cast<uint64_t>(minSampleTime / std::max(time, 1.0) * 1.2) + 1;
+    iterations *= std::max<uint64_t>(factor, 2);
+  }
+
+  std::vector<double> times;
+  for (uint64_t i = 0; i < report.samples; ++i) {
+    times.push_back(measure(body, iterations) / static_cast<double>(iterations * operationsPerIteration));
+  }
+
+  std::sort(times.begin(), times.end());
+
+  BenchmarkResult result;
+  result.name = name;
+  result.operationsPerSample = iterations * operationsPerIteration;
+  result.samples = times.size();
+  result.nanosecondsPerOperation = times[times.size() / 2];
+  result.minNanosecondsPerOperation = times.front();
+  result.maxNanosecondsPerOperation = times.back();
+  report.results.push_back(result);
+
+  std::cerr << std::left << std::setw(48) << name << std::right << std::fixed << std::setprecision(1) <<
+    std::setw(16) << result.nanosecondsPerOperation << " ns/op" << std::endl;
+}
+
+const BenchmarkReport& BenchmarkRunner::getReport() const {
+  return report;
+}
+
+double BenchmarkRunner::measure(const Body& body, uint64_t iterations) const {
+  auto start = std::chrono::steady_clock::now();
+  body(iterations);
+  return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+}
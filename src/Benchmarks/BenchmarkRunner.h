@@ -0,0 +1,78 @@
+// Copyright (c) 2011-2017 The Cryptonote developers
+// Copyright (c) 2017-2018 The Circle Foundation & Conceal Devs
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "Serialization/ISerializer.h"
+
+namespace CryptoNote {
+
+struct BenchmarkResult {
+  std::string name;
+  uint64_t operationsPerSample;
+  uint64_t samples;
+  double nanosecondsPerOperation; // median of the samples
+  double minNanosecondsPerOperation;
+  double maxNanosecondsPerOperation;
+
+  void serialize(ISerializer& s);
+};
+
+struct BenchmarkReport {
+  uint64_t samples;
+  uint64_t minSampleMilliseconds;
+  std::vector<BenchmarkResult> results;
+
+  void serialize(ISerializer& s);
+};
+
+// Runs a benchmark body with an iteration count that is doubled until one
+// sample takes at least the minimal sample time, then takes the configured
+// number of samples with that count and keeps their median.
+class BenchmarkRunner {
+public:
+  // A benchmark body runs 'iterations' times whatever it measures.
+  typedef std::function<void(uint64_t iterations)> Body;
+
+  BenchmarkRunner(const std::string& filter, uint64_t samples, uint64_t minSampleMilliseconds);
+
+  // Benchmarks whose name doesn't contain the filter are skipped, so their
+  // setup can be skipped as well.
+  bool isSelected(const std::string& name) const;
+  // 'operationsPerIteration' is for bodies doing several operations at once,
+  // e.g. hashing a batch; results are always given per operation.
+  void run(const std::string& name, const Body& body, uint64_t operationsPerIteration = 1);
+
+  const BenchmarkReport& getReport() const;
+
+private:
+  double measure(const Body& body, uint64_t iterations) const;
+
+  std::string filter;
+  BenchmarkReport report;
+};
+
+// Keeps the compiler from dropping a computation whose result is unused.
+template<typename T>
+inline void keepResult(const T& value) {
+#if defined(__GNUC__)
+  asm volatile("" : : "r"(&value) : "memory");
+#else
+  static const void* volatile sink;
+  sink = &value;
+#endif
+}
+
+void addCryptoBenchmarks(BenchmarkRunner& runner);
+void addSerializationBenchmarks(BenchmarkRunner& runner);
+void addContainerBenchmarks(BenchmarkRunner& runner, const std::string& directory);
+
+}
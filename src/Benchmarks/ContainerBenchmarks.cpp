@@ -0,0 +1,245 @@
+// Copyright (c) 2011-2017 The Cryptonote developers
+// Copyright (c) 2017-2018 The Circle Foundation & Conceal Devs
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "BenchmarkRunner.h"
+
+#include <boost/filesystem.hpp>
+
+#include "Common/FileMappedVector.h"
+#include "Common/PathTools.h"
+#include "CryptoNoteConfig.h"
+#include "CryptoNoteCore/CryptoNoteSerialization.h"
+#include "CryptoNoteCore/MappedBlobVector.h"
+#include "CryptoNoteCore/SwappedVector.h"
+
+namespace CryptoNote {
+
+namespace {
+
+const uint64_t HASH_COUNT = 100000;
+const uint64_t BLOCK_COUNT = 2000;
+const uint64_t BLOCK_TRANSACTION_COUNT = 20;
+// Blockchain opens its block files with a pool of 1024 items
+const size_t POOL_SIZE = 1024;
+// reads near the chain top, which is what a synchronized node mostly does
+const uint64_t HOT_BLOCK_COUNT = 256;
+
+// A fixed sequence of indexes, the same on every run.
+class IndexSequence {
+public:
+  IndexSequence(uint64_t count) : count(count), state(0x2545F4914F6CDD1DULL) {
+  }
+
+  uint64_t next() {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (state >> 33) % count;
+  }
+
+private:
+  uint64_t count;
+  uint64_t state;
+};
+
+template<typename T>
+T makePod(uint64_t seed) {
+  T value;
+  uint8_t* data = reinterpret_cast<uint8_t*>(&value);
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    data[i] = static_cast<uint8_t>((seed + 1) * 2654435761u >> (i % 4 * 8) ^ i);
+  }
+
+  return value;
+}
+
+Crypto::Hash makeHash(uint64_t seed) {
+  return makePod<Crypto::Hash>(seed);
+}
+
+Block makeBlock(uint64_t seed) {
+  Block block;
+  block.majorVersion = BLOCK_MAJOR_VERSION_1;
+  block.minorVersion = 0;
+  block.nonce = static_cast<uint32_t>(seed);
+  block.timestamp = 1500000000 + seed * 120;
+  block.previousBlockHash = makeHash(seed);
+  block.baseTransaction.version = TRANSACTION_VERSION_1;
+  block.baseTransaction.unlockTime = seed + 10;
+  block.baseTransaction.inputs.push_back(BaseInput{static_cast<uint32_t>(seed)});
+  block.baseTransaction.signatures.emplace_back();
+  KeyOutput target;
+  target.key = makePod<Crypto::PublicKey>(seed + 1);
+  block.baseTransaction.outputs.push_back({6000000, target});
+  for (uint64_t i = 0; i < BLOCK_TRANSACTION_COUNT; ++i) {
+    block.transactionHashes.push_back(makeHash(seed * 1000 + i));
+  }
+
+  return block;
+}
+
+// The setup of a group is too slow to do for nothing.
+bool isAnySelected(const BenchmarkRunner& runner, const std::string& group, const std::vector<std::string>& names) {
+  for (const std::string& name : names) {
+    if (runner.isSelected(group + "/" + name)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void removeFiles(const std::vector<std::string>& paths) {
+  boost::system::error_code ignore;
+  for (const std::string& path : paths) {
+    boost::filesystem::remove(path, ignore);
+  }
+}
+
+void addFileMappedVectorBenchmarks(BenchmarkRunner& runner, const std::string& directory) {
+  if (!isAnySelected(runner, "FileMappedVector", {"push_back", "sequential_read", "random_read"})) {
+    return;
+  }
+
+  std::string path = Common::CombinePath(directory, "hashes.bin");
+  removeFiles({path});
+  {
+    Common::FileMappedVector<Crypto::Hash> hashes(path, Common::FileMappedVectorOpenMode::CREATE);
+    uint64_t seed = 0;
+    runner.run("FileMappedVector/push_back", [&](uint64_t iterations) {
+      for (uint64_t i = 0; i < iterations; ++i) {
+        if (hashes.size() == HASH_COUNT) {
+          hashes.clear();
+        }
+
+        hashes.push_back(makeHash(seed++));
+      }
+    });
+
+    while (hashes.size() < HASH_COUNT) {
+      hashes.push_back(makeHash(seed++));
+    }
+
+    runner.run("FileMappedVector/sequential_read", [&](uint64_t iterations) {
+      for (uint64_t i = 0; i < iterations; ++i) {
+        keepResult(hashes[i % HASH_COUNT]);
+      }
+    });
+
+    IndexSequence indexes(HASH_COUNT);
+    runner.run("FileMappedVector/random_read", [&](uint64_t iterations) {
+      for (uint64_t i = 0; i < iterations; ++i) {
+        keepResult(hashes[indexes.next()]);
+      }
+    });
+  }
+
+  removeFiles({path});
+}
+
+// The block containers share an interface, so one template measures both.
+// Every read goes through operator[], which has to deserialize a block
+// whenever it isn't in the pool.
+template<typename Vector>
+void addBlockVectorBenchmarks(BenchmarkRunner& runner, const std::string& name, const std::string& directory, Vector& blocks) {
+  if (!isAnySelected(runner, name, {"push_back", "sequential_read", "random_read_hot", "random_read"})) {
+    return;
+  }
+
+  std::string itemsPath = Common::CombinePath(directory, name + ".items");
+  std::string indexesPath = Common::CombinePath(directory, name + ".indexes");
+  std::vector<std::string> paths = {itemsPath, indexesPath, indexesPath + ".offsets"};
+  removeFiles(paths);
+  if (!blocks.open(itemsPath, indexesPath, POOL_SIZE)) {
+    throw std::runtime_error("Failed to open " + itemsPath);
+  }
+
+  std::vector<Block> source;
+  for (uint64_t i = 0; i < BLOCK_COUNT; ++i) {
+    source.push_back(makeBlock(i));
+  }
+
+  runner.run(name + "/push_back", [&](uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; ++i) {
+      if (blocks.size() == BLOCK_COUNT) {
+        blocks.clear();
+      }
+
+      blocks.push_back(source[blocks.size()]);
+    }
+  });
+
+  while (blocks.size() < BLOCK_COUNT) {
+    blocks.push_back(source[blocks.size()]);
+  }
+
+  runner.run(name + "/sequential_read", [&](uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; ++i) {
+      keepResult(blocks[i % BLOCK_COUNT]);
+    }
+  });
+
+  IndexSequence hotIndexes(HOT_BLOCK_COUNT);
+  runner.run(name + "/random_read_hot", [&](uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; ++i) {
+      keepResult(blocks[BLOCK_COUNT - 1 - hotIndexes.next()]);
+    }
+  });
+
+  IndexSequence indexes(BLOCK_COUNT);
+  runner.run(name + "/random_read", [&](uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; ++i) {
+      keepResult(blocks[indexes.next()]);
+    }
+  });
+
+  blocks.close();
+  removeFiles(paths);
+}
+
+}
+
+void addContainerBenchmarks(BenchmarkRunner& runner, const std::string& directory) {
+  addFileMappedVectorBenchmarks(runner, directory);
+
+  {
+    SwappedVector<Block> blocks;
+    addBlockVectorBenchmarks(runner, "SwappedVector", directory, blocks);
+  }
+
+  {
+    MappedBlobVector<Block> blocks;
+    addBlockVectorBenchmarks(runner, "MappedBlobVector", directory, blocks);
+  }
+
+  if (runner.isSelected("MappedBlobVector/getBlob")) {
+    std::string itemsPath = Common::CombinePath(directory, "blobs.items");
+    std::string indexesPath = Common::CombinePath(directory, "blobs.indexes");
+    std::vector<std::string> paths = {itemsPath, indexesPath, indexesPath + ".offsets"};
+    removeFiles(paths);
+    {
+      MappedBlobVector<Block> blocks;
+      if (!blocks.open(itemsPath, indexesPath, POOL_SIZE)) {
+        throw std::runtime_error("Failed to open " + itemsPath);
+      }
+
+      for (uint64_t i = 0; i < BLOCK_COUNT; ++i) {
+        blocks.push_back(makeBlock(i));
+      }
+
+      // the raw bytes, as the relay and the RPC handlers take them
+      IndexSequence indexes(BLOCK_COUNT);
+      runner.run("MappedBlobVector/getBlob", [&](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+          Common::ArrayView<uint8_t> blob = blocks.getBlob(indexes.next());
+          keepResult(blob);
+        }
+      });
+    }
+
+    removeFiles(paths);
+  }
+}
+
+}
@@ -0,0 +1,216 @@
+// Copyright (c) 2011-2017 The Cryptonote developers
+// Copyright (c) 2017-2018 The Circle Foundation & Conceal Devs
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "BenchmarkRunner.h"
+
+#include <array>
+
+#include "crypto/crypto.h"
+#include "crypto/hash.h"
+
+using namespace Crypto;
+
+namespace CryptoNote {
+
+namespace {
+
+typedef void (*SlowHash)(cn_context&, const void*, size_t, Hash&);
+typedef void (*SlowHashMulti)(cn_context&, const void* const*, const size_t*, Hash*, size_t);
+
+// a block hashing blob is about this long
+const size_t HASHING_BLOB_SIZE = 76;
+const size_t RING_SIZE = 11;
+const size_t RING_BATCH_SIZE = 16;
+
+std::vector<uint8_t> makeData(size_t size) {
+  std::vector<uint8_t> data(size);
+  for (size_t i = 0; i < size; ++i) {
+    data[i] = static_cast<uint8_t>(i * 7 + 1);
+  }
+
+  return data;
+}
+
+void addSlowHash(BenchmarkRunner& runner, const std::string& name, SlowHash hash) {
+  if (!runner.isSelected(name)) {
+    return;
+  }
+
+  cn_context context;
+  std::vector<uint8_t> data = makeData(HASHING_BLOB_SIZE);
+  runner.run(name, [&](uint64_t iterations) {
+    Hash result;
+    for (uint64_t i = 0; i < iterations; ++i) {
+      data[0] = static_cast<uint8_t>(i);
+      hash(context, data.data(), data.size(), result);
+      keepResult(result);
+    }
+  });
+}
+
+void addSlowHashMulti(BenchmarkRunner& runner, const std::string& name, SlowHashMulti hash, size_t lanes) {
+  if (!runner.isSelected(name)) {
+    return;
+  }
+
+  cn_context context(lanes);
+  std::vector<std::vector<uint8_t>> data(lanes, makeData(HASHING_BLOB_SIZE));
+  std::vector<const void*> dataPointers;
+  std::vector<size_t> sizes;
+  for (size_t lane = 0; lane < lanes; ++lane) {
+    data[lane][1] = static_cast<uint8_t>(lane);
+    dataPointers.push_back(data[lane].data());
+    sizes.push_back(data[lane].size());
+  }
+
+  runner.run(name, [&](uint64_t iterations) {
+    std::vector<Hash> results(lanes);
+    for (uint64_t i = 0; i < iterations; ++i) {
+      data[0][0] = static_cast<uint8_t>(i);
+      hash(context, dataPointers.data(), sizes.data(), results.data(), lanes);
+      keepResult(results[0]);
+    }
+  }, lanes);
+}
+
+void addFastHash(BenchmarkRunner& runner, size_t size) {
+  std::vector<uint8_t> data = makeData(size);
+  runner.run("cn_fast_hash/" + std::to_string(size), [&](uint64_t iterations) {
+    Hash result;
+    for (uint64_t i = 0; i < iterations; ++i) {
+      data[0] = static_cast<uint8_t>(i);
+      cn_fast_hash(data.data(), data.size(), result);
+      keepResult(result);
+    }
+  });
+}
+
+void addTreeHash(BenchmarkRunner& runner, size_t count) {
+  std::vector<Hash> hashes(count);
+  for (size_t i = 0; i < count; ++i) {
+    cn_fast_hash(&i, sizeof(i), hashes[i]);
+  }
+
+  runner.run("tree_hash/" + std::to_string(count), [&](uint64_t iterations) {
+    Hash root;
+    for (uint64_t i = 0; i < iterations; ++i) {
+      tree_hash(hashes.data(), hashes.size(), root);
+      keepResult(root);
+    }
+  });
+}
+
+struct Ring {
+  Hash prefixHash;
+  KeyImage image;
+  std::array<PublicKey, RING_SIZE> keys;
+  std::array<const PublicKey*, RING_SIZE> keyPointers;
+  std::array<Signature, RING_SIZE> signatures;
+};
+
+void makeRing(Ring& ring, size_t seed) {
+  cn_fast_hash(&seed, sizeof(seed), ring.prefixHash);
+  SecretKey realSecretKey;
+  size_t realIndex = seed % RING_SIZE;
+  for (size_t i = 0; i < RING_SIZE; ++i) {
+    SecretKey secretKey;
+    generate_keys(ring.keys[i], secretKey);
+    if (i == realIndex) {
+      realSecretKey = secretKey;
+    }
+
+    ring.keyPointers[i] = &ring.keys[i];
+  }
+
+  generate_key_image(ring.keys[realIndex], realSecretKey, ring.image);
+  generate_ring_signature(ring.prefixHash, ring.image, ring.keyPointers.data(), RING_SIZE, realSecretKey, realIndex, ring.signatures.data());
+}
+
+void addRingSignatures(BenchmarkRunner& runner) {
+  std::vector<Ring> rings(RING_BATCH_SIZE);
+  for (size_t i = 0; i < rings.size(); ++i) {
+    makeRing(rings[i], i);
+  }
+
+  runner.run("check_ring_signature/" + std::to_string(RING_SIZE), [&](uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; ++i) {
+      const Ring& ring = rings[i % rings.size()];
+      if (!check_ring_signature(ring.prefixHash, ring.image, ring.keyPointers.data(), RING_SIZE, ring.signatures.data())) {
+        throw std::runtime_error("check_ring_signature failed");
+      }
+    }
+  });
+
+  std::vector<RingSignatureBatchItem> batch;
+  for (const Ring& ring : rings) {
+    batch.push_back({&ring.prefixHash, &ring.image, ring.keyPointers.data(), RING_SIZE, ring.signatures.data()});
+  }
+
+  runner.run("check_ring_signatures/" + std::to_string(RING_SIZE) + "x" + std::to_string(RING_BATCH_SIZE), [&](uint64_t iterations) {
+    bool results[RING_BATCH_SIZE];
+    for (uint64_t i = 0; i < iterations; ++i) {
+      check_ring_signatures(batch.data(), batch.size(), results);
+      keepResult(results);
+    }
+  }, RING_BATCH_SIZE);
+}
+
+void addKeyDerivation(BenchmarkRunner& runner) {
+  PublicKey txPublicKey;
+  SecretKey txSecretKey;
+  PublicKey spendPublicKey;
+  SecretKey spendSecretKey;
+  SecretKey viewSecretKey;
+  PublicKey viewPublicKey;
+  generate_keys(txPublicKey, txSecretKey);
+  generate_keys(spendPublicKey, spendSecretKey);
+  generate_keys(viewPublicKey, viewSecretKey);
+
+  runner.run("generate_key_derivation", [&](uint64_t iterations) {
+    KeyDerivation derivation;
+    for (uint64_t i = 0; i < iterations; ++i) {
+      generate_key_derivation(txPublicKey, viewSecretKey, derivation);
+      keepResult(derivation);
+    }
+  });
+
+  KeyDerivation derivation;
+  generate_key_derivation(txPublicKey, viewSecretKey, derivation);
+  PublicKey outputKey;
+  derive_public_key(derivation, 0, spendPublicKey, outputKey);
+
+  runner.run("underive_public_key", [&](uint64_t iterations) {
+    PublicKey base;
+    for (uint64_t i = 0; i < iterations; ++i) {
+      underive_public_key(derivation, 0, outputKey, base);
+      keepResult(base);
+    }
+  });
+}
+
+}
+
+void addCryptoBenchmarks(BenchmarkRunner& runner) {
+  addSlowHash(runner, "cn_slow_hash", cn_slow_hash);
+  addSlowHash(runner, "cn_fast_slow_hash_v1", cn_fast_slow_hash_v1);
+  addSlowHash(runner, "cn_conceal_slow_hash_v0", cn_conceal_slow_hash_v0);
+  addSlowHash(runner, "cn_cache_slow_hash_v0", cn_cache_slow_hash_v0);
+  addSlowHashMulti(runner, "cn_slow_hash_multi/2", cn_slow_hash_multi, 2);
+  addSlowHashMulti(runner, "cn_cache_slow_hash_v0_multi/2", cn_cache_slow_hash_v0_multi, 2);
+  addSlowHashMulti(runner, "cn_cache_slow_hash_v0_multi/4", cn_cache_slow_hash_v0_multi, 4);
+
+  addFastHash(runner, 32);
+  addFastHash(runner, HASHING_BLOB_SIZE);
+  addFastHash(runner, 4096);
+  addTreeHash(runner, 2);
+  addTreeHash(runner, 64);
+  addTreeHash(runner, 1024);
+
+  addRingSignatures(runner);
+  addKeyDerivation(runner);
+}
+
+}
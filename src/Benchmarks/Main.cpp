@@ -0,0 +1,98 @@
+// Copyright (c) 2011-2017 The Cryptonote developers
+// Copyright (c) 2017-2018 The Circle Foundation & Conceal Devs
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <fstream>
+#include <iostream>
+
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+#include "BenchmarkRunner.h"
+#include "Common/CommandLine.h"
+#include "Common/ScopeExit.h"
+#include "Serialization/SerializationTools.h"
+
+namespace po = boost::program_options;
+using namespace CryptoNote;
+
+namespace {
+  const command_line::arg_descriptor<std::string> arg_filter     = {"filter", "Run only the benchmarks whose name contains this text", ""};
+  const command_line::arg_descriptor<uint64_t>    arg_samples    = {"samples", "Samples taken of every benchmark, the median is reported", 5};
+  const command_line::arg_descriptor<uint64_t>    arg_min_time   = {"min-time", "Minimal duration of a sample, in milliseconds", 200};
+  const command_line::arg_descriptor<std::string> arg_output     = {"output", "File to write the JSON report to. Default: standard output", ""};
+  const command_line::arg_descriptor<std::string> arg_data_dir   = {"data-dir", "Directory for the container benchmark files. Default: a new temporary directory", ""};
+}
+
+int main(int argc, char* argv[]) {
+  po::options_description desc_general("General options");
+  command_line::add_arg(desc_general, command_line::arg_help);
+  po::options_description desc_params("Benchmark options");
+  command_line::add_arg(desc_params, arg_filter);
+  command_line::add_arg(desc_params, arg_samples);
+  command_line::add_arg(desc_params, arg_min_time);
+  command_line::add_arg(desc_params, arg_output);
+  command_line::add_arg(desc_params, arg_data_dir);
+
+  po::options_description desc_all;
+  desc_all.add(desc_general).add(desc_params);
+
+  po::variables_map vm;
+  bool r = command_line::handle_error_helper(desc_all, [&]() {
+    po::store(command_line::parse_command_line(argc, argv, desc_general, true), vm);
+    if (command_line::get_arg(vm, command_line::arg_help)) {
+      std::cout << desc_all << std::endl;
+      return false;
+    }
+
+    po::store(command_line::parse_command_line(argc, argv, desc_params, false), vm);
+    po::notify(vm);
+    return true;
+  });
+
+  if (!r) {
+    return 1;
+  }
+
+  boost::filesystem::path directory = command_line::get_arg(vm, arg_data_dir);
+  bool temporaryDirectory = directory.empty();
+  if (temporaryDirectory) {
+    directory = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("benchmarks-%%%%-%%%%");
+  }
+
+  // also removes the temporary directory when a benchmark fails
+  Tools::ScopeExit directoryRemover([&directory, temporaryDirectory] {
+    if (temporaryDirectory) {
+      boost::system::error_code ignore;
+      boost::filesystem::remove_all(directory, ignore);
+    }
+  });
+
+  BenchmarkRunner runner(command_line::get_arg(vm, arg_filter), command_line::get_arg(vm, arg_samples), command_line::get_arg(vm, arg_min_time));
+  try {
+    boost::filesystem::create_directories(directory);
+    addCryptoBenchmarks(runner);
+    addSerializationBenchmarks(runner);
+    addContainerBenchmarks(runner, directory.string());
+  } catch (const std::exception& e) {
+    std::cerr << "Benchmark failed: " << e.what() << std::endl;
+    return 1;
+  }
+
+  std::string report = storeToJson(runner.getReport());
+  std::string output = command_line::get_arg(vm, arg_output);
+  if (output.empty()) {
+    std::cout << report << std::endl;
+  } else {
+    std::ofstream file(output, std::ios::binary);
+    file << report << std::endl;
+    if (!file) {
+      std::cerr << "Failed to write " << output << std::endl;
+      return 1;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,216 @@
+// Copyright (c) 2011-2017 The Cryptonote developers
+// Copyright (c) 2017-2018 The Circle Foundation & Conceal Devs
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "BenchmarkRunner.h"
+
+#include "Common/JsonValue.h"
+#include "CryptoNoteConfig.h"
+#include "CryptoNoteCore/CryptoNoteTools.h"
+#include "CryptoNoteCore/TransactionExtra.h"
+#include "CryptoNoteProtocol/CryptoNoteProtocolDefinitions.h"
+#include "Serialization/SerializationTools.h"
+
+namespace CryptoNote {
+
+namespace {
+
+const size_t INPUT_COUNT = 4;
+const size_t RING_SIZE = 11;
+const size_t OUTPUT_COUNT = 2;
+const size_t BLOCK_TRANSACTION_COUNT = 100;
+const size_t SYNC_BLOCK_COUNT = 20;
+const size_t SYNC_BLOCK_TRANSACTION_COUNT = 10;
+
+// Fills a POD with bytes that depend on 'seed', so nothing compresses or
+// repeats in an unusual way.
+template<typename T>
+T makePod(uint64_t seed) {
+  T value;
+  uint8_t* data = reinterpret_cast<uint8_t*>(&value);
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    data[i] = static_cast<uint8_t>((seed + 1) * 2654435761u >> (i % 4 * 8) ^ i);
+  }
+
+  return value;
+}
+
+// A transaction the size of a usual transfer: a few ring inputs, two outputs
+// and a transaction public key in extra.
+Transaction makeTransaction(uint64_t seed) {
+  Transaction transaction;
+  transaction.version = TRANSACTION_VERSION_1;
+  transaction.unlockTime = 0;
+  for (size_t i = 0; i < INPUT_COUNT; ++i) {
+    KeyInput input;
+    input.amount = 1000000 * (i + 1);
+    for (size_t j = 0; j < RING_SIZE; ++j) {
+      input.outputIndexes.push_back(static_cast<uint32_t>(seed * 31 + i * 17 + j * 1009));
+    }
+
+    input.keyImage = makePod<Crypto::KeyImage>(seed * INPUT_COUNT + i);
+    transaction.inputs.push_back(input);
+    transaction.signatures.emplace_back();
+    for (size_t j = 0; j < RING_SIZE; ++j) {
+      transaction.signatures.back().push_back(makePod<Crypto::Signature>(seed * 1000 + i * RING_SIZE + j));
+    }
+  }
+
+  for (size_t i = 0; i < OUTPUT_COUNT; ++i) {
+    KeyOutput target;
+    target.key = makePod<Crypto::PublicKey>(seed * OUTPUT_COUNT + i);
+    transaction.outputs.push_back({2000000 * (i + 1), target});
+  }
+
+  Crypto::PublicKey transactionKey = makePod<Crypto::PublicKey>(seed);
+  transaction.extra.push_back(TX_EXTRA_TAG_PUBKEY);
+  transaction.extra.insert(transaction.extra.end(), transactionKey.data, transactionKey.data + sizeof(transactionKey.data));
+  return transaction;
+}
+
+Block makeBlock(uint64_t seed, size_t transactionCount) {
+  Block block;
+  block.majorVersion = BLOCK_MAJOR_VERSION_1;
+  block.minorVersion = 0;
+  block.nonce = static_cast<uint32_t>(seed);
+  block.timestamp = 1500000000 + seed * 120;
+  block.previousBlockHash = makePod<Crypto::Hash>(seed);
+
+  Transaction& base = block.baseTransaction;
+  base.version = TRANSACTION_VERSION_1;
+  base.unlockTime = seed + 10;
+  base.inputs.push_back(BaseInput{static_cast<uint32_t>(seed)});
+  base.signatures.emplace_back();
+  KeyOutput target;
+  target.key = makePod<Crypto::PublicKey>(seed + 1);
+  base.outputs.push_back({6000000, target});
+  base.extra.assign(33, static_cast<uint8_t>(seed));
+
+  for (size_t i = 0; i < transactionCount; ++i) {
+    block.transactionHashes.push_back(makePod<Crypto::Hash>(seed * 1000 + i));
+  }
+
+  return block;
+}
+
+// What a peer sends while the chain synchronizes.
+NOTIFY_RESPONSE_GET_OBJECTS_request makeSyncResponse() {
+  NOTIFY_RESPONSE_GET_OBJECTS_request response;
+  for (size_t i = 0; i < SYNC_BLOCK_COUNT; ++i) {
+    block_complete_entry entry;
+    entry.block = Common::asString(toBinaryArray(makeBlock(i, SYNC_BLOCK_TRANSACTION_COUNT)));
+    for (size_t j = 0; j < SYNC_BLOCK_TRANSACTION_COUNT; ++j) {
+      entry.txs.push_back(Common::asString(toBinaryArray(makeTransaction(i * SYNC_BLOCK_TRANSACTION_COUNT + j))));
+    }
+
+    response.blocks.push_back(entry);
+  }
+
+  response.current_blockchain_height = 100000;
+  return response;
+}
+
+template<typename T>
+void addBinaryRoundTrip(BenchmarkRunner& runner, const std::string& name, const T& object) {
+  runner.run("binary/" + name + "/store", [&](uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; ++i) {
+      BinaryArray data = toBinaryArray(object);
+      keepResult(data);
+    }
+  });
+
+  BinaryArray data = toBinaryArray(object);
+  runner.run("binary/" + name + "/load", [&](uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; ++i) {
+      T loaded;
+      if (!fromBinaryArray(loaded, data)) {
+        throw std::runtime_error("fromBinaryArray failed");
+      }
+
+      keepResult(loaded);
+    }
+  });
+}
+
+template<typename T>
+void addKVBinaryRoundTrip(BenchmarkRunner& runner, const std::string& name, const T& object) {
+  runner.run("kvbinary/" + name + "/store", [&](uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; ++i) {
+      std::string data = storeToBinaryKeyValue(object);
+      keepResult(data);
+    }
+  });
+
+  std::string data = storeToBinaryKeyValue(object);
+  runner.run("kvbinary/" + name + "/load", [&](uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; ++i) {
+      T loaded;
+      if (!loadFromBinaryKeyValue(loaded, data)) {
+        throw std::runtime_error("loadFromBinaryKeyValue failed");
+      }
+
+      keepResult(loaded);
+    }
+  });
+}
+
+template<typename T>
+void addJsonRoundTrip(BenchmarkRunner& runner, const std::string& name, const T& object) {
+  runner.run("json/" + name + "/store", [&](uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; ++i) {
+      std::string text = storeToJson(object);
+      keepResult(text);
+    }
+  });
+
+  std::string text = storeToJson(object);
+  runner.run("json/" + name + "/load", [&](uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; ++i) {
+      T loaded;
+      if (!loadFromJson(loaded, text)) {
+        throw std::runtime_error("loadFromJson failed");
+      }
+
+      keepResult(loaded);
+    }
+  });
+
+  runner.run("JsonValue/" + name + "/parse", [&](uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; ++i) {
+      Common::JsonValue value = Common::JsonValue::fromString(text);
+      keepResult(value);
+    }
+  });
+
+  Common::JsonValue value = Common::JsonValue::fromString(text);
+  runner.run("JsonValue/" + name + "/toString", [&](uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; ++i) {
+      std::string text = value.toString();
+      keepResult(text);
+    }
+  });
+}
+
+}
+
+void addSerializationBenchmarks(BenchmarkRunner& runner) {
+  Transaction transaction = makeTransaction(1);
+  Block block = makeBlock(1, BLOCK_TRANSACTION_COUNT);
+  NOTIFY_RESPONSE_GET_OBJECTS_request syncResponse = makeSyncResponse();
+
+  addBinaryRoundTrip(runner, "transaction", transaction);
+  addBinaryRoundTrip(runner, "block", block);
+
+  // transaction signatures are written without names and only survive the
+  // binary format, so the key-value and JSON ones take the prefix
+  addKVBinaryRoundTrip(runner, "transaction_prefix", static_cast<const TransactionPrefix&>(transaction));
+  addKVBinaryRoundTrip(runner, "block", block);
+  addKVBinaryRoundTrip(runner, "get_objects_response", syncResponse);
+
+  addJsonRoundTrip(runner, "transaction_prefix", static_cast<const TransactionPrefix&>(transaction));
+  addJsonRoundTrip(runner, "block", block);
+}
+
+}
@@ -0,0 +1,91 @@
+// Copyright (c) 2011-2017 The Cryptonote developers
+// Copyright (c) 2017-2018 The Circle Foundation & Conceal Devs
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "ChainFile.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#include "Common/StdInputStream.h"
+#include "Common/StdOutputStream.h"
+#include "Serialization/BinaryInputStreamSerializer.h"
+#include "Serialization/BinaryOutputStreamSerializer.h"
+
+namespace CryptoNote {
+
+namespace {
+
+const char CHAIN_FILE_SIGNATURE[] = "CACHECHAIN";
+const size_t CHAIN_FILE_SIGNATURE_SIZE = sizeof(CHAIN_FILE_SIGNATURE) - 1;
+const uint32_t CHAIN_FILE_VERSION = 1;
+
+}
+
+ChainFileWriter::ChainFileWriter(const std::string& path) : m_file(path, std::ios::out | std::ios::binary | std::ios::trunc), m_path(path) {
+  if (!m_file) {
+    throw std::runtime_error("Failed to create " + path);
+  }
+
+  m_file.write(CHAIN_FILE_SIGNATURE, CHAIN_FILE_SIGNATURE_SIZE);
+  Common::StdOutputStream stream(m_file);
+  BinaryOutputStreamSerializer archive(stream);
+  uint32_t version = CHAIN_FILE_VERSION;
+  archive(version, "version");
+}
+
+void ChainFileWriter::write(const block_complete_entry& entry) {
+  Common::StdOutputStream stream(m_file);
+  BinaryOutputStreamSerializer archive(stream);
+  const_cast<block_complete_entry&>(entry).serialize(archive);
+  if (!m_file) {
+    throw std::runtime_error("Failed to write " + m_path);
+  }
+}
+
+void ChainFileWriter::close() {
+  m_file.close();
+  if (!m_file) {
+    throw std::runtime_error("Failed to write " + m_path);
+  }
+}
+
+ChainFileReader::ChainFileReader(const std::string& path) : m_file(path, std::ios::in | std::ios::binary), m_path(path) {
+  if (!m_file) {
+    throw std::runtime_error("Failed to open " + path);
+  }
+
+  char signature[CHAIN_FILE_SIGNATURE_SIZE];
+  m_file.read(signature, CHAIN_FILE_SIGNATURE_SIZE);
+  if (!m_file || memcmp(signature, CHAIN_FILE_SIGNATURE, CHAIN_FILE_SIGNATURE_SIZE) != 0) {
+    throw std::runtime_error(path + " is not a chain file");
+  }
+
+  Common::StdInputStream stream(m_file);
+  BinaryInputStreamSerializer archive(stream);
+  uint32_t version = 0;
+  archive(version, "version");
+  if (version != CHAIN_FILE_VERSION) {
+    throw std::runtime_error(path + " has unsupported format version " + std::to_string(version));
+  }
+}
+
+bool ChainFileReader::read(block_complete_entry& entry) {
+  if (m_file.peek() == std::char_traits<char>::eof()) {
+    return false;
+  }
+
+  try {
+    Common::StdInputStream stream(m_file);
+    BinaryInputStreamSerializer archive(stream);
+    entry.serialize(archive);
+  } catch (const std::exception& e) {
+    throw std::runtime_error(m_path + " is truncated or damaged: " + e.what());
+  }
+
+  return true;
+}
+
+}
@@ -0,0 +1,45 @@
+// Copyright (c) 2011-2017 The Cryptonote developers
+// Copyright (c) 2017-2018 The Circle Foundation & Conceal Devs
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <fstream>
+#include <string>
+
+#include "CryptoNoteProtocol/CryptoNoteProtocolDefinitions.h"
+
+namespace CryptoNote {
+
+// A chain file is a signature and a format version followed by the main chain
+// blocks from the genesis block on, each one a binary serialized
+// block_complete_entry: the block blob and the blobs of its transactions, the
+// same bytes the block file holds and peers send.
+class ChainFileWriter {
+public:
+  explicit ChainFileWriter(const std::string& path);
+
+  void write(const block_complete_entry& entry);
+  // Flushes and reports write errors, the destructor can't.
+  void close();
+
+private:
+  std::ofstream m_file;
+  std::string m_path;
+};
+
+class ChainFileReader {
+public:
+  explicit ChainFileReader(const std::string& path);
+
+  // Returns false at the end of the file.
+  bool read(block_complete_entry& entry);
+
+private:
+  std::ifstream m_file;
+  std::string m_path;
+};
+
+}
@@ -0,0 +1,226 @@
+// Copyright (c) 2011-2017 The Cryptonote developers
+// Copyright (c) 2017-2018 The Circle Foundation & Conceal Devs
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "ChainReplay.h"
+
+#include <chrono>
+
+#include "Common/MemoryInputStream.h"
+#include "CryptoNoteCore/CryptoNoteFormatUtils.h"
+#include "CryptoNoteCore/IBlock.h"
+#include "Logging/LoggerRef.h"
+#include "Serialization/BinaryInputStreamSerializer.h"
+#include "Serialization/SerializationOverloads.h"
+
+using namespace Logging;
+
+namespace CryptoNote {
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const std::chrono::seconds PROGRESS_INTERVAL(10);
+
+class ReplayBlock : public IBlock {
+public:
+  virtual const Block& getBlock() const override {
+    return block;
+  }
+
+  virtual size_t getTransactionCount() const override {
+    return transactions.size();
+  }
+
+  virtual const Transaction& getTransaction(size_t index) const override {
+    return transactions[index];
+  }
+
+  Block block;
+  std::vector<Transaction> transactions;
+};
+
+// Same as fromBinaryArray, without copying the blob out of the entry.
+template<class T>
+bool parseBlob(T& object, const std::string& blob) {
+  try {
+    Common::MemoryInputStream stream(blob.data(), blob.size());
+    BinaryInputStreamSerializer serializer(stream);
+    serialize(object, serializer);
+    return stream.endOfStream();
+  } catch (std::exception&) {
+    return false;
+  }
+}
+
+double toSeconds(std::chrono::nanoseconds duration) {
+  return std::chrono::duration_cast<std::chrono::duration<double>>(duration).count();
+}
+
+void addStage(ChainReplayReport& report, const std::string& name, std::chrono::nanoseconds duration) {
+  ChainReplayStage stage;
+  stage.name = name;
+  stage.seconds = toSeconds(duration);
+  stage.microsecondsPerBlock = report.blocks == 0 ? 0 : stage.seconds * 1e6 / static_cast<double>(report.blocks);
+  report.stages.push_back(stage);
+}
+
+}
+
+void ChainReplayStage::serialize(ISerializer& s) {
+  KV_MEMBER(name)
+  KV_MEMBER(seconds)
+  KV_MEMBER(microsecondsPerBlock)
+}
+
+void ChainReplayReport::serialize(ISerializer& s) {
+  KV_MEMBER(fullVerification)
+  KV_MEMBER(startHeight)
+  KV_MEMBER(blocks)
+  KV_MEMBER(transactions)
+  KV_MEMBER(seconds)
+  KV_MEMBER(blocksPerSecond)
+  KV_MEMBER(stages)
+}
+
+uint32_t exportChain(core& core, ChainFileWriter& writer, uint32_t maxBlocks, ILogger& log) {
+  LoggerRef logger(log, "ChainReplay");
+  uint32_t count = core.get_current_blockchain_height();
+  if (maxBlocks != 0 && maxBlocks < count) {
+    count = maxBlocks;
+  }
+
+  auto lastProgress = Clock::now();
+  block_complete_entry entry;
+  for (uint32_t height = 0; height < count; ++height) {
+    // the blobs are copied from the block file as they are
+    if (!core.getRawBlock(core.getBlockIdByHeight(height), entry)) {
+      throw std::runtime_error("Failed to read block " + std::to_string(height));
+    }
+
+    writer.write(entry);
+    if (Clock::now() - lastProgress > PROGRESS_INTERVAL) {
+      lastProgress = Clock::now();
+      logger(INFO) << "Exported " << height + 1 << " of " << count << " blocks";
+    }
+  }
+
+  writer.close();
+  return count;
+}
+
+bool importChain(core& core, ChainFileReader& reader, size_t batchSize, uint64_t maxBlocks, const std::atomic<bool>& stopRequested,
+  ChainReplayReport& report, ILogger& log) {
+  LoggerRef logger(log, "ChainReplay");
+  BlockProcessingStatistics before = core.getBlockProcessingStatistics();
+  auto importStart = Clock::now();
+  std::chrono::nanoseconds deserialization(0);
+  std::chrono::nanoseconds addChain(0);
+
+  uint32_t coreHeight = core.get_current_blockchain_height();
+  uint32_t height = 0;
+  report.startHeight = coreHeight;
+  report.blocks = 0;
+  report.transactions = 0;
+
+  std::vector<ReplayBlock> batch;
+  batch.reserve(batchSize);
+  auto addBatch = [&]() {
+    std::vector<const IBlock*> chain;
+    for (const ReplayBlock& block : batch) {
+      chain.push_back(&block);
+    }
+
+    auto start = Clock::now();
+    size_t added = core.addChain(chain);
+    addChain += Clock::now() - start;
+    report.blocks += added;
+    for (size_t i = 0; i < added; ++i) {
+      report.transactions += batch[i].transactions.size();
+    }
+
+    if (added != batch.size()) {
+      logger(ERROR, BRIGHT_RED) << "Block " << height - batch.size() + added << " was rejected";
+      return false;
+    }
+
+    batch.clear();
+    return true;
+  };
+
+  auto lastProgress = Clock::now();
+  block_complete_entry entry;
+  while ((maxBlocks == 0 || report.blocks + batch.size() < maxBlocks) && !stopRequested && reader.read(entry)) {
+    if (height < coreHeight) {
+      Block block;
+      if (!parseBlob(block, entry.block) || get_block_hash(block) != core.getBlockIdByHeight(height)) {
+        logger(ERROR, BRIGHT_RED) << "Block " << height << " of the file differs from the one in the data directory";
+        return false;
+      }
+
+      ++height;
+      continue;
+    }
+
+    auto start = Clock::now();
+    batch.emplace_back();
+    ReplayBlock& block = batch.back();
+    bool parsed = parseBlob(block.block, entry.block);
+    block.transactions.resize(entry.txs.size());
+    for (size_t i = 0; parsed && i < entry.txs.size(); ++i) {
+      parsed = parseBlob(block.transactions[i], entry.txs[i]);
+    }
+
+    deserialization += Clock::now() - start;
+    if (!parsed) {
+      logger(ERROR, BRIGHT_RED) << "Failed to parse block " << height;
+      return false;
+    }
+
+    ++height;
+    if (batch.size() == batchSize && !addBatch()) {
+      return false;
+    }
+
+    if (Clock::now() - lastProgress > PROGRESS_INTERVAL) {
+      lastProgress = Clock::now();
+      logger(INFO) << "Imported up to height " << height << ", " << report.blocks << " blocks";
+    }
+  }
+
+  if (!batch.empty() && !addBatch()) {
+    return false;
+  }
+
+  BlockProcessingStatistics added = core.getBlockProcessingStatistics();
+  // part of the benchmark: the daemon stores the cache on exit and periodically while syncing;
+  // core::deinit() then finds the cache up to date and does not write it again
+  if (!core.saveBlockchain()) {
+    return false;
+  }
+
+  BlockProcessingStatistics after = core.getBlockProcessingStatistics();
+  std::chrono::nanoseconds total = Clock::now() - importStart;
+  std::chrono::nanoseconds hashing = after.hashing - before.hashing;
+  std::chrono::nanoseconds proofOfWork = after.proofOfWork - before.proofOfWork;
+  std::chrono::nanoseconds inputChecks = after.inputChecks - before.inputChecks;
+  std::chrono::nanoseconds indexing = after.indexing - before.indexing;
+
+  report.seconds = toSeconds(total);
+  report.blocksPerSecond = report.seconds == 0 ? 0 : static_cast<double>(report.blocks) / report.seconds;
+  report.stages.clear();
+  addStage(report, "deserialization", deserialization);
+  addStage(report, "hashing", hashing);
+  addStage(report, "proof_of_work", proofOfWork);
+  addStage(report, "input_checks", inputChecks);
+  addStage(report, "indexing", indexing);
+  addStage(report, "cache_save", after.cacheSave - before.cacheSave);
+  // pool admission of the transactions, difficulty, rewards and locking
+  addStage(report, "other", addChain - hashing - proofOfWork - inputChecks - indexing - (added.cacheSave - before.cacheSave));
+  return true;
+}
+
+}
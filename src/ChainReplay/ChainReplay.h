@@ -0,0 +1,50 @@
+// Copyright (c) 2011-2017 The Cryptonote developers
+// Copyright (c) 2017-2018 The Circle Foundation & Conceal Devs
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "ChainFile.h"
+#include "CryptoNoteCore/Core.h"
+#include "Logging/ILogger.h"
+
+namespace CryptoNote {
+
+struct ChainReplayStage {
+  std::string name;
+  double seconds;
+  double microsecondsPerBlock;
+
+  void serialize(ISerializer& s);
+};
+
+struct ChainReplayReport {
+  bool fullVerification;
+  uint32_t startHeight;
+  uint64_t blocks;
+  uint64_t transactions;
+  double seconds;
+  double blocksPerSecond;
+  std::vector<ChainReplayStage> stages;
+
+  void serialize(ISerializer& s);
+};
+
+// Writes the first 'maxBlocks' main chain blocks of the core, all of them if
+// 'maxBlocks' is 0. Returns the number of blocks written.
+uint32_t exportChain(core& core, ChainFileWriter& writer, uint32_t maxBlocks, Logging::ILogger& logger);
+
+// Adds the blocks of the file the core doesn't have yet through core::addChain,
+// 'batchSize' blocks at a time, and times every stage of it. Blocks the core
+// already has must match the file. Stops after 'maxBlocks' added blocks if it
+// isn't 0, or once 'stopRequested' is set. Returns false if a block is rejected.
+bool importChain(core& core, ChainFileReader& reader, size_t batchSize, uint64_t maxBlocks, const std::atomic<bool>& stopRequested,
+  ChainReplayReport& report, Logging::ILogger& logger);
+
+}
@@ -0,0 +1,171 @@
+// Copyright (c) 2011-2017 The Cryptonote developers
+// Copyright (c) 2017-2018 The Circle Foundation & Conceal Devs
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include <boost/program_options.hpp>
+
+#include "../CheckpointData.h"
+#include "ChainReplay.h"
+#include "Common/CommandLine.h"
+#include "Common/SignalHandler.h"
+#include "Common/Util.h"
+#include "CryptoNoteConfig.h"
+#include "CryptoNoteCore/CoreConfig.h"
+#include "CryptoNoteCore/Currency.h"
+#include "CryptoNoteCore/MinerConfig.h"
+#include "Logging/ConsoleLogger.h"
+#include "Logging/LoggerRef.h"
+#include "Serialization/SerializationTools.h"
+
+namespace po = boost::program_options;
+using namespace CryptoNote;
+using namespace Logging;
+
+namespace {
+  const command_line::arg_descriptor<std::string> arg_export            = {"export", "Write the main chain of the data directory to this chain file", ""};
+  const command_line::arg_descriptor<std::string> arg_import            = {"import", "Add the blocks of this chain file the data directory doesn't have yet", ""};
+  const command_line::arg_descriptor<bool>        arg_full_verification = {"full-verification", "Check proof of work and signatures of every imported block instead of trusting the checkpoints", false};
+  const command_line::arg_descriptor<std::string> arg_load_checkpoints  = {"load-checkpoints", "Checkpoints to import with, 'default' or a csv file", "default"};
+  const command_line::arg_descriptor<bool>        arg_testnet_on        = {"testnet", "Use the testnet chain", false};
+  const command_line::arg_descriptor<uint32_t>    arg_blocks            = {"blocks", "Export or import at most this many blocks, 0 for all", 0};
+  const command_line::arg_descriptor<uint32_t>    arg_batch_size        = {"batch-size", "Blocks passed to the core at once while importing", static_cast<uint32_t>(BLOCKS_SYNCHRONIZING_DEFAULT_COUNT)};
+  const command_line::arg_descriptor<std::string> arg_report            = {"report", "Write the import timings to this file as JSON", ""};
+  const command_line::arg_descriptor<int>         arg_log_level         = {"log-level", "", 2};
+}
+
+int main(int argc, char* argv[]) {
+  po::options_description desc_general("General options");
+  command_line::add_arg(desc_general, command_line::arg_help);
+  po::options_description desc_params("Replay options");
+  command_line::add_arg(desc_params, command_line::arg_data_dir, Tools::getDefaultDataDirectory());
+  command_line::add_arg(desc_params, arg_export);
+  command_line::add_arg(desc_params, arg_import);
+  command_line::add_arg(desc_params, arg_full_verification);
+  command_line::add_arg(desc_params, arg_load_checkpoints);
+  command_line::add_arg(desc_params, arg_testnet_on);
+  command_line::add_arg(desc_params, arg_blocks);
+  command_line::add_arg(desc_params, arg_batch_size);
+  command_line::add_arg(desc_params, arg_report);
+  command_line::add_arg(desc_params, arg_log_level);
+
+  po::options_description desc_all;
+  desc_all.add(desc_general).add(desc_params);
+
+  po::variables_map vm;
+  bool r = command_line::handle_error_helper(desc_all, [&]() {
+    po::store(command_line::parse_command_line(argc, argv, desc_general, true), vm);
+    if (command_line::get_arg(vm, command_line::arg_help)) {
+      std::cout << desc_all << std::endl;
+      return false;
+    }
+
+    po::store(command_line::parse_command_line(argc, argv, desc_params, false), vm);
+    po::notify(vm);
+    return true;
+  });
+
+  if (!r) {
+    return 1;
+  }
+
+  std::string exportPath = command_line::get_arg(vm, arg_export);
+  std::string importPath = command_line::get_arg(vm, arg_import);
+  if (exportPath.empty() == importPath.empty()) {
+    std::cerr << "Specify either --" << arg_export.name << " or --" << arg_import.name << std::endl;
+    return 1;
+  }
+
+  Level logLevel = static_cast<Level>(static_cast<int>(Logging::ERROR) + command_line::get_arg(vm, arg_log_level));
+  ConsoleLogger logManager(logLevel);
+  LoggerRef logger(logManager, "ChainReplay");
+
+  try {
+    bool testnet = command_line::get_arg(vm, arg_testnet_on);
+    CurrencyBuilder currencyBuilder(logManager);
+    currencyBuilder.testnet(testnet);
+    Currency currency = currencyBuilder.currency();
+
+    CoreConfig coreConfig;
+    coreConfig.init(vm);
+    if (!exportPath.empty() && !Tools::directoryExists(coreConfig.configFolder)) {
+      throw std::runtime_error("Directory does not exist: " + coreConfig.configFolder);
+    }
+
+    core ccore(currency, nullptr, logManager, false);
+
+    // fast mode: blocks below the last checkpoint are matched against it instead
+    // of having their proof of work and signatures checked
+    bool fullVerification = command_line::get_arg(vm, arg_full_verification);
+    if (!importPath.empty() && !fullVerification && !testnet) {
+      Checkpoints checkpoints(logManager);
+      std::string checkpointsFile = command_line::get_arg(vm, arg_load_checkpoints);
+      if (checkpointsFile == "default") {
+        for (const auto& cp : CHECKPOINTS) {
+          checkpoints.add_checkpoint(cp.height, cp.blockId);
+        }
+      } else if (!checkpoints.load_checkpoints_from_file(checkpointsFile)) {
+        throw std::runtime_error("Failed to load checkpoints");
+      }
+
+      ccore.set_checkpoints(std::move(checkpoints));
+    }
+
+    MinerConfig minerConfig;
+    if (!ccore.init(coreConfig, minerConfig, true)) {
+      throw std::runtime_error("Failed to initialize core");
+    }
+
+    uint32_t maxBlocks = command_line::get_arg(vm, arg_blocks);
+    if (!exportPath.empty()) {
+      ChainFileWriter writer(exportPath);
+      uint32_t count = exportChain(ccore, writer, maxBlocks, logManager);
+      logger(INFO, BRIGHT_GREEN) << "Exported " << count << " blocks to " << exportPath;
+      ccore.deinit();
+      return 0;
+    }
+
+    std::atomic<bool> stopRequested(false);
+    Tools::SignalHandler::install([&stopRequested] {
+      stopRequested = true;
+    });
+
+    ChainFileReader reader(importPath);
+    ChainReplayReport report;
+    report.fullVerification = fullVerification;
+    uint32_t batchSize = std::max<uint32_t>(command_line::get_arg(vm, arg_batch_size), 1);
+    bool imported = importChain(ccore, reader, batchSize, maxBlocks, stopRequested, report, logManager);
+    ccore.deinit();
+    if (!imported) {
+      return 1;
+    }
+
+    logger(INFO, BRIGHT_GREEN) << "Imported " << report.blocks << " blocks with " << report.transactions << " transactions from height " <<
+      report.startHeight << " in " << std::fixed << std::setprecision(1) << report.seconds << " s, " << report.blocksPerSecond << " blocks/s";
+    for (const ChainReplayStage& stage : report.stages) {
+      logger(INFO) << std::left << std::setw(16) << stage.name << std::right << std::fixed << std::setprecision(3) << std::setw(12) <<
+        stage.seconds << " s" << std::setprecision(1) << std::setw(12) << stage.microsecondsPerBlock << " us/block";
+    }
+
+    std::string reportPath = command_line::get_arg(vm, arg_report);
+    if (!reportPath.empty()) {
+      std::ofstream file(reportPath, std::ios::binary);
+      file << storeToJson(report) << std::endl;
+      if (!file) {
+        throw std::runtime_error("Failed to write " + reportPath);
+      }
+    }
+  } catch (const std::exception& e) {
+    logger(ERROR, BRIGHT_RED) << e.what();
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,114 @@
+// Copyright (c) 2011-2017 The Cryptonote developers
+// Copyright (c) 2017-2018 The Circle Foundation & Conceal Devs
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "RecursiveSharedMutex.h"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace Tools {
+
+namespace {
+
+// shared lock depth of the current thread, per mutex
+thread_local std::vector<std::pair<const RecursiveSharedMutex*, size_t>> sharedDepths;
+
+}
+
+RecursiveSharedMutex::RecursiveSharedMutex() :
+  m_readers(0), m_waitingWriters(0), m_writerActive(false), m_writer(std::thread::id()), m_writerDepth(0) {
+}
+
+size_t& RecursiveSharedMutex::sharedDepth() {
+  auto it = std::find_if(sharedDepths.begin(), sharedDepths.end(),
+    [this](const std::pair<const RecursiveSharedMutex*, size_t>& entry) { return entry.first == this; });
+  if (it == sharedDepths.end()) {
+    sharedDepths.emplace_back(this, 0);
+    return sharedDepths.back().second;
+  }
+
+  return it->second;
+}
+
+bool RecursiveSharedMutex::ownsExclusive() const {
+  return m_writer.load(std::memory_order_relaxed) == std::this_thread::get_id();
+}
+
+void RecursiveSharedMutex::lock() {
+  if (ownsExclusive()) {
+    ++m_writerDepth;
+    return;
+  }
+
+  // waiting here would wait for this thread's own shared lock forever
+  if (sharedDepth() != 0) {
+    assert(!"RecursiveSharedMutex::lock, shared lock cannot be upgraded to exclusive");
+    throw std::logic_error("RecursiveSharedMutex::lock, shared lock cannot be upgraded to exclusive");
+  }
+
+  std::unique_lock<std::mutex> lk(m_mutex);
+  ++m_waitingWriters;
+  m_writersCv.wait(lk, [this] { return !m_writerActive && m_readers == 0; });
+  --m_waitingWriters;
+  m_writerActive = true;
+  m_writer.store(std::this_thread::get_id(), std::memory_order_relaxed);
+  m_writerDepth = 1;
+}
+
+void RecursiveSharedMutex::unlock() {
+  assert(ownsExclusive() && m_writerDepth > 0);
+  if (--m_writerDepth > 0) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lk(m_mutex);
+  m_writer.store(std::thread::id(), std::memory_order_relaxed);
+  m_writerActive = false;
+  if (m_waitingWriters > 0) {
+    m_writersCv.notify_one();
+  } else {
+    m_readersCv.notify_all();
+  }
+}
+
+void RecursiveSharedMutex::lock_shared() {
+  if (ownsExclusive()) {
+    ++m_writerDepth;
+    return;
+  }
+
+  size_t& depth = sharedDepth();
+  if (depth++ > 0) {
+    return;
+  }
+
+  std::unique_lock<std::mutex> lk(m_mutex);
+  m_readersCv.wait(lk, [this] { return !m_writerActive && m_waitingWriters == 0; });
+  ++m_readers;
+}
+
+void RecursiveSharedMutex::unlock_shared() {
+  if (ownsExclusive()) {
+    unlock();
+    return;
+  }
+
+  size_t& depth = sharedDepth();
+  assert(depth > 0);
+  if (--depth > 0) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lk(m_mutex);
+  if (--m_readers == 0 && m_waitingWriters > 0) {
+    m_writersCv.notify_one();
+  }
+}
+
+}
@@ -0,0 +1,67 @@
+// Copyright (c) 2011-2017 The Cryptonote developers
+// Copyright (c) 2017-2018 The Circle Foundation & Conceal Devs
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+
+namespace Tools {
+
+// Reader/writer mutex that can be re-entered by the thread holding it.
+// A thread holding the exclusive lock may take it again or take the shared
+// lock; a thread holding the shared lock may take the shared lock again even
+// while a writer is waiting. Upgrading shared to exclusive is not supported,
+// lock() asserts in debug builds and throws std::logic_error instead of
+// deadlocking otherwise.
+// Writers are preferred over new readers so block import is not starved.
+class RecursiveSharedMutex {
+public:
+  RecursiveSharedMutex();
+  RecursiveSharedMutex(const RecursiveSharedMutex&) = delete;
+  RecursiveSharedMutex& operator=(const RecursiveSharedMutex&) = delete;
+
+  void lock();
+  void unlock();
+
+  void lock_shared();
+  void unlock_shared();
+
+private:
+  size_t& sharedDepth();
+  bool ownsExclusive() const;
+
+  std::mutex m_mutex;
+  std::condition_variable m_readersCv;
+  std::condition_variable m_writersCv;
+  size_t m_readers;
+  size_t m_waitingWriters;
+  bool m_writerActive;
+  std::atomic<std::thread::id> m_writer;
+  size_t m_writerDepth;
+};
+
+class SharedLockGuard {
+public:
+  explicit SharedLockGuard(RecursiveSharedMutex& mutex) : m_mutex(mutex) {
+    m_mutex.lock_shared();
+  }
+
+  ~SharedLockGuard() {
+    m_mutex.unlock_shared();
+  }
+
+  SharedLockGuard(const SharedLockGuard&) = delete;
+  SharedLockGuard& operator=(const SharedLockGuard&) = delete;
+
+private:
+  RecursiveSharedMutex& m_mutex;
+};
+
+}
@@ -16,7 +16,9 @@
 #include <shlobj.h>
 #include <strsafe.h>
 #else 
+#include <fcntl.h>
 #include <sys/utsname.h>
+#include <unistd.h>
 #endif
 #pragma warning(disable : 4996)
 
@@ -348,6 +350,44 @@ std::string get_nix_version_display_string()
     return std::error_code(code, std::system_category());
   }
 
+  std::error_code sync_file(const std::string& name)
+  {
+    int code = 0;
+#if defined(WIN32)
+    HANDLE file = ::CreateFile(name.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+      code = static_cast<int>(::GetLastError());
+    }
+    else
+    {
+      code = ::FlushFileBuffers(file) ? 0 : static_cast<int>(::GetLastError());
+      ::CloseHandle(file);
+    }
+#else
+    int file = ::open(name.c_str(), O_RDONLY);
+    if (file == -1)
+    {
+      code = errno;
+    }
+    else
+    {
+      code = ::fsync(file) == 0 ? 0 : errno;
+      ::close(file);
+    }
+#endif
+    return std::error_code(code, std::system_category());
+  }
+
+  std::error_code sync_directory(const std::string& path)
+  {
+#if defined(WIN32)
+    return std::error_code();
+#else
+    return sync_file(path);
+#endif
+  }
+
   bool directoryExists(const std::string& path) {
     boost::system::error_code ec;
     return boost::filesystem::is_directory(path, ec);
@@ -15,5 +15,9 @@ namespace Tools
   std::string get_os_version_string();
   bool create_directories_if_necessary(const std::string& path);
   std::error_code replace_file(const std::string& replacement_name, const std::string& replaced_name);
+  // Flushes the contents of the file to disk.
+  std::error_code sync_file(const std::string& name);
+  // Flushes the directory entries, so that files renamed into it survive a crash. Nothing to do on Windows.
+  std::error_code sync_directory(const std::string& path);
   bool directoryExists(const std::string& path);
 }
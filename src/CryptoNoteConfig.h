@@ -134,9 +134,15 @@ namespace CryptoNote {
   const Version   BLOCK_MINOR_VERSION_0 = 0;
   const Version   BLOCK_MINOR_VERSION_1 = 1;
 
+  const uint32_t  BLOCKCHAIN_CACHE_SAVE_INTERVAL = (60 * 60); // seconds between periodic cache snapshots
   const size_t    BLOCKS_IDS_SYNCHRONIZING_DEFAULT_COUNT = 10000;
   const size_t    BLOCKS_SYNCHRONIZING_DEFAULT_COUNT = 128;
   const size_t    COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT = 1000;
+  const uint32_t  RPC_LONGPOLL_TIMEOUT = 60;        // seconds a long-poll getblocktemplate may be parked
+  const uint32_t  RPC_LONGPOLL_POOL_INTERVAL = 10;  // seconds before pool changes alone end a long poll
+  const uint32_t  RPC_RESPONSE_CACHE_MAX_AGE = 2;   // seconds a cached response that reports node state is served
+  const size_t    RPC_RESPONSE_CACHE_MAX_ENTRIES = 4096;
+  const size_t    RPC_RESPONSE_CACHE_MAX_BYTES = 64 * 1024 * 1024; // keys and payloads of all cached responses
 
   const size_t    P2P_CONNECTION_MAX_WRITE_BUFFER_SIZE = 64 * 1024 * 1024;
   const size_t    P2P_DEFAULT_ANCHOR_CONNECTIONS_COUNT = 2;
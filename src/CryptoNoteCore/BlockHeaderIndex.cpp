@@ -0,0 +1,81 @@
+// Copyright (c) 2011-2017 The Cryptonote developers
+// Copyright (c) 2017-2018 The Circle Foundation & Conceal Devs
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "BlockHeaderIndex.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "Serialization/SerializationOverloads.h"
+
+namespace CryptoNote {
+
+void BlockHeaderIndex::push(const Entry& entry) {
+  m_entries.push_back(entry);
+}
+
+void BlockHeaderIndex::pop() {
+  assert(!m_entries.empty());
+  m_entries.pop_back();
+}
+
+void BlockHeaderIndex::clear() {
+  m_entries.clear();
+}
+
+void BlockHeaderIndex::reserve(uint32_t expectedHeight) {
+  m_entries.reserve(expectedHeight);
+}
+
+bool BlockHeaderIndex::empty() const {
+  return m_entries.empty();
+}
+
+uint32_t BlockHeaderIndex::size() const {
+  return static_cast<uint32_t>(m_entries.size());
+}
+
+auto BlockHeaderIndex::operator[](uint32_t height) const -> const Entry& {
+  assert(height < m_entries.size());
+  return m_entries[height];
+}
+
+auto BlockHeaderIndex::back() const -> const Entry& {
+  assert(!m_entries.empty());
+  return m_entries.back();
+}
+
+uint64_t BlockHeaderIndex::timestamp(uint32_t height) const {
+  return (*this)[height].timestamp;
+}
+
+uint64_t BlockHeaderIndex::cumulativeDifficulty(uint32_t height) const {
+  return (*this)[height].cumulativeDifficulty;
+}
+
+uint64_t BlockHeaderIndex::blockCumulativeSize(uint32_t height) const {
+  return (*this)[height].blockCumulativeSize;
+}
+
+uint64_t BlockHeaderIndex::alreadyGeneratedCoins(uint32_t height) const {
+  return (*this)[height].alreadyGeneratedCoins;
+}
+
+uint32_t BlockHeaderIndex::timestampLowerBound(uint64_t timestamp, uint32_t startHeight) const {
+  if (startHeight >= m_entries.size()) {
+    return size();
+  }
+
+  auto it = std::lower_bound(m_entries.begin() + startHeight, m_entries.end(), timestamp,
+    [](const Entry& entry, uint64_t timestamp) { return entry.timestamp < timestamp; });
+  return static_cast<uint32_t>(std::distance(m_entries.begin(), it));
+}
+
+void BlockHeaderIndex::serialize(ISerializer& s) {
+  serializeAsBinary(m_entries, "entries", s);
+}
+
+}
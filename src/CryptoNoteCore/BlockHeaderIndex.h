@@ -0,0 +1,51 @@
+// Copyright (c) 2011-2017 The Cryptonote developers
+// Copyright (c) 2017-2018 The Circle Foundation & Conceal Devs
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace CryptoNote {
+class ISerializer;
+
+// Fixed-size scalar fields of every main chain block, indexed by height.
+// Lets difficulty, timestamp and block size checks run without
+// deserializing whole blocks from block storage.
+class BlockHeaderIndex {
+public:
+  struct Entry {
+    uint64_t timestamp;
+    uint64_t cumulativeDifficulty;
+    uint64_t blockCumulativeSize;
+    uint64_t alreadyGeneratedCoins;
+  };
+
+  void push(const Entry& entry);
+  void pop();
+  void clear();
+  void reserve(uint32_t expectedHeight);
+
+  bool empty() const;
+  uint32_t size() const;
+  const Entry& operator[](uint32_t height) const;
+  const Entry& back() const;
+
+  uint64_t timestamp(uint32_t height) const;
+  uint64_t cumulativeDifficulty(uint32_t height) const;
+  uint64_t blockCumulativeSize(uint32_t height) const;
+  uint64_t alreadyGeneratedCoins(uint32_t height) const;
+
+  // returns the first height in [startHeight, size()) with timestamp >= timestamp, or size()
+  uint32_t timestampLowerBound(uint64_t timestamp, uint32_t startHeight) const;
+
+  void serialize(ISerializer& s);
+
+private:
+  std::vector<Entry> m_entries;
+};
+}
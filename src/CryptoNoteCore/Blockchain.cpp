@@ -13,14 +13,22 @@
 #include <numeric>
 #include <cstdio>
 #include <cmath>
+#include <future>
+#include <memory>
+#include <thread>
+#include <boost/filesystem.hpp>
 #include <boost/foreach.hpp>
 #include "Common/ColouredMsg.h"
 #include "Common/Math.h"
 #include "Common/int-util.h"
+#include "Common/MemoryInputStream.h"
 #include "Common/ShuffleGenerator.h"
 #include "Common/StdInputStream.h"
 #include "Common/StdOutputStream.h"
+#include "Common/StringOutputStream.h"
 #include "Rpc/CoreRpcServerCommandsDefinitions.h"
+#include "Serialization/BinaryInputStreamSerializer.h"
+#include "Serialization/BinaryOutputStreamSerializer.h"
 #include "Serialization/BinarySerializationTools.h"
 #include "CryptoNoteTools.h"
 #include "TransactionExtra.h"
@@ -45,6 +53,25 @@ namespace
     return result;
   }
 
+  bool isKeyImageInMainSubgroup(const Crypto::KeyImage &keyImage)
+  {
+    static const Crypto::KeyImage I = {{0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}};
+    static const Crypto::KeyImage L = {{0xed, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58, 0xd6, 0x9c, 0xf7, 0xa2, 0xde, 0xf9, 0xde, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10}};
+    return Crypto::scalarmultKey(keyImage, L) == I;
+  }
+
+  // ring signatures verified per batch call when a block is pushed
+  const size_t RING_SIGNATURE_BATCH_SIZE = 32;
+
+  // blocks read and hashed per step when the cache is rebuilt
+  const uint32_t CACHE_REPLAY_BATCH_SIZE = 1000;
+
+  template <class Map, class Key>
+  bool isInShard(Map &map, const Key &key, size_t shard, size_t shardCount)
+  {
+    return map.subidx(map.hash(key)) % shardCount == shard;
+  }
+
 } // namespace
 
 namespace std
@@ -60,7 +87,7 @@ namespace std
   }
 } // namespace std
 
-#define CURRENT_BLOCKCACHE_STORAGE_ARCHIVE_VER 4
+#define CURRENT_BLOCKCACHE_STORAGE_ARCHIVE_VER 9
 #define CURRENT_BLOCKCHAININDICES_STORAGE_ARCHIVE_VER 1
 
 namespace CryptoNote
@@ -109,10 +136,12 @@ namespace CryptoNote
     return true;
   }
 
+  static_assert(sizeof(Blockchain::KeyOutputEntry) == sizeof(Crypto::PublicKey) + 16, "KeyOutputEntry must not be padded");
+
   // custom serialization to speedup cache loading
-  bool serialize(std::vector<std::pair<Blockchain::TransactionIndex, uint16_t>> &value, Common::StringView name, CryptoNote::ISerializer &s)
+  bool serialize(std::vector<Blockchain::KeyOutputEntry> &value, Common::StringView name, CryptoNote::ISerializer &s)
   {
-    const size_t elementSize = sizeof(std::pair<Blockchain::TransactionIndex, uint16_t>);
+    const size_t elementSize = sizeof(Blockchain::KeyOutputEntry);
     size_t size = value.size() * elementSize;
 
     if (!s.beginArray(size, name))
@@ -148,7 +177,7 @@ namespace CryptoNote
   {
 
   public:
-    BlockCacheSerializer(Blockchain &bs, const Crypto::Hash lastBlockHash, ILogger &logger) : m_bs(bs), m_lastBlockHash(lastBlockHash), m_loaded(false), logger(logger, "BlockCacheSerializer")
+    BlockCacheSerializer(Blockchain &bs, const Crypto::Hash lastBlockHash, ILogger &logger) : m_bs(bs), m_lastBlockHash(lastBlockHash), m_lastBlockIndex(0), m_poppedBlocks(0), m_loaded(false), logger(logger, "BlockCacheSerializer")
     {
     }
 
@@ -172,25 +201,66 @@ namespace CryptoNote
       }
     }
 
+    // Writes the cache of the main chain as it is when the save starts. The
+    // blockchain lock is only taken in shared mode: once for the side files
+    // and the small containers, then for one chunk of the indices or outputs
+    // at a time, so blocks keep being added while the bulk is written.
+    // Entries appended in the meantime are left out, a rollback fails the
+    // save. Everything is written to temporary files and flushed to disk
+    // first, then renamed over the previous snapshot, so a crash while saving
+    // leaves either the old or the new one intact.
     bool save(const std::string &filename)
     {
+      auto start = std::chrono::steady_clock::now();
+      std::vector<std::string> names = {sideFileName(TRANSACTIONS_MAP_FILENAME), sideFileName(SPENT_KEYS_FILENAME), filename};
       try
       {
-        std::ofstream file(filename, std::ios::binary);
+        std::ofstream file(filename + ".tmp", std::ios::binary);
+        StdOutputStream stream(file);
+        BinaryOutputStreamSerializer s(stream);
+        write(s);
+        file.close();
         if (!file)
         {
+          logger(ERROR) << "failed to write " << filename << ".tmp";
           return false;
         }
-
-        StdOutputStream stream(file);
-        BinaryOutputStreamSerializer s(stream);
-        CryptoNote::serialize(*this, s);
       }
-      catch (std::exception &)
+      catch (std::exception &e)
       {
+        logger(ERROR) << "saving failed: " << e.what();
         return false;
       }
 
+      for (const std::string &name : names)
+      {
+        std::error_code ec = Tools::sync_file(name + ".tmp");
+        if (ec)
+        {
+          logger(ERROR) << "failed to flush " << name << ".tmp: " << ec.message();
+          return false;
+        }
+      }
+
+      boost::system::error_code ec;
+      for (const std::string &name : names)
+      {
+        boost::filesystem::rename(name + ".tmp", name, ec);
+        if (ec)
+        {
+          logger(ERROR) << "failed to rename " << name << ".tmp: " << ec.message();
+          return false;
+        }
+      }
+
+      std::error_code syncError = Tools::sync_directory(m_bs.m_config_folder);
+      if (syncError)
+      {
+        logger(WARNING) << "failed to flush " << m_bs.m_config_folder << ": " << syncError.message();
+      }
+
+      auto dur = std::chrono::steady_clock::now() - start;
+      logger(INFO, BRIGHT_GREEN) << "Saving time took: " << std::chrono::duration_cast<std::chrono::milliseconds>(dur).count() << "ms";
       return true;
     }
 
@@ -205,39 +275,37 @@ namespace CryptoNote
         return;
       }
 
-      std::string operation;
-      if (s.type() == ISerializer::INPUT) {
-        operation = "- Loading : ";
-        Crypto::Hash blockHash;
-        s(blockHash, "last_block");
+      // A snapshot of an earlier block of the main chain is accepted as well;
+      // the blocks after it are replayed from the block storage.
+      const std::string operation = "- Loading : ";
+      Crypto::Hash blockHash;
+      s(blockHash, "last_block");
+      s(m_lastBlockIndex, "last_block_index");
 
-        if (blockHash != m_lastBlockHash) {
-          return;
-        }
-      } else {
-        operation = "- Saving : ";
-        s(m_lastBlockHash, "last_block");
+      if (m_lastBlockIndex >= m_bs.m_blocks.size() || blockHash != get_block_hash(m_bs.m_blocks[m_lastBlockIndex].bl)) {
+        return;
       }
 
+      m_lastBlockHash = blockHash;
+
       logger(INFO, BRIGHT_MAGENTA) << operation << "Block Index";
       s(m_bs.m_blockIndex, "block_index");
 
+      logger(INFO, BRIGHT_MAGENTA) << operation << "Block Header Index";
+      s(m_bs.m_blockHeaderIndex, "block_header_index");
+
       logger(INFO, BRIGHT_MAGENTA) << operation << "Transaction Map";
-      if (s.type() == ISerializer::INPUT) {
-        phmap::BinaryInputArchive ar_in(appendPath(m_bs.m_config_folder, "transactionsmap.dat").c_str());
+      {
+        phmap::BinaryInputArchive ar_in(sideFileName(TRANSACTIONS_MAP_FILENAME).c_str());
+        checkSideFileStamp(ar_in, TRANSACTIONS_MAP_FILENAME);
         m_bs.m_transactionMap.load(ar_in);
-      } else {
-        phmap::BinaryOutputArchive ar_out(appendPath(m_bs.m_config_folder, "transactionsmap.dat").c_str());
-        m_bs.m_transactionMap.dump(ar_out);
       }
 
       logger(INFO, BRIGHT_MAGENTA) << operation << "Spent Keys";
-      if (s.type() == ISerializer::INPUT) {
-        phmap::BinaryInputArchive ar_in(appendPath(m_bs.m_config_folder, "spentkeys.dat").c_str());
+      {
+        phmap::BinaryInputArchive ar_in(sideFileName(SPENT_KEYS_FILENAME).c_str());
+        checkSideFileStamp(ar_in, SPENT_KEYS_FILENAME);
         m_bs.m_spent_keys.load(ar_in);
-      } else {
-        phmap::BinaryOutputArchive ar_out(appendPath(m_bs.m_config_folder, "spentkeys.dat").c_str());
-        m_bs.m_spent_keys.dump(ar_out);
       }
 
       logger(INFO, BRIGHT_MAGENTA) << operation << "Outputs";
@@ -261,13 +329,196 @@ namespace CryptoNote
       return m_loaded;
     }
 
+    uint32_t lastBlockIndex() const
+    {
+      return m_lastBlockIndex;
+    }
+
+    const Crypto::Hash &lastBlockHash() const
+    {
+      return m_lastBlockHash;
+    }
+
   private:
+    static const char TRANSACTIONS_MAP_FILENAME[];
+    static const char SPENT_KEYS_FILENAME[];
+    static const uint32_t ENTRIES_PER_LOCK = 65536;
+
+    std::string sideFileName(const char *name) const
+    {
+      return appendPath(m_bs.m_config_folder, name);
+    }
+
+    // Produces the same stream as serialize() does when loading. The binary
+    // serializer writes a blob length like an array size, so the blobs are
+    // written as an array size followed by chunks of raw bytes.
+    void write(BinaryOutputStreamSerializer &s)
+    {
+      std::vector<uint64_t> amounts;
+      std::string tail;
+      {
+        Blockchain::ReadLock lk(m_bs.m_blockchain_lock);
+        m_poppedBlocks = m_bs.m_poppedBlocks;
+        m_lastBlockIndex = static_cast<uint32_t>(m_bs.m_blocks.size() - 1);
+        m_lastBlockHash = m_bs.m_blockIndex.getBlockId(m_lastBlockIndex);
+
+        logger(INFO, BRIGHT_MAGENTA) << "- Saving : Transaction Map";
+        dumpSideFile(TRANSACTIONS_MAP_FILENAME, m_bs.m_transactionMap);
+
+        logger(INFO, BRIGHT_MAGENTA) << "- Saving : Spent Keys";
+        dumpSideFile(SPENT_KEYS_FILENAME, m_bs.m_spent_keys);
+
+        // small and updated in place, so they are copied as they are now
+        StringOutputStream tailStream(tail);
+        BinaryOutputStreamSerializer tailSerializer(tailStream);
+        tailSerializer(m_bs.m_multisignatureOutputs, "multisig_outputs");
+        tailSerializer(m_bs.m_depositIndex, "deposit_index");
+
+        amounts.reserve(m_bs.m_outputs.size());
+        for (const auto &amountOutputs : m_bs.m_outputs)
+        {
+          amounts.push_back(amountOutputs.first);
+        }
+      }
+
+      uint8_t version = CURRENT_BLOCKCACHE_STORAGE_ARCHIVE_VER;
+      s(version, "version");
+      s(m_lastBlockHash, "last_block");
+      s(m_lastBlockIndex, "last_block_index");
+
+      const uint32_t blockCount = m_lastBlockIndex + 1;
+
+      logger(INFO, BRIGHT_MAGENTA) << "- Saving : Block Index";
+      s.beginObject("block_index");
+      size_t size = blockCount;
+      s.beginArray(size, "index");
+      for (uint32_t height = 0; height < blockCount; height += ENTRIES_PER_LOCK)
+      {
+        std::vector<Crypto::Hash> ids;
+        {
+          Blockchain::ReadLock lk(m_bs.m_blockchain_lock);
+          checkNotRolledBack();
+          ids = m_bs.m_blockIndex.getBlockIds(height, blockCount - height < ENTRIES_PER_LOCK ? blockCount - height : ENTRIES_PER_LOCK);
+        }
+
+        for (Crypto::Hash &id : ids)
+        {
+          s(id, "");
+        }
+      }
+      s.endArray();
+      s.endObject();
+
+      logger(INFO, BRIGHT_MAGENTA) << "- Saving : Block Header Index";
+      s.beginObject("block_header_index");
+      size = blockCount * sizeof(BlockHeaderIndex::Entry);
+      s.beginArray(size, "entries");
+      for (uint32_t height = 0; height < blockCount; height += ENTRIES_PER_LOCK)
+      {
+        std::vector<BlockHeaderIndex::Entry> entries;
+        {
+          Blockchain::ReadLock lk(m_bs.m_blockchain_lock);
+          checkNotRolledBack();
+          for (uint32_t i = height; i < blockCount && i < height + ENTRIES_PER_LOCK; ++i)
+          {
+            entries.push_back(m_bs.m_blockHeaderIndex[i]);
+          }
+        }
+
+        s.binary(entries.data(), entries.size() * sizeof(BlockHeaderIndex::Entry), "");
+      }
+      s.endArray();
+      s.endObject();
+
+      logger(INFO, BRIGHT_MAGENTA) << "- Saving : Outputs";
+      size = amounts.size();
+      s.beginArray(size, "outputs");
+      for (uint64_t amount : amounts)
+      {
+        s.beginObject("");
+        s(amount, "key");
+        writeOutputs(s, amount);
+        s.endObject();
+      }
+      s.endArray();
+
+      logger(INFO, BRIGHT_MAGENTA) << "- Saving : Multi-Signature Outputs, Deposit Index";
+      s.binary(&tail[0], tail.size(), "");
+    }
+
+    // the outputs of an amount are ordered by block, the ones added after the
+    // snapshot block are at the end and left out
+    void writeOutputs(BinaryOutputStreamSerializer &s, uint64_t amount)
+    {
+      size_t count = 0;
+      {
+        Blockchain::ReadLock lk(m_bs.m_blockchain_lock);
+        checkNotRolledBack();
+        const std::vector<Blockchain::KeyOutputEntry> &outputs = m_bs.m_outputs.at(amount);
+        auto end = std::upper_bound(outputs.begin(), outputs.end(), m_lastBlockIndex,
+                                    [](uint32_t block, const Blockchain::KeyOutputEntry &output) { return block < output.block; });
+        count = static_cast<size_t>(end - outputs.begin());
+      }
+
+      size_t size = count * sizeof(Blockchain::KeyOutputEntry);
+      s.beginArray(size, "value");
+      for (size_t index = 0; index < count; index += ENTRIES_PER_LOCK)
+      {
+        std::vector<Blockchain::KeyOutputEntry> chunk;
+        {
+          Blockchain::ReadLock lk(m_bs.m_blockchain_lock);
+          checkNotRolledBack();
+          const std::vector<Blockchain::KeyOutputEntry> &outputs = m_bs.m_outputs.at(amount);
+          chunk.assign(outputs.begin() + index, outputs.begin() + std::min(count, index + ENTRIES_PER_LOCK));
+        }
+
+        s.binary(chunk.data(), chunk.size() * sizeof(Blockchain::KeyOutputEntry), "");
+      }
+      s.endArray();
+    }
+
+    template <typename Map>
+    void dumpSideFile(const char *name, Map &map)
+    {
+      phmap::BinaryOutputArchive ar_out((sideFileName(name) + ".tmp").c_str());
+      ar_out.dump(m_lastBlockHash);
+      map.dump(ar_out);
+    }
+
+    // Blocks are only ever appended while no block is popped, so everything
+    // up to the snapshot block is still as it was when the save started.
+    // Must be called under the blockchain lock.
+    void checkNotRolledBack() const
+    {
+      if (m_bs.m_poppedBlocks != m_poppedBlocks)
+      {
+        throw std::runtime_error("the blockchain was rolled back while saving");
+      }
+    }
+
+    // side files start with the hash of the block they were saved at, so
+    // files left over from another snapshot are not mixed into this one
+    void checkSideFileStamp(phmap::BinaryInputArchive &ar_in, const char *name)
+    {
+      Crypto::Hash stamp = NULL_HASH;
+      ar_in.load(&stamp);
+      if (stamp != m_lastBlockHash)
+      {
+        throw std::runtime_error(std::string(name) + " does not belong to the cache snapshot");
+      }
+    }
+
     LoggerRef logger;
     bool m_loaded;
     Blockchain &m_bs;
     Crypto::Hash m_lastBlockHash;
+    uint32_t m_lastBlockIndex;
+    uint64_t m_poppedBlocks;
   };
 
+  const char BlockCacheSerializer::TRANSACTIONS_MAP_FILENAME[] = "transactionsmap.dat";
+  const char BlockCacheSerializer::SPENT_KEYS_FILENAME[] = "spentkeys.dat";
+
   class BlockchainIndicesSerializer
   {
 
@@ -367,6 +618,8 @@ namespace CryptoNote
                                                                                                                               m_tx_pool(tx_pool),
                                                                                                                               m_current_block_cumul_sz_limit(0),
                                                                                                                               m_checkpoints(logger),
+                                                                                                                              m_poppedBlocks(0),
+                                                                                                                              m_savedCacheTail(NULL_HASH),
                                                                                                                               m_blockchainIndexesEnabled(blockchainIndexesEnabled),
                                                                                                                               m_upgradeDetectorV2(currency, m_blocks, BLOCK_MAJOR_VERSION_2, logger)
 
@@ -456,19 +709,19 @@ namespace CryptoNote
 
   bool Blockchain::haveTransaction(const Crypto::Hash &id)
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
     return m_transactionMap.find(id) != m_transactionMap.end();
   }
 
   bool Blockchain::have_tx_keyimg_as_spent(const Crypto::KeyImage &key_im)
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
     return m_spent_keys.find(key_im) != m_spent_keys.end();
   }
 
   uint32_t Blockchain::getCurrentBlockchainHeight()
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
     return static_cast<uint32_t>(m_blocks.size());
   }
 
@@ -482,6 +735,8 @@ namespace CryptoNote
     }
 
     m_config_folder = config_folder;
+    m_lastCacheSave = std::chrono::steady_clock::now();
+    m_processingStatistics = BlockProcessingStatistics();
 
     if (!m_blocks.open(appendPath(config_folder, m_currency.blocksFileName()), appendPath(config_folder, m_currency.blockIndexesFileName()), 1024))
     {
@@ -494,11 +749,17 @@ namespace CryptoNote
       BlockCacheSerializer loader(*this, get_block_hash(m_blocks.back().bl), logger.getLogger());
       loader.load(appendPath(config_folder, m_currency.blocksCacheFileName()));
 
-      if (!loader.loaded())
+      uint32_t cachedBlocks = loader.lastBlockIndex() + 1;
+      if (!loader.loaded() || m_blockHeaderIndex.size() != cachedBlocks || m_blockIndex.size() != cachedBlocks)
       {
         logger(WARNING, BRIGHT_YELLOW) << " No actual blockchain cache found, rebuilding internal structures";
         rebuildCache();
       }
+      else if (cachedBlocks < m_blocks.size())
+      {
+        logger(WARNING, BRIGHT_YELLOW) << " Blockchain cache is " << m_blocks.size() - cachedBlocks << " blocks behind, replaying them";
+        replayCache(cachedBlocks);
+      }
 
       /* Load (or generate) the indices only if Explorer mode is enabled */
       if (m_blockchainIndexesEnabled)
@@ -514,6 +775,7 @@ namespace CryptoNote
     else
     {
       m_blocks.clear();
+      m_blockHeaderIndex.clear();
     }
 
     if (m_blocks.empty())
@@ -559,8 +821,8 @@ namespace CryptoNote
 
     update_next_comulative_size_limit();
 
-    uint64_t timestamp_diff = time(NULL) - m_blocks.back().bl.timestamp;
-    if (!m_blocks.back().bl.timestamp)
+    uint64_t timestamp_diff = time(NULL) - m_blockHeaderIndex.back().timestamp;
+    if (!m_blockHeaderIndex.back().timestamp)
     {
       timestamp_diff = time(NULL) - 1341378000;
     }
@@ -602,72 +864,179 @@ namespace CryptoNote
 
     std::chrono::steady_clock::time_point timePoint = std::chrono::steady_clock::now();
     m_blockIndex.clear();
+    m_blockHeaderIndex.clear();
+    m_blockHeaderIndex.reserve(static_cast<uint32_t>(m_blocks.size()));
     m_transactionMap.clear();
     m_spent_keys.clear();
     m_outputs.clear();
     m_multisignatureOutputs.clear();
-    for (uint32_t b = 0; b < m_blocks.size(); ++b) {
-      if (b % 1000 == 0) {
-        logger(INFO, BRIGHT_MAGENTA) << "Rebuilding Cache for Height " << b << " of " << m_blocks.size();
-      }
+    m_depositIndex.popBlocks(0);
+    replayCache(0);
 
-      const BlockEntry &block = m_blocks[b];
-      Crypto::Hash blockHash = get_block_hash(block.bl);
-      m_blockIndex.push(blockHash);
-      uint64_t interest = 0;
-      for (uint16_t t = 0; t < block.transactions.size(); ++t)
-      {
-        const TransactionEntry &transaction = block.transactions[t];
-        Crypto::Hash transactionHash = getObjectHash(transaction.tx);
-        TransactionIndex transactionIndex = {b, t};
-        m_transactionMap.insert(std::make_pair(transactionHash, transactionIndex));
+    std::chrono::duration<double> duration = std::chrono::steady_clock::now() - timePoint;
+    logger(INFO, BRIGHT_GREEN) << "Rebuilding internal structures took: " << duration.count() << "seconds";
+  }
+
+  // Adds the blocks from startHeight on to the cached indices, which must
+  // already hold all blocks below it.
+  // Blocks are read and hashed on all cores a batch at a time. The cache maps
+  // are then filled by one thread per shard of their submaps: every thread
+  // walks the whole batch in chain order and only touches the keys of its
+  // shard, so the result is the same as adding the blocks one by one.
+  void Blockchain::replayCache(uint32_t startHeight)
+  {
+    struct ReplayedBlock
+    {
+      BlockEntry block;
+      Crypto::Hash hash;
+      std::vector<Crypto::Hash> transactionHashes;
+      uint64_t interest;
+    };
+
+    size_t threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    size_t shards = std::min(threads, m_transactionMap.subcnt());
+    std::vector<ReplayedBlock> batch;
+
+    for (uint32_t batchStart = startHeight; batchStart < m_blocks.size(); batchStart += CACHE_REPLAY_BATCH_SIZE)
+    {
+      logger(INFO, BRIGHT_MAGENTA) << "Rebuilding Cache for Height " << batchStart << " of " << m_blocks.size();
+
+      uint32_t batchEnd = static_cast<uint32_t>(std::min<uint64_t>(batchStart + CACHE_REPLAY_BATCH_SIZE, m_blocks.size()));
+      batch.clear();
+      batch.resize(batchEnd - batchStart);
 
-        // process inputs
-        for (auto &i : transaction.tx.inputs)
+      std::atomic<uint32_t> nextBlock(batchStart);
+      auto reader = [&] {
+        for (uint32_t b = nextBlock++; b < batchEnd; b = nextBlock++)
         {
-          if (i.type() == typeid(KeyInput))
+          ReplayedBlock &replayed = batch[b - batchStart];
           {
-            m_spent_keys.insert(std::make_pair(::boost::get<KeyInput>(i).keyImage, b));
+            Blocks::PinScope pins;
+            replayed.block = m_blocks[b];
           }
-          else if (i.type() == typeid(MultisignatureInput))
+
+          replayed.hash = get_block_hash(replayed.block.bl);
+          replayed.interest = 0;
+          for (const TransactionEntry &transaction : replayed.block.transactions)
           {
-            auto out = ::boost::get<MultisignatureInput>(i);
-            m_multisignatureOutputs[out.amount][out.outputIndex].isUsed = true;
+            replayed.transactionHashes.push_back(getObjectHash(transaction.tx));
+            replayed.interest += m_currency.calculateTotalTransactionInterest(transaction.tx); //block.height); //block.height shows 0 wrongly sometimes apparently
           }
         }
+      };
 
-        // process outputs
-        for (uint16_t o = 0; o < transaction.tx.outputs.size(); ++o)
+      auto indexer = [&](size_t shard) {
+        for (uint32_t b = batchStart; b < batchEnd; ++b)
         {
-          const auto &out = transaction.tx.outputs[o];
-          if (out.target.type() == typeid(KeyOutput))
+          const ReplayedBlock &replayed = batch[b - batchStart];
+          for (uint16_t t = 0; t < replayed.block.transactions.size(); ++t)
           {
-            m_outputs[out.amount].push_back(std::make_pair<>(transactionIndex, o));
-          }
-          else if (out.target.type() == typeid(MultisignatureOutput))
-          {
-            MultisignatureOutputUsage usage = {transactionIndex, o, false};
-            m_multisignatureOutputs[out.amount].push_back(usage);
+            const TransactionEntry &transaction = replayed.block.transactions[t];
+            TransactionIndex transactionIndex = {b, t};
+            if (isInShard(m_transactionMap, replayed.transactionHashes[t], shard, shards))
+            {
+              m_transactionMap.insert(std::make_pair(replayed.transactionHashes[t], transactionIndex));
+            }
+
+            // process inputs
+            for (auto &i : transaction.tx.inputs)
+            {
+              if (i.type() == typeid(KeyInput))
+              {
+                const Crypto::KeyImage &keyImage = ::boost::get<KeyInput>(i).keyImage;
+                if (isInShard(m_spent_keys, keyImage, shard, shards))
+                {
+                  m_spent_keys.insert(std::make_pair(keyImage, b));
+                }
+              }
+              else if (i.type() == typeid(MultisignatureInput))
+              {
+                const auto &out = ::boost::get<MultisignatureInput>(i);
+                if (isInShard(m_multisignatureOutputs, out.amount, shard, shards))
+                {
+                  m_multisignatureOutputs[out.amount][out.outputIndex].isUsed = true;
+                }
+              }
+            }
+
+            // process outputs
+            for (uint16_t o = 0; o < transaction.tx.outputs.size(); ++o)
+            {
+              const auto &out = transaction.tx.outputs[o];
+              if (out.target.type() == typeid(KeyOutput))
+              {
+                if (isInShard(m_outputs, out.amount, shard, shards))
+                {
+                  KeyOutputEntry entry = {::boost::get<KeyOutput>(out.target).key, transaction.tx.unlockTime, transactionIndex.block, transactionIndex.transaction, o};
+                  m_outputs[out.amount].push_back(entry);
+                }
+              }
+              else if (out.target.type() == typeid(MultisignatureOutput))
+              {
+                if (isInShard(m_multisignatureOutputs, out.amount, shard, shards))
+                {
+                  MultisignatureOutputUsage usage = {transactionIndex, o, false};
+                  m_multisignatureOutputs[out.amount].push_back(usage);
+                }
+              }
+            }
           }
         }
+      };
+
+      std::vector<std::future<void>> helpers;
+      for (size_t w = 1; w < threads; ++w)
+      {
+        helpers.push_back(std::async(std::launch::async, reader));
+      }
 
-        interest += m_currency.calculateTotalTransactionInterest(transaction.tx); //block.height); //block.height shows 0 wrongly sometimes apparently
+      reader();
+      for (auto &helper : helpers)
+      {
+        helper.get();
       }
 
-      pushToDepositIndex(block, interest);
-    }
+      helpers.clear();
+      for (size_t shard = 1; shard < shards; ++shard)
+      {
+        helpers.push_back(std::async(std::launch::async, indexer, shard));
+      }
 
-    std::chrono::duration<double> duration = std::chrono::steady_clock::now() - timePoint;
-    logger(INFO, BRIGHT_GREEN) << "Rebuilding internal structures took: " << duration.count() << "seconds";
+      // the block indices are appended in order while the maps are filled
+      for (const ReplayedBlock &replayed : batch)
+      {
+        m_blockIndex.push(replayed.hash);
+        pushToBlockHeaderIndex(replayed.block);
+        pushToDepositIndex(replayed.block, replayed.interest);
+      }
+
+      indexer(0);
+      for (auto &helper : helpers)
+      {
+        helper.get();
+      }
+    }
   }
 
   bool Blockchain::storeCache()
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    std::lock_guard<std::mutex> lk(m_cacheSavingLock);
+    if (m_cacheSaving.valid())
+    {
+      m_cacheSaving.wait();
+    }
+
+    {
+      ReadLock readLock(m_blockchain_lock);
+      if (m_savedCacheTail == getTailId())
+      {
+        logger(INFO, BRIGHT_GREEN) << "Blockchain cache is up to date";
+        return true;
+      }
+    }
 
     logger(INFO, BRIGHT_GREEN) << "Saving blockchain";
-    BlockCacheSerializer ser(*this, getTailId(), logger.getLogger());
-    if (!ser.save(appendPath(m_config_folder, m_currency.blocksCacheFileName())))
+    if (!saveCache())
     {
       logger(ERROR, BRIGHT_RED) << "Failed to save blockchain cache";
       return false;
@@ -676,6 +1045,40 @@ namespace CryptoNote
     return true;
   }
 
+  bool Blockchain::saveCache()
+  {
+    auto saveStart = std::chrono::steady_clock::now();
+    BlockCacheSerializer ser(*this, NULL_HASH, logger.getLogger());
+    bool saved = ser.save(appendPath(m_config_folder, m_currency.blocksCacheFileName()));
+
+    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    m_processingStatistics.cacheSave += std::chrono::steady_clock::now() - saveStart;
+    if (saved)
+    {
+      m_savedCacheTail = ser.lastBlockHash();
+    }
+
+    return saved;
+  }
+
+  void Blockchain::saveCacheInBackground()
+  {
+    // storeCache() holds the lock while it saves
+    std::unique_lock<std::mutex> lk(m_cacheSavingLock, std::try_to_lock);
+    if (!lk.owns_lock() || (m_cacheSaving.valid() && m_cacheSaving.wait_for(std::chrono::seconds(0)) != std::future_status::ready))
+    {
+      return;
+    }
+
+    m_lastCacheSave = std::chrono::steady_clock::now();
+    m_cacheSaving = std::async(std::launch::async, [this] {
+      if (!saveCache())
+      {
+        logger(ERROR, BRIGHT_RED) << "Failed to save blockchain cache";
+      }
+    });
+  }
+
   bool Blockchain::deinit()
   {
     storeCache();
@@ -690,9 +1093,15 @@ namespace CryptoNote
   bool Blockchain::resetAndSetGenesisBlock(const Block &b)
   {
     std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    m_poppedBlocks += m_blocks.size();
     m_blocks.clear();
     m_blockIndex.clear();
+    m_blockHeaderIndex.clear();
     m_transactionMap.clear();
+    {
+      std::lock_guard<std::mutex> offsetsLock(m_rawBlockOffsetsLock);
+      m_rawBlockOffsets.clear();
+    }
 
     m_spent_keys.clear();
     m_alternative_chains.clear();
@@ -711,27 +1120,27 @@ namespace CryptoNote
   Crypto::Hash Blockchain::getTailId(uint32_t &height)
   {
     assert(!m_blocks.empty());
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
     height = getCurrentBlockchainHeight() - 1;
     return getTailId();
   }
 
   Crypto::Hash Blockchain::getTailId()
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
     return m_blocks.empty() ? NULL_HASH : m_blockIndex.getTailId();
   }
 
   std::vector<Crypto::Hash> Blockchain::buildSparseChain()
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
     assert(m_blockIndex.size() != 0);
     return doBuildSparseChain(m_blockIndex.getTailId());
   }
 
   std::vector<Crypto::Hash> Blockchain::buildSparseChain(const Crypto::Hash &startBlockId)
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
     assert(haveBlock(startBlockId));
     return doBuildSparseChain(startBlockId);
   }
@@ -775,14 +1184,14 @@ namespace CryptoNote
 
   Crypto::Hash Blockchain::getBlockIdByHeight(uint32_t height)
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
     assert(height < m_blockIndex.size());
     return m_blockIndex.getBlockId(height);
   }
 
   bool Blockchain::getBlockByHash(const Crypto::Hash &blockHash, Block &b)
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
 
     uint32_t height = 0;
 
@@ -806,27 +1215,31 @@ namespace CryptoNote
 
   bool Blockchain::getBlockHeight(const Crypto::Hash &blockId, uint32_t &blockHeight)
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lock(m_blockchain_lock);
+    ReadLock lock(m_blockchain_lock);
     return m_blockIndex.getBlockHeight(blockId, blockHeight);
   }
 
   difficulty_type Blockchain::getDifficultyForNextBlock()
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
     std::vector<uint64_t> timestamps;
     std::vector<difficulty_type> commulative_difficulties;
     size_t DFC = CryptoNote::parameters::DIFFICULTY_BLOCKS_COUNT;
 
-    size_t offset = m_blocks.size() - std::min(m_blocks.size(), static_cast<uint64_t>(DFC));
+    uint32_t height = m_blockHeaderIndex.size();
+    uint32_t offset = height - std::min(height, static_cast<uint32_t>(DFC));
     if (offset == 0)
     {
       ++offset;
     }
 
-    for (; offset < m_blocks.size(); offset++)
+    timestamps.reserve(height > offset ? height - offset : 0);
+    commulative_difficulties.reserve(height > offset ? height - offset : 0);
+    for (; offset < height; offset++)
     {
-      timestamps.push_back(m_blocks[offset].bl.timestamp);
-      commulative_difficulties.push_back(m_blocks[offset].cumulative_difficulty);
+      const BlockHeaderIndex::Entry &entry = m_blockHeaderIndex[offset];
+      timestamps.push_back(entry.timestamp);
+      commulative_difficulties.push_back(entry.cumulativeDifficulty);
     }
 
     return m_currency.LWMA3Difficulty(timestamps, commulative_difficulties);
@@ -834,41 +1247,40 @@ namespace CryptoNote
 
   uint64_t Blockchain::getBlockTimestamp(uint32_t height)
   {
-    assert(height < m_blocks.size());
-    return m_blocks[height].bl.timestamp;
+    ReadLock lk(m_blockchain_lock);
+    assert(height < m_blockHeaderIndex.size());
+    return m_blockHeaderIndex.timestamp(height);
   }
 
   uint64_t Blockchain::getCoinsInCirculation()
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
-    if (m_blocks.empty())
+    ReadLock lk(m_blockchain_lock);
+    if (m_blockHeaderIndex.empty())
     {
       return 0;
     }
     else
     {
-      return m_blocks.back().already_generated_coins;
+      return m_blockHeaderIndex.back().alreadyGeneratedCoins;
     }
   }
 
   uint64_t Blockchain::coinsEmittedAtHeight(uint64_t height)
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
-    const auto &block = m_blocks[height];
-    return block.already_generated_coins;
+    ReadLock lk(m_blockchain_lock);
+    return m_blockHeaderIndex.alreadyGeneratedCoins(static_cast<uint32_t>(height));
   }
 
   difficulty_type Blockchain::difficultyAtHeight(uint64_t height)
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
-    const auto &current = m_blocks[height];
-    if (height < 1)
+    ReadLock lk(m_blockchain_lock);
+    uint32_t index = static_cast<uint32_t>(height);
+    if (index < 1)
     {
-      return current.cumulative_difficulty;
+      return m_blockHeaderIndex.cumulativeDifficulty(index);
     }
 
-    const auto &previous = m_blocks[height - 1];
-    return current.cumulative_difficulty - previous.cumulative_difficulty;
+    return m_blockHeaderIndex.cumulativeDifficulty(index) - m_blockHeaderIndex.cumulativeDifficulty(index - 1);
   }
 
   uint8_t Blockchain::get_block_major_version_for_height(uint64_t height) const
@@ -1168,7 +1580,7 @@ namespace CryptoNote
 
   bool Blockchain::getBackwardBlocksSize(size_t from_height, std::vector<size_t> &sz, size_t count)
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
     if (!(from_height < m_blocks.size()))
     {
       logger(ERROR, BRIGHT_RED)
@@ -1179,9 +1591,10 @@ namespace CryptoNote
     }
 
     size_t start_offset = (from_height + 1) - std::min((from_height + 1), count);
+    sz.reserve(sz.size() + from_height + 1 - start_offset);
     for (size_t i = start_offset; i != from_height + 1; i++)
     {
-      sz.push_back(m_blocks[i].block_cumulative_size);
+      sz.push_back(m_blockHeaderIndex.blockCumulativeSize(static_cast<uint32_t>(i)));
     }
 
     return true;
@@ -1189,7 +1602,7 @@ namespace CryptoNote
 
   bool Blockchain::get_last_n_blocks_sizes(std::vector<size_t> &sz, size_t count)
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
     if (!m_blocks.size())
     {
       return true;
@@ -1210,7 +1623,7 @@ namespace CryptoNote
       return true;
     }
 
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
     size_t need_elements = m_currency.timestampCheckWindow() - timestamps.size();
 
     if (!(start_top_height < m_blocks.size()))
@@ -1223,7 +1636,7 @@ namespace CryptoNote
 
     do
     {
-      timestamps.push_back(m_blocks[start_top_height].bl.timestamp);
+      timestamps.push_back(m_blockHeaderIndex.timestamp(static_cast<uint32_t>(start_top_height)));
       if (start_top_height == 0)
       {
         break;
@@ -1389,7 +1802,7 @@ namespace CryptoNote
         return false;
       }
 
-      bei.cumulative_difficulty = alt_chain.size() ? it_prev->second.cumulative_difficulty : m_blocks[mainPrevHeight].cumulative_difficulty;
+      bei.cumulative_difficulty = alt_chain.size() ? it_prev->second.cumulative_difficulty : m_blockHeaderIndex.cumulativeDifficulty(mainPrevHeight);
       bei.cumulative_difficulty += current_diff;
 
 #ifdef _DEBUG
@@ -1429,10 +1842,10 @@ namespace CryptoNote
         }
         return r;
       }
-      else if (m_blocks.back().cumulative_difficulty < bei.cumulative_difficulty) //check if difficulty bigger then in main chain
+      else if (m_blockHeaderIndex.back().cumulativeDifficulty < bei.cumulative_difficulty) //check if difficulty bigger then in main chain
       {
         //do reorganize!
-        logger(INFO, BRIGHT_GREEN) << "###### REORGANIZE on height: " << alt_chain.front()->second.height << " of " << m_blocks.size() - 1 << " with cum_difficulty " << m_blocks.back().cumulative_difficulty
+        logger(INFO, BRIGHT_GREEN) << "###### REORGANIZE on height: " << alt_chain.front()->second.height << " of " << m_blocks.size() - 1 << " with cum_difficulty " << m_blockHeaderIndex.back().cumulativeDifficulty
                                    << ENDL << " alternative blockchain size: " << alt_chain.size() << " with cum_difficulty " << bei.cumulative_difficulty;
 
         bool r = switch_to_alternative_blockchain(alt_chain, false);
@@ -1473,7 +1886,7 @@ namespace CryptoNote
 
   bool Blockchain::getBlocks(uint32_t start_offset, uint32_t count, std::list<Block> &blocks, std::list<Transaction> &txs)
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
     if (start_offset >= m_blocks.size())
     {
       return false;
@@ -1496,7 +1909,7 @@ namespace CryptoNote
 
   bool Blockchain::getBlocks(uint32_t start_offset, uint32_t count, std::list<Block> &blocks)
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
     if (start_offset >= m_blocks.size())
     {
       return false;
@@ -1510,31 +1923,169 @@ namespace CryptoNote
     return true;
   }
 
+  bool Blockchain::getRawBlock(uint32_t height, block_complete_entry &entry)
+  {
+    ReadLock lk(m_blockchain_lock);
+    entry.txs.clear();
+    return extractRawBlock(height, entry.block, &entry.txs);
+  }
+
+  bool Blockchain::getRawBlock(const Crypto::Hash &blockId, block_complete_entry &entry)
+  {
+    ReadLock lk(m_blockchain_lock);
+    uint32_t height = 0;
+    if (!m_blockIndex.getBlockHeight(blockId, height))
+    {
+      return false;
+    }
+
+    entry.txs.clear();
+    return extractRawBlock(height, entry.block, &entry.txs);
+  }
+
+  bool Blockchain::getBlockShortInfo(uint32_t height, BlockShortInfo &info, bool includeGlobalIndexes)
+  {
+    ReadLock lk(m_blockchain_lock);
+    if (!extractRawBlock(height, info.block, nullptr))
+    {
+      return false;
+    }
+
+    // the entry keeps the transaction hashes and output indexes, nothing is looked up by hash
+    const BlockEntry &entry = m_blocks[height];
+    if (includeGlobalIndexes)
+    {
+      info.baseTransactionGlobalIndexes = entry.transactions[0].m_global_output_indexes;
+    }
+
+    info.txPrefixes.clear();
+    info.txPrefixes.reserve(entry.bl.transactionHashes.size());
+    for (size_t i = 0; i < entry.bl.transactionHashes.size(); ++i)
+    {
+      const TransactionEntry &transaction = entry.transactions[i + 1];
+      TransactionPrefixInfo prefixInfo;
+      prefixInfo.txHash = entry.bl.transactionHashes[i];
+      prefixInfo.txPrefix = transaction.tx;
+      if (includeGlobalIndexes)
+      {
+        prefixInfo.globalIndexes = transaction.m_global_output_indexes;
+      }
+
+      info.txPrefixes.push_back(std::move(prefixInfo));
+    }
+
+    return true;
+  }
+
+  bool Blockchain::extractRawBlock(uint32_t height, std::string &blockBlob, std::vector<std::string> *transactionBlobs)
+  {
+    std::vector<uint32_t> offsets;
+    if (height >= m_blocks.size() || !getRawBlockOffsets(height, offsets))
+    {
+      return false;
+    }
+
+    Common::ArrayView<uint8_t> blob = m_blocks.getBlob(height);
+    const char *data = reinterpret_cast<const char *>(blob.getData());
+    blockBlob.assign(data, offsets[0]);
+    if (transactionBlobs != nullptr)
+    {
+      transactionBlobs->reserve(transactionBlobs->size() + offsets.size() / 2);
+      for (size_t i = 1; i + 1 < offsets.size(); i += 2)
+      {
+        transactionBlobs->emplace_back(data + offsets[i], offsets[i + 1] - offsets[i]);
+      }
+    }
+
+    return true;
+  }
+
+  // A stored entry is the block followed by the BlockEntry fields and the transaction entries,
+  // the first of which is the base transaction already contained in the block. The entry is
+  // parsed once to find where the blobs end: offsets holds the end of the block blob, then the
+  // begin and end of each other transaction blob.
+  bool Blockchain::getRawBlockOffsets(uint32_t height, std::vector<uint32_t> &offsets)
+  {
+    {
+      std::lock_guard<std::mutex> lk(m_rawBlockOffsetsLock);
+      auto it = m_rawBlockOffsets.find(height);
+      if (it != m_rawBlockOffsets.end())
+      {
+        offsets = it->second;
+        return true;
+      }
+    }
+
+    try
+    {
+      Common::ArrayView<uint8_t> blob = m_blocks.getBlob(height);
+      Common::MemoryInputStream stream(blob.getData(), blob.getSize());
+      BinaryInputStreamSerializer archive(stream);
+
+      Block block;
+      archive(block, "block");
+      offsets.assign(1, static_cast<uint32_t>(stream.getPosition()));
+
+      BlockEntry entry;
+      archive(entry.height, "height");
+      archive(entry.block_cumulative_size, "block_cumulative_size");
+      archive(entry.cumulative_difficulty, "cumulative_difficulty");
+      archive(entry.already_generated_coins, "already_generated_coins");
+
+      size_t count = 0;
+      archive.beginArray(count, "transactions");
+      if (count != block.transactionHashes.size() + 1)
+      {
+        logger(ERROR, BRIGHT_RED) << "Stored block " << height << " has " << count << " transactions, expected " << block.transactionHashes.size() + 1;
+        return false;
+      }
+
+      offsets.reserve(2 * count - 1);
+      for (size_t i = 0; i < count; ++i)
+      {
+        TransactionEntry transaction;
+        size_t begin = stream.getPosition();
+        archive(transaction.tx, "tx");
+        size_t end = stream.getPosition();
+        archive(transaction.m_global_output_indexes, "indexes");
+        if (i != 0)
+        {
+          offsets.push_back(static_cast<uint32_t>(begin));
+          offsets.push_back(static_cast<uint32_t>(end));
+        }
+      }
+
+      archive.endArray();
+    }
+    catch (std::exception &e)
+    {
+      logger(ERROR, BRIGHT_RED) << "Failed to read stored block " << height << ": " << e.what();
+      return false;
+    }
+
+    std::lock_guard<std::mutex> lk(m_rawBlockOffsetsLock);
+    m_rawBlockOffsets.emplace(height, offsets);
+    return true;
+  }
+
   bool Blockchain::handleGetObjects(NOTIFY_REQUEST_GET_OBJECTS::request &arg, NOTIFY_RESPONSE_GET_OBJECTS::request &rsp)
   { //Deprecated. Should be removed with CryptoNoteProtocolHandler.
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
     rsp.current_blockchain_height = getCurrentBlockchainHeight();
-    std::list<Block> blocks;
-    getBlocks(arg.blocks, blocks, rsp.missed_ids);
 
-    for (const auto &bl : blocks)
+    for (const auto &blockId : arg.blocks)
     {
-      std::list<Crypto::Hash> missed_tx_id;
-      std::list<Transaction> txs;
-      getTransactions(bl.transactionHashes, txs, rsp.missed_ids);
-      if (!(!missed_tx_id.size()))
+      uint32_t height = 0;
+      if (!m_blockIndex.getBlockHeight(blockId, height))
       {
-        logger(ERROR, BRIGHT_RED) << "Internal error: have missed missed_tx_id.size()=" << missed_tx_id.size() << ENDL << "for block id = " << get_block_hash(bl);
-        return false;
-      } //WTF???
+        rsp.missed_ids.push_back(blockId);
+        continue;
+      }
+
       rsp.blocks.push_back(block_complete_entry());
-      block_complete_entry &e = rsp.blocks.back();
-      //pack block
-      e.block = asString(toBinaryArray(bl));
-      //pack transactions
-      for (Transaction &tx : txs)
+      if (!extractRawBlock(height, rsp.blocks.back().block, &rsp.blocks.back().txs))
       {
-        e.txs.push_back(asString(toBinaryArray(tx)));
+        return false;
       }
     }
 
@@ -1552,7 +2103,7 @@ namespace CryptoNote
 
   bool Blockchain::getAlternativeBlocks(std::list<Block> &blocks)
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
     for (auto &alt_bl : m_alternative_chains)
     {
       blocks.push_back(alt_bl.second.bl);
@@ -1563,61 +2114,46 @@ namespace CryptoNote
 
   uint32_t Blockchain::getAlternativeBlocksCount()
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
     return static_cast<uint32_t>(m_alternative_chains.size());
   }
 
-  bool Blockchain::add_out_to_get_random_outs(std::vector<std::pair<TransactionIndex, uint16_t>> &amount_outs, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount &result_outs, uint64_t amount, size_t i)
+  // Precondition: m_blockchain_lock is locked.
+  bool Blockchain::add_out_to_get_random_outs(const std::vector<KeyOutputEntry> &amount_outs, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount &result_outs, size_t i, uint32_t height, uint64_t time)
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
-    const Transaction &tx = transactionByIndex(amount_outs[i].first).tx;
-    if (!(tx.outputs.size() > amount_outs[i].second))
-    {
-      logger(ERROR, BRIGHT_RED) << "internal error: in global outs index, transaction out index="
-                                << amount_outs[i].second << " more than transaction outputs = " << tx.outputs.size() << ", for tx id = " << getObjectHash(tx);
-      return false;
-    }
-    if (!(tx.outputs[amount_outs[i].second].target.type() == typeid(KeyOutput)))
-    {
-      logger(ERROR, BRIGHT_RED) << "unknown tx out type";
-      return false;
-    }
-
     //check if transaction is unlocked
-    if (!is_tx_spendtime_unlocked(tx.unlockTime))
+    if (!is_tx_spendtime_unlocked(amount_outs[i].unlockTime, height, time))
       return false;
 
     COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::out_entry &oen = *result_outs.outs.insert(result_outs.outs.end(), COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::out_entry());
     oen.global_amount_index = static_cast<uint32_t>(i);
-    oen.out_key = boost::get<KeyOutput>(tx.outputs[amount_outs[i].second].target).key;
+    oen.out_key = amount_outs[i].key;
     return true;
   }
 
-  size_t Blockchain::find_end_of_allowed_index(const std::vector<std::pair<TransactionIndex, uint16_t>> &amount_outs)
+  // Outputs are stored in chain order, so the ones old enough to be used as
+  // decoys are a prefix of the vector.
+  size_t Blockchain::find_end_of_allowed_index(const std::vector<KeyOutputEntry> &amount_outs, uint32_t height) const
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
-    if (amount_outs.empty())
+    if (height < m_currency.minedMoneyUnlockWindow())
     {
       return 0;
     }
 
-    size_t i = amount_outs.size();
-    do
-    {
-      --i;
-      if (amount_outs[i].first.block + m_currency.minedMoneyUnlockWindow() <= getCurrentBlockchainHeight())
-      {
-        return i + 1;
-      }
-    } while (i != 0);
-
-    return 0;
+    uint32_t lastAllowedBlock = static_cast<uint32_t>(height - m_currency.minedMoneyUnlockWindow());
+    auto end = std::upper_bound(amount_outs.begin(), amount_outs.end(), lastAllowedBlock,
+                                [](uint32_t block, const KeyOutputEntry &output) { return block < output.block; });
+    return static_cast<size_t>(end - amount_outs.begin());
   }
 
   bool Blockchain::getRandomOutsByAmount(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request &req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response &res)
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
 
+    // all amounts of the request are served from one view of the chain
+    uint32_t height = static_cast<uint32_t>(m_blocks.size());
+    uint64_t time = static_cast<uint64_t>(::time(NULL));
+    res.outs.reserve(req.amounts.size());
     for (uint64_t amount : req.amounts)
     {
       COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount &result_outs = *res.outs.insert(res.outs.end(), COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount());
@@ -1629,22 +2165,17 @@ namespace CryptoNote
         continue; //actually this is strange situation, wallet should use some real outs when it lookup for some mix, so, at least one out for this amount should exist
       }
 
-      std::vector<std::pair<TransactionIndex, uint16_t>> &amount_outs = it->second;
+      const std::vector<KeyOutputEntry> &amount_outs = it->second;
       //it is not good idea to use top fresh outs, because it increases possibility of transaction canceling on split
       //lets find upper bound of not fresh outs
-      size_t up_index_limit = find_end_of_allowed_index(amount_outs);
-      if (!(up_index_limit <= amount_outs.size()))
-      {
-        logger(ERROR, BRIGHT_RED) << "internal error: find_end_of_allowed_index returned wrong index=" << up_index_limit << ", with amount_outs.size = " << amount_outs.size();
-        return false;
-      }
-
+      size_t up_index_limit = find_end_of_allowed_index(amount_outs, height);
       if (up_index_limit > 0)
       {
+        result_outs.outs.reserve(std::min<uint64_t>(req.outs_count, up_index_limit));
         ShuffleGenerator<size_t, Crypto::random_engine<size_t>> generator(up_index_limit);
         for (uint64_t j = 0; j < up_index_limit && result_outs.outs.size() < req.outs_count; ++j)
         {
-          add_out_to_get_random_outs(amount_outs, result_outs, amount, generator());
+          add_out_to_get_random_outs(amount_outs, result_outs, generator(), height, time);
         }
       }
     }
@@ -1656,7 +2187,7 @@ namespace CryptoNote
     assert(!qblock_ids.empty());
     assert(qblock_ids.back() == m_blockIndex.getBlockId(0));
 
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
     uint32_t blockIndex;
     // assert above guarantees that method returns true
     m_blockIndex.findSupplement(qblock_ids, blockIndex);
@@ -1665,22 +2196,23 @@ namespace CryptoNote
 
   uint64_t Blockchain::blockDifficulty(size_t i)
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
     if (!(i < m_blocks.size()))
     {
       logger(ERROR, BRIGHT_RED) << "wrong block index i = " << i << " at Blockchain::block_difficulty()";
       return false;
     }
-    if (i == 0)
-      return m_blocks[i].cumulative_difficulty;
+    uint32_t height = static_cast<uint32_t>(i);
+    if (height == 0)
+      return m_blockHeaderIndex.cumulativeDifficulty(height);
 
-    return m_blocks[i].cumulative_difficulty - m_blocks[i - 1].cumulative_difficulty;
+    return m_blockHeaderIndex.cumulativeDifficulty(height) - m_blockHeaderIndex.cumulativeDifficulty(height - 1);
   }
 
   void Blockchain::print_blockchain(uint64_t start_index, uint64_t end_index)
   {
     std::stringstream ss;
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
     if (start_index >= m_blocks.size())
     {
       logger(INFO, BRIGHT_WHITE) << "Wrong starter index set: " << start_index << ", expected max index " << m_blocks.size() - 1;
@@ -1700,7 +2232,7 @@ namespace CryptoNote
   void Blockchain::print_blockchain_index()
   {
     std::stringstream ss;
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
 
     std::vector<Crypto::Hash> blockIds = m_blockIndex.getBlockIds(0, std::numeric_limits<uint32_t>::max());
     logger(INFO, BRIGHT_WHITE) << "Current blockchain index:";
@@ -1715,16 +2247,16 @@ namespace CryptoNote
   void Blockchain::print_blockchain_outs(const std::string &file)
   {
     std::stringstream ss;
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
     for (const outputs_container::value_type &v : m_outputs)
     {
-      const std::vector<std::pair<TransactionIndex, uint16_t>> &vals = v.second;
+      const std::vector<KeyOutputEntry> &vals = v.second;
       if (!vals.empty())
       {
         ss << "amount: " << v.first << ENDL;
         for (size_t i = 0; i != vals.size(); i++)
         {
-          ss << "\t" << getObjectHash(transactionByIndex(vals[i].first).tx) << ": " << vals[i].second << ENDL;
+          ss << "\t" << getObjectHash(transactionByIndex(vals[i].transactionIndex()).tx) << ": " << vals[i].outputIndex << ENDL;
         }
       }
     }
@@ -1746,7 +2278,7 @@ namespace CryptoNote
     assert(!remoteBlockIds.empty());
     assert(remoteBlockIds.back() == m_blockIndex.getBlockId(0));
 
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
     totalBlockCount = getCurrentBlockchainHeight();
     startBlockIndex = findBlockchainSupplement(remoteBlockIds);
 
@@ -1755,7 +2287,7 @@ namespace CryptoNote
 
   bool Blockchain::haveBlock(const Crypto::Hash &id)
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
     if (m_blockIndex.hasBlock(id))
       return true;
 
@@ -1767,13 +2299,13 @@ namespace CryptoNote
 
   size_t Blockchain::getTotalTransactions()
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
     return m_transactionMap.size();
   }
 
   bool Blockchain::getTransactionOutputGlobalIndexes(const Crypto::Hash &tx_id, std::vector<uint32_t> &indexs)
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
     auto it = m_transactionMap.find(tx_id);
     if (it == m_transactionMap.end())
     {
@@ -1798,7 +2330,7 @@ namespace CryptoNote
 
   bool Blockchain::get_out_by_msig_gindex(uint64_t amount, uint64_t gindex, MultisignatureOutput &out)
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
     auto it = m_multisignatureOutputs.find(amount);
     if (it == m_multisignatureOutputs.end())
     {
@@ -1823,7 +2355,7 @@ namespace CryptoNote
 
   bool Blockchain::checkTransactionInputs(const Transaction &tx, uint32_t &max_used_block_height, Crypto::Hash &max_used_block_id, BlockInfo *tail)
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
 
     if (tail)
       tail->id = getTailId(tail->height);
@@ -1862,7 +2394,7 @@ namespace CryptoNote
     return checkTransactionInputs(tx, tx_prefix_hash, pmax_used_block_height);
   }
 
-  bool Blockchain::checkTransactionInputs(const Transaction &tx, const Crypto::Hash &tx_prefix_hash, uint32_t *pmax_used_block_height)
+  bool Blockchain::checkTransactionInputs(const Transaction &tx, const Crypto::Hash &tx_prefix_hash, uint32_t *pmax_used_block_height, const std::vector<bool> *checkedSignatures)
   {
     size_t inputIndex = 0;
     if (pmax_used_block_height)
@@ -1891,7 +2423,8 @@ namespace CryptoNote
 
         if (!isInCheckpointZone(getCurrentBlockchainHeight()))
         {
-          if (!check_tx_input(in_to_key, tx_prefix_hash, tx.signatures[inputIndex], pmax_used_block_height))
+          bool signatureChecked = checkedSignatures != NULL && (*checkedSignatures)[inputIndex];
+          if (!check_tx_input(in_to_key, tx_prefix_hash, tx.signatures[inputIndex], pmax_used_block_height, signatureChecked))
           {
             logger(INFO, BRIGHT_WHITE) << "Failed to check input in transaction " << transactionHash;
             return false;
@@ -1923,31 +2456,27 @@ namespace CryptoNote
   }
 
   bool Blockchain::is_tx_spendtime_unlocked(uint64_t unlock_time)
+  {
+    return is_tx_spendtime_unlocked(unlock_time, getCurrentBlockchainHeight(), static_cast<uint64_t>(time(NULL)));
+  }
+
+  bool Blockchain::is_tx_spendtime_unlocked(uint64_t unlock_time, uint32_t height, uint64_t time) const
   {
     if (unlock_time < m_currency.maxBlockHeight())
     {
       //interpret as block index
-      if (getCurrentBlockchainHeight() - 1 + m_currency.lockedTxAllowedDeltaBlocks() >= unlock_time)
-        return true;
-      else
-        return false;
+      return height - 1 + m_currency.lockedTxAllowedDeltaBlocks() >= unlock_time;
     }
     else
     {
       //interpret as time
-      uint64_t current_time = static_cast<uint64_t>(time(NULL));
-      if (current_time + m_currency.lockedTxAllowedDeltaSeconds() >= unlock_time)
-        return true;
-      else
-        return false;
+      return time + m_currency.lockedTxAllowedDeltaSeconds() >= unlock_time;
     }
-
-    return false;
   }
 
-  bool Blockchain::check_tx_input(const KeyInput &txin, const Crypto::Hash &tx_prefix_hash, const std::vector<Crypto::Signature> &sig, uint32_t *pmax_related_block_height)
+  bool Blockchain::check_tx_input(const KeyInput &txin, const Crypto::Hash &tx_prefix_hash, const std::vector<Crypto::Signature> &sig, uint32_t *pmax_related_block_height, bool signatureChecked)
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
 
     struct outputs_visitor
     {
@@ -1958,22 +2487,16 @@ namespace CryptoNote
       {
       }
 
-      bool handle_output(const Transaction &tx, const TransactionOutput &out, size_t transactionOutputIndex)
+      bool handle_output(const KeyOutputEntry &output)
       {
         //check tx unlock time
-        if (!m_bch.is_tx_spendtime_unlocked(tx.unlockTime))
-        {
-          logger(INFO, BRIGHT_WHITE) << "One of outputs for one of inputs have wrong tx.unlockTime = " << tx.unlockTime;
-          return false;
-        }
-
-        if (out.target.type() != typeid(KeyOutput))
+        if (!m_bch.is_tx_spendtime_unlocked(output.unlockTime))
         {
-          logger(INFO, BRIGHT_WHITE) << "Output have wrong type id, which=" << out.target.which();
+          logger(INFO, BRIGHT_WHITE) << "One of outputs for one of inputs have wrong tx.unlockTime = " << output.unlockTime;
           return false;
         }
 
-        m_results_collector.push_back(&boost::get<KeyOutput>(out.target).key);
+        m_results_collector.push_back(&output.key);
         return true;
       }
     };
@@ -1998,14 +2521,12 @@ namespace CryptoNote
       logger(ERROR, BRIGHT_RED) << "internal error: tx signatures count=" << sig.size() << " mismatch with outputs keys count for inputs=" << output_keys.size();
       return false;
     }
-    if (isInCheckpointZone(getCurrentBlockchainHeight()))
+    if (signatureChecked || isInCheckpointZone(getCurrentBlockchainHeight()))
     {
       return true;
     }
 
-    static const Crypto::KeyImage I = {{0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}};
-    static const Crypto::KeyImage L = {{0xed, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58, 0xd6, 0x9c, 0xf7, 0xa2, 0xde, 0xf9, 0xde, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10}};
-    if (!(scalarmultKey(txin.keyImage, L) == I))
+    if (!isKeyImageInMainSubgroup(txin.keyImage))
     {
       return false;
     }
@@ -2013,6 +2534,127 @@ namespace CryptoNote
     return Crypto::check_ring_signature(tx_prefix_hash, txin.keyImage, output_keys, sig.data());
   }
 
+  // Precondition: m_blockchain_lock is locked.
+  // Verifies key image subgroups and ring signatures of all key inputs on a pool
+  // of worker threads. Returns per transaction and input whether the signature
+  // was found valid; inputs that are not, or whose ring could not be resolved
+  // yet (it refers to outputs of an earlier transaction in the same block), are
+  // left to the ordered check in check_tx_input.
+  std::vector<std::vector<bool>> Blockchain::checkRingSignatures(const std::vector<Transaction> &transactions, const std::vector<Crypto::Hash> &prefixHashes)
+  {
+    struct RingSignatureCheck
+    {
+      size_t transaction;
+      size_t input;
+      std::vector<Crypto::PublicKey> outputKeys;
+      bool valid;
+    };
+
+    struct OutputKeysCollector
+    {
+      std::vector<Crypto::PublicKey> &keys;
+
+      bool handle_output(const KeyOutputEntry &output)
+      {
+        keys.push_back(output.key);
+        return true;
+      }
+    };
+
+    std::vector<std::vector<bool>> checkedSignatures(transactions.size());
+    std::vector<RingSignatureCheck> checks;
+    for (size_t i = 0; i < transactions.size(); ++i)
+    {
+      const Transaction &tx = transactions[i];
+      checkedSignatures[i].resize(tx.inputs.size(), false);
+      for (size_t j = 0; j < tx.inputs.size() && j < tx.signatures.size(); ++j)
+      {
+        if (tx.inputs[j].type() != typeid(KeyInput))
+        {
+          continue;
+        }
+
+        const KeyInput &input = boost::get<KeyInput>(tx.inputs[j]);
+        auto outputs = m_outputs.find(input.amount);
+        if (outputs == m_outputs.end() || input.outputIndexes.empty() ||
+            relative_output_offsets_to_absolute(input.outputIndexes).back() >= outputs->second.size())
+        {
+          continue;
+        }
+
+        RingSignatureCheck check = {i, j, {}, false};
+        OutputKeysCollector collector = {check.outputKeys};
+        if (scanOutputKeysForIndexes(input, collector) && check.outputKeys.size() == tx.signatures[j].size())
+        {
+          checks.push_back(std::move(check));
+        }
+      }
+    }
+
+    if (checks.empty())
+    {
+      return checkedSignatures;
+    }
+
+    // every worker verifies a run of signatures with one batch call
+    std::atomic<size_t> nextCheck(0);
+    auto verify = [&]
+    {
+      std::vector<std::vector<const Crypto::PublicKey *>> rings;
+      std::vector<Crypto::RingSignatureBatchItem> items;
+      std::unique_ptr<bool[]> results(new bool[RING_SIGNATURE_BATCH_SIZE]);
+      for (size_t begin = nextCheck.fetch_add(RING_SIGNATURE_BATCH_SIZE); begin < checks.size(); begin = nextCheck.fetch_add(RING_SIGNATURE_BATCH_SIZE))
+      {
+        size_t end = std::min(begin + RING_SIGNATURE_BATCH_SIZE, checks.size());
+        rings.resize(end - begin);
+        items.clear();
+        for (size_t k = begin; k < end; ++k)
+        {
+          const RingSignatureCheck &check = checks[k];
+          const Transaction &tx = transactions[check.transaction];
+          const KeyInput &input = boost::get<KeyInput>(tx.inputs[check.input]);
+
+          std::vector<const Crypto::PublicKey *> &ring = rings[k - begin];
+          ring.clear();
+          for (const auto &key : check.outputKeys)
+          {
+            ring.push_back(&key);
+          }
+
+          Crypto::RingSignatureBatchItem item = {&prefixHashes[check.transaction], &input.keyImage, ring.data(), ring.size(), tx.signatures[check.input].data()};
+          items.push_back(item);
+        }
+
+        Crypto::check_ring_signatures(items.data(), items.size(), results.get());
+        for (size_t k = begin; k < end; ++k)
+        {
+          checks[k].valid = results[k - begin] && isKeyImageInMainSubgroup(*items[k - begin].image);
+        }
+      }
+    };
+
+    size_t workers = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    workers = std::min(workers, (checks.size() + RING_SIGNATURE_BATCH_SIZE - 1) / RING_SIGNATURE_BATCH_SIZE);
+    std::vector<std::future<void>> helpers;
+    for (size_t w = 1; w < workers; ++w)
+    {
+      helpers.push_back(std::async(std::launch::async, verify));
+    }
+
+    verify();
+    for (auto &helper : helpers)
+    {
+      helper.get();
+    }
+
+    for (const auto &check : checks)
+    {
+      checkedSignatures[check.transaction][check.input] = check.valid;
+    }
+
+    return checkedSignatures;
+  }
+
   uint64_t Blockchain::get_adjusted_time()
   {
     //TODO: add collecting median time
@@ -2062,10 +2704,12 @@ namespace CryptoNote
     }
 
     std::vector<uint64_t> timestamps;
-    size_t offset = m_blocks.size() <= m_currency.timestampCheckWindow() ? 0 : m_blocks.size() - m_currency.timestampCheckWindow();
-    for (; offset != m_blocks.size(); ++offset)
+    uint32_t height = m_blockHeaderIndex.size();
+    uint32_t offset = height <= m_currency.timestampCheckWindow() ? 0 : height - static_cast<uint32_t>(m_currency.timestampCheckWindow());
+    timestamps.reserve(height - offset);
+    for (; offset != height; ++offset)
     {
-      timestamps.push_back(m_blocks[offset].bl.timestamp);
+      timestamps.push_back(m_blockHeaderIndex.timestamp(offset));
     }
 
     return check_block_timestamp(std::move(timestamps), b);
@@ -2152,6 +2796,7 @@ namespace CryptoNote
     //copy block here to let modify block.target
     Block bl = bl_;
     Crypto::Hash id;
+    auto hashingStart = std::chrono::steady_clock::now();
     if (!get_block_hash(bl, id))
     {
       logger(ERROR, BRIGHT_RED) << "Failed to get block hash, possible block has invalid format";
@@ -2160,6 +2805,8 @@ namespace CryptoNote
       return false;
     }
 
+    auto hashingTime = std::chrono::steady_clock::now() - hashingStart;
+
     bool add_result;
 
     // to avoid deadlock lets lock tx_pool for whole add/reorganize process
@@ -2188,16 +2835,17 @@ namespace CryptoNote
         add_result = pushBlock(bl, id, bvc, ++height);
         if (add_result)
         {
+          m_processingStatistics.hashing += hashingTime;
           sendMessage(BlockchainMessage(NewBlockMessage(id)));
 
-          /* @TODO: Add a clause: if (height % 720) && daemonHeight == blockchainHeight
-           * @WHY:  During sync, this will cause the daemon to save the chain every 720 blocks
-           *        which clogs up the daemon client output. */
-          /** Save the blockchain every 720 blocks */
-          /*if (height % 720 == 0)
+          /* Snapshot the cache periodically, so that after a crash only the
+           * blocks added since the last snapshot have to be replayed. It is
+           * written by a background task that takes the shared lock for
+           * one chunk at a time. */
+          if (std::chrono::steady_clock::now() - m_lastCacheSave > std::chrono::seconds(BLOCKCHAIN_CACHE_SAVE_INTERVAL))
           {
-            storeCache();
-          } */
+            saveCacheInBackground();
+          }
         }
       }
     }
@@ -2215,6 +2863,12 @@ namespace CryptoNote
     return m_blocks[index.block].transactions[index.transaction];
   }
 
+  Crypto::Hash Blockchain::getTransactionHashByIndex(TransactionIndex index)
+  {
+    ReadLock lk(m_blockchain_lock);
+    return getObjectHash(transactionByIndex(index).tx);
+  }
+
   bool Blockchain::pushBlock(const Block &blockData, const Crypto::Hash &id, block_verification_context &bvc, uint32_t height)
   {
     std::vector<Transaction> transactions;
@@ -2295,6 +2949,7 @@ namespace CryptoNote
 
     auto longhashTimeStart = std::chrono::steady_clock::now();
     Crypto::Hash proof_of_work = NULL_HASH;
+    bool havePrecomputedProofOfWork = takePrecomputedProofOfWork(blockHash, proof_of_work);
     if (m_checkpoints.is_in_checkpoint_zone(getCurrentBlockchainHeight()))
     {
       if (!m_checkpoints.check_block(getCurrentBlockchainHeight(), blockHash))
@@ -2303,7 +2958,8 @@ namespace CryptoNote
         return false;
       }
     } else {
-      if (!m_currency.checkProofOfWork(m_cn_context, blockData, currentDifficulty, proof_of_work))
+      bool proofOfWorkValid = havePrecomputedProofOfWork ? check_hash(proof_of_work, currentDifficulty) : m_currency.checkProofOfWork(m_cn_context, blockData, currentDifficulty, proof_of_work);
+      if (!proofOfWorkValid)
       {
         logger(INFO, BRIGHT_WHITE) << "Block " << blockHash << ", has too weak proof of work: " << Common::podToHex(proof_of_work) << ", expected difficulty: " << currentDifficulty << " MajorVersion: " << std::to_string(blockData.majorVersion);
         bvc.m_verification_failed = true;
@@ -2311,7 +2967,9 @@ namespace CryptoNote
       }
     }
 
-    auto longhash_calculating_time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - longhashTimeStart).count();
+    auto longhashTime = std::chrono::steady_clock::now() - longhashTimeStart;
+    auto longhash_calculating_time = std::chrono::duration_cast<std::chrono::milliseconds>(longhashTime).count();
+    m_processingStatistics.proofOfWork += longhashTime;
 
     if (!prevalidate_miner_transaction(blockData, static_cast<uint32_t>(m_blocks.size())))
     {
@@ -2320,7 +2978,9 @@ namespace CryptoNote
       return false;
     }
 
+    auto stageStart = std::chrono::steady_clock::now();
     Crypto::Hash minerTransactionHash = getObjectHash(blockData.baseTransaction);
+    m_processingStatistics.hashing += std::chrono::steady_clock::now() - stageStart;
 
     BlockEntry block;
     block.bl = blockData;
@@ -2328,13 +2988,36 @@ namespace CryptoNote
     block.transactions.resize(1);
     block.transactions[0].tx = blockData.baseTransaction;
     TransactionIndex transactionIndex = {block.height, static_cast<uint16_t>(0)};
+    stageStart = std::chrono::steady_clock::now();
     pushTransaction(block, minerTransactionHash, transactionIndex);
+    m_processingStatistics.indexing += std::chrono::steady_clock::now() - stageStart;
 
     size_t coinbase_blob_size = getObjectBinarySize(blockData.baseTransaction);
     size_t cumulative_block_size = coinbase_blob_size;
     uint64_t fee_summary = 0;
     uint64_t interestSummary = 0;
 
+    // Ring signatures are independent of each other, so they are checked up
+    // front in parallel. Key image and output checks stay in block order below.
+    stageStart = std::chrono::steady_clock::now();
+    std::vector<Crypto::Hash> prefixHashes;
+    prefixHashes.reserve(transactions.size());
+    for (const auto &tx : transactions)
+    {
+      prefixHashes.push_back(getObjectHash(*static_cast<const TransactionPrefix *>(&tx)));
+    }
+
+    m_processingStatistics.hashing += std::chrono::steady_clock::now() - stageStart;
+
+    stageStart = std::chrono::steady_clock::now();
+    std::vector<std::vector<bool>> checkedSignatures;
+    if (!isInCheckpointZone(getCurrentBlockchainHeight()))
+    {
+      checkedSignatures = checkRingSignatures(transactions, prefixHashes);
+    }
+
+    m_processingStatistics.inputChecks += std::chrono::steady_clock::now() - stageStart;
+
     for (size_t i = 0; i < transactions.size(); ++i)
     {
       const Crypto::Hash &tx_id = blockData.transactionHashes[i];
@@ -2347,13 +3030,14 @@ namespace CryptoNote
       uint64_t fee = in_amount < out_amount ? CryptoNote::parameters::MINIMUM_FEE : in_amount - out_amount;
 
       bool isTransactionValid = true;
+      stageStart = std::chrono::steady_clock::now();
       if (block.bl.majorVersion == BLOCK_MAJOR_VERSION_1 && transactions[i].version > TRANSACTION_VERSION_1)
       {
         isTransactionValid = false;
         logger(INFO, BRIGHT_WHITE) << "Block " << blockHash << " can't contain transaction " << tx_id << " because it has invalid version " << transactions[i].version;
       }
 
-      if (!checkTransactionInputs(transactions[i]))
+      if (!checkTransactionInputs(transactions[i], prefixHashes[i], NULL, checkedSignatures.empty() ? NULL : &checkedSignatures[i]))
       {
         isTransactionValid = false;
         logger(INFO, BRIGHT_WHITE) << "Block " << blockHash << " has at least one transaction with wrong inputs: " << tx_id;
@@ -2365,6 +3049,8 @@ namespace CryptoNote
         logger(INFO, BRIGHT_WHITE) << "Transaction " << tx_id << " has at least one invalid output";
       }
 
+      m_processingStatistics.inputChecks += std::chrono::steady_clock::now() - stageStart;
+
       if (!isTransactionValid)
       {
         logger(INFO, BRIGHT_WHITE) << "Block " << blockHash << " has at least one invalid transaction: " << tx_id;
@@ -2376,7 +3062,9 @@ namespace CryptoNote
       }
 
       ++transactionIndex.transaction;
+      stageStart = std::chrono::steady_clock::now();
       pushTransaction(block, tx_id, transactionIndex);
+      m_processingStatistics.indexing += std::chrono::steady_clock::now() - stageStart;
 
       cumulative_block_size += blob_size;
       fee_summary += fee;
@@ -2391,7 +3079,7 @@ namespace CryptoNote
 
     int64_t emissionChange = 0;
     uint64_t reward = 0;
-    uint64_t already_generated_coins = m_blocks.empty() ? 0 : m_blocks.back().already_generated_coins;
+    uint64_t already_generated_coins = m_blockHeaderIndex.empty() ? 0 : m_blockHeaderIndex.back().alreadyGeneratedCoins;
     if (!validate_miner_transaction(blockData, block.height, cumulative_block_size, already_generated_coins, fee_summary, reward, emissionChange))
     {
       logger(INFO, BRIGHT_WHITE) << "Block " << blockHash << " has invalid miner transaction";
@@ -2406,11 +3094,15 @@ namespace CryptoNote
     block.already_generated_coins = already_generated_coins + emissionChange + interestSummary;
     if (m_blocks.size() > 0)
     {
-      block.cumulative_difficulty += m_blocks.back().cumulative_difficulty;
+      block.cumulative_difficulty += m_blockHeaderIndex.back().cumulativeDifficulty;
     }
 
+    stageStart = std::chrono::steady_clock::now();
     pushBlock(block);
     pushToDepositIndex(block, interestSummary);
+    m_processingStatistics.indexing += std::chrono::steady_clock::now() - stageStart;
+    ++m_processingStatistics.blocks;
+    m_processingStatistics.transactions += transactions.size();
 
     auto block_processing_time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - blockProcessingStart).count();
 
@@ -2431,19 +3123,19 @@ namespace CryptoNote
 
   uint64_t Blockchain::fullDepositAmount() const
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
     return m_depositIndex.fullDepositAmount();
   }
 
   uint64_t Blockchain::depositAmountAtHeight(size_t height) const
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
     return m_depositIndex.depositAmountAtHeight(static_cast<DepositIndex::DepositHeight>(height));
   }
 
   uint64_t Blockchain::depositInterestAtHeight(size_t height) const
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
     return m_depositIndex.depositInterestAtHeight(static_cast<DepositIndex::DepositHeight>(height));
   }
 
@@ -2478,12 +3170,23 @@ namespace CryptoNote
     m_depositIndex.pushBlock(deposit, interest);
   }
 
+  void Blockchain::pushToBlockHeaderIndex(const BlockEntry &block)
+  {
+    BlockHeaderIndex::Entry entry;
+    entry.timestamp = block.bl.timestamp;
+    entry.cumulativeDifficulty = block.cumulative_difficulty;
+    entry.blockCumulativeSize = block.block_cumulative_size;
+    entry.alreadyGeneratedCoins = block.already_generated_coins;
+    m_blockHeaderIndex.push(entry);
+  }
+
   bool Blockchain::pushBlock(BlockEntry &block)
   {
     Crypto::Hash blockHash = get_block_hash(block.bl);
 
     m_blocks.push_back(block);
     m_blockIndex.push(blockHash);
+    pushToBlockHeaderIndex(block);
 
     m_timestampIndex.add(block.bl.timestamp, blockHash);
     m_generatedTransactionsIndex.add(block.bl);
@@ -2518,11 +3221,19 @@ namespace CryptoNote
 
     m_depositIndex.popBlock();
     m_blocks.pop_back();
+    ++m_poppedBlocks;
     m_blockIndex.pop();
+    m_blockHeaderIndex.pop();
 
     assert(m_blockIndex.size() == m_blocks.size());
 
     m_upgradeDetectorV2.blockPopped();
+    {
+      std::lock_guard<std::mutex> lk(m_rawBlockOffsetsLock);
+      m_rawBlockOffsets.erase(static_cast<uint32_t>(m_blocks.size()));
+    }
+
+    m_tx_pool.on_blockchain_dec(m_blocks.size(), m_blocks.empty() ? NULL_HASH : getTailId());
   }
 
   bool Blockchain::pushTransaction(BlockEntry &block, const Crypto::Hash &transactionHash, TransactionIndex transactionIndex)
@@ -2582,7 +3293,8 @@ namespace CryptoNote
       {
         auto &amountOutputs = m_outputs[transaction.tx.outputs[output].amount];
         transaction.m_global_output_indexes[output] = static_cast<uint32_t>(amountOutputs.size());
-        amountOutputs.push_back(std::make_pair<>(transactionIndex, output));
+        KeyOutputEntry entry = {::boost::get<KeyOutput>(transaction.tx.outputs[output].target).key, transaction.tx.unlockTime, transactionIndex.block, transactionIndex.transaction, output};
+        amountOutputs.push_back(entry);
       }
       else if (transaction.tx.outputs[output].target.type() == typeid(MultisignatureOutput))
       {
@@ -2621,14 +3333,14 @@ namespace CryptoNote
           continue;
         }
 
-        if (amountOutputs->second.back().first.block != transactionIndex.block || amountOutputs->second.back().first.transaction != transactionIndex.transaction)
+        if (amountOutputs->second.back().block != transactionIndex.block || amountOutputs->second.back().transaction != transactionIndex.transaction)
         {
           logger(ERROR, BRIGHT_RED) << "Blockchain consistency broken - invalid transaction index.";
 
           continue;
         }
 
-        if (amountOutputs->second.back().second != transaction.outputs.size() - 1 - outputIndex)
+        if (amountOutputs->second.back().outputIndex != transaction.outputs.size() - 1 - outputIndex)
         {
           logger(ERROR, BRIGHT_RED) << "Blockchain consistency broken - invalid output index.";
 
@@ -2809,6 +3521,7 @@ namespace CryptoNote
 
   bool Blockchain::rollbackBlockchainTo(uint32_t height)
   {
+    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
     logger(INFO) << "Rolling back blockchain to " << height;
     while (height + 1 < m_blocks.size())
     {
@@ -2834,7 +3547,13 @@ namespace CryptoNote
     m_generatedTransactionsIndex.remove(m_blocks.back().bl);
 
     m_blocks.pop_back();
+    ++m_poppedBlocks;
     m_blockIndex.pop();
+    m_blockHeaderIndex.pop();
+    {
+      std::lock_guard<std::mutex> lk(m_rawBlockOffsetsLock);
+      m_rawBlockOffsets.erase(static_cast<uint32_t>(m_blocks.size()));
+    }
 
     assert(m_blockIndex.size() == m_blocks.size());
     return true;
@@ -2842,31 +3561,29 @@ namespace CryptoNote
 
   bool Blockchain::getLowerBound(uint64_t timestamp, uint64_t startOffset, uint32_t &height)
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
 
     assert(startOffset < m_blocks.size());
 
-    auto bound = std::lower_bound(m_blocks.begin() + startOffset, m_blocks.end(), timestamp - m_currency.blockFutureTimeLimit(),
-                                  [](const BlockEntry &b, uint64_t timestamp) { return b.bl.timestamp < timestamp; });
-
-    if (bound == m_blocks.end())
+    uint32_t bound = m_blockHeaderIndex.timestampLowerBound(timestamp - m_currency.blockFutureTimeLimit(), static_cast<uint32_t>(startOffset));
+    if (bound == m_blockHeaderIndex.size())
     {
       return false;
     }
 
-    height = static_cast<uint32_t>(std::distance(m_blocks.begin(), bound));
+    height = bound;
     return true;
   }
 
   std::vector<Crypto::Hash> Blockchain::getBlockIds(uint32_t startHeight, uint32_t maxCount)
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
     return m_blockIndex.getBlockIds(startHeight, maxCount);
   }
 
   bool Blockchain::getBlockContainingTransaction(const Crypto::Hash &txId, Crypto::Hash &blockId, uint32_t &blockHeight)
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
     auto it = m_transactionMap.find(txId);
     if (it == m_transactionMap.end())
     {
@@ -2874,7 +3591,7 @@ namespace CryptoNote
     }
     else
     {
-      blockHeight = m_blocks[it->second.block].height;
+      blockHeight = it->second.block;
       blockId = getBlockIdByHeight(blockHeight);
       return true;
     }
@@ -2882,13 +3599,13 @@ namespace CryptoNote
 
   bool Blockchain::getAlreadyGeneratedCoins(const Crypto::Hash &hash, uint64_t &generatedCoins)
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
 
     // try to find block in main chain
     uint32_t height = 0;
     if (m_blockIndex.getBlockHeight(hash, height))
     {
-      generatedCoins = m_blocks[height].already_generated_coins;
+      generatedCoins = m_blockHeaderIndex.alreadyGeneratedCoins(height);
       return true;
     }
 
@@ -2906,13 +3623,13 @@ namespace CryptoNote
 
   bool Blockchain::getBlockSize(const Crypto::Hash &hash, size_t &size)
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
 
     // try to find block in main chain
     uint32_t height = 0;
     if (m_blockIndex.getBlockHeight(hash, height))
     {
-      size = m_blocks[height].block_cumulative_size;
+      size = m_blockHeaderIndex.blockCumulativeSize(height);
       return true;
     }
 
@@ -2930,7 +3647,7 @@ namespace CryptoNote
 
   bool Blockchain::getMultisigOutputReference(const MultisignatureInput &txInMultisig, std::pair<Crypto::Hash, size_t> &outputReference)
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
     MultisignatureOutputsContainer::const_iterator amountIter = m_multisignatureOutputs.find(txInMultisig.amount);
     if (amountIter == m_multisignatureOutputs.end())
     {
@@ -3007,25 +3724,25 @@ namespace CryptoNote
 
   bool Blockchain::getGeneratedTransactionsNumber(uint32_t height, uint64_t &generatedTransactions)
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
     return m_generatedTransactionsIndex.find(height, generatedTransactions);
   }
 
   bool Blockchain::getOrphanBlockIdsByHeight(uint32_t height, std::vector<Crypto::Hash> &blockHashes)
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
     return m_orthanBlocksIndex.find(height, blockHashes);
   }
 
   bool Blockchain::getBlockIdsByTimestamp(uint64_t timestampBegin, uint64_t timestampEnd, uint32_t blocksNumberLimit, std::vector<Crypto::Hash> &hashes, uint32_t &blocksNumberWithinTimestamps)
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
     return m_timestampIndex.find(timestampBegin, timestampEnd, blocksNumberLimit, hashes, blocksNumberWithinTimestamps);
   }
 
   bool Blockchain::getTransactionIdsByPaymentId(const Crypto::Hash &paymentId, std::vector<Crypto::Hash> &transactionHashes)
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
     return m_paymentIdIndex.find(paymentId, transactionHashes);
   }
 
@@ -3088,9 +3805,41 @@ namespace CryptoNote
     return m_blockIndex.hasBlock(blockId);
   }
 
+  BlockProcessingStatistics Blockchain::getProcessingStatistics() const
+  {
+    ReadLock lk(m_blockchain_lock);
+    return m_processingStatistics;
+  }
+
   bool Blockchain::isInCheckpointZone(const uint32_t height)
   {
     return m_checkpoints.is_in_checkpoint_zone(height);
   }
 
+  void Blockchain::addPrecomputedProofOfWork(const Crypto::Hash &blockHash, const Crypto::Hash &proofOfWork)
+  {
+    std::lock_guard<std::mutex> lk(m_precomputedProofOfWorkLock);
+    // entries of blocks that never reached pushBlock are dropped wholesale
+    if (m_precomputedProofOfWork.size() >= 4 * BLOCKS_SYNCHRONIZING_DEFAULT_COUNT)
+    {
+      m_precomputedProofOfWork.clear();
+    }
+
+    m_precomputedProofOfWork[blockHash] = proofOfWork;
+  }
+
+  bool Blockchain::takePrecomputedProofOfWork(const Crypto::Hash &blockHash, Crypto::Hash &proofOfWork)
+  {
+    std::lock_guard<std::mutex> lk(m_precomputedProofOfWorkLock);
+    auto it = m_precomputedProofOfWork.find(blockHash);
+    if (it == m_precomputedProofOfWork.end())
+    {
+      return false;
+    }
+
+    proofOfWork = it->second;
+    m_precomputedProofOfWork.erase(it);
+    return true;
+  }
+
 } // namespace CryptoNote
@@ -10,20 +10,24 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
+#include <future>
 
 #include "google/sparse_hash_set"
 #include "google/sparse_hash_map"
 #include <parallel_hashmap/phmap.h>
 
 #include "Common/ObserverManager.h"
+#include "Common/RecursiveSharedMutex.h"
 #include "Common/Util.h"
 #include "CryptoNoteCore/BlockIndex.h"
+#include "CryptoNoteCore/BlockHeaderIndex.h"
 #include "CryptoNoteCore/Checkpoints.h"
 #include "CryptoNoteCore/Currency.h"
 #include "CryptoNoteCore/DepositIndex.h"
 #include "CryptoNoteCore/IBlockchainStorageObserver.h"
 #include "CryptoNoteCore/ITransactionValidator.h"
-#include "CryptoNoteCore/SwappedVector.h"
+#include "CryptoNoteCore/MappedBlobVector.h"
 #include "CryptoNoteCore/CryptoNoteFormatUtils.h"
 #include "CryptoNoteCore/TransactionPool.h"
 #include "CryptoNoteCore/BlockchainIndices.h"
@@ -44,8 +48,25 @@ namespace CryptoNote
   struct COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_request;
   struct COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_response;
   struct COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_outs_for_amount;
+  struct block_complete_entry;
+  struct BlockShortInfo;
+  class BlockCacheSerializer;
 
   using CryptoNote::BlockInfo;
+
+  // Time spent adding main chain blocks, by stage, summed since the blockchain
+  // was initialized.
+  struct BlockProcessingStatistics
+  {
+    uint64_t blocks;
+    uint64_t transactions;
+    std::chrono::nanoseconds hashing;     // block and transaction hashes
+    std::chrono::nanoseconds proofOfWork; // or the checkpoint check in the checkpoint zone
+    std::chrono::nanoseconds inputChecks; // ring signatures, key images and outputs
+    std::chrono::nanoseconds indexing;    // pushTransaction and the block file and indexes
+    std::chrono::nanoseconds cacheSave;
+  };
+
   class Blockchain : public CryptoNote::ITransactionValidator
   {
   public:
@@ -75,6 +96,13 @@ namespace CryptoNote
     Crypto::Hash getBlockIdByHeight(uint32_t height);
     bool getBlockByHash(const Crypto::Hash &h, Block &blk);
     bool getBlockHeight(const Crypto::Hash &blockId, uint32_t &blockHeight);
+    // Block and its transactions as stored in the block file, copied from the mapping without
+    // deserializing and re-serializing them. The base transaction is part of the block blob.
+    bool getRawBlock(uint32_t height, block_complete_entry &entry);
+    bool getRawBlock(const Crypto::Hash &blockId, block_complete_entry &entry);
+    // Raw block blob with the prefixes, hashes and, if asked for, output indexes of its
+    // transactions taken from the stored entry.
+    bool getBlockShortInfo(uint32_t height, BlockShortInfo &info, bool includeGlobalIndexes);
 
     template <class archive_t>
     void serialize(archive_t &ar, const unsigned int version);
@@ -123,10 +151,17 @@ namespace CryptoNote
     uint64_t coinsEmittedAtHeight(uint64_t height);
     uint64_t difficultyAtHeight(uint64_t height);
     bool isInCheckpointZone(const uint32_t height);
+    // Long hash of a block computed ahead of pushBlock, e.g. by the sync pipeline.
+    void addPrecomputedProofOfWork(const Crypto::Hash &blockHash, const Crypto::Hash &proofOfWork);
 
     void rebuildCache();
+    // Writes the cache out, waiting for a periodic save that is still being
+    // written. Only one save runs at a time, and none if the last one was
+    // taken at the current tail.
     bool storeCache();
 
+    BlockProcessingStatistics getProcessingStatistics() const;
+
     template <class visitor_t>
     bool scanOutputKeysForIndexes(const KeyInput &tx_in_to_key, visitor_t &vis, uint32_t *pmax_related_block_height = NULL);
 
@@ -136,7 +171,7 @@ namespace CryptoNote
     template <class t_ids_container, class t_blocks_container, class t_missed_container>
     bool getBlocks(const t_ids_container &block_ids, t_blocks_container &blocks, t_missed_container &missed_bs)
     {
-      std::lock_guard<std::recursive_mutex> lk(m_blockchain_lock);
+      ReadLock lk(m_blockchain_lock);
 
       for (const auto &bl_id : block_ids)
       {
@@ -163,7 +198,7 @@ namespace CryptoNote
     template <class t_ids_container, class t_tx_container, class t_missed_container>
     void getBlockchainTransactions(const t_ids_container &txs_ids, t_tx_container &txs, t_missed_container &missed_txs)
     {
-      std::lock_guard<decltype(m_blockchain_lock)> bcLock(m_blockchain_lock);
+      ReadLock bcLock(m_blockchain_lock);
 
       for (const auto &tx_id : txs_ids)
       {
@@ -215,6 +250,26 @@ namespace CryptoNote
       }
     };
 
+    // A key output with the fields needed to use it as a ring member, so
+    // resolving a ring does not load the transactions of the ring members.
+    // The fields are ordered so that the entry has no padding and the block
+    // cache can store vectors of entries as raw bytes.
+    struct KeyOutputEntry
+    {
+      Crypto::PublicKey key;
+      uint64_t unlockTime;
+      uint32_t block;
+      uint16_t transaction;
+      uint16_t outputIndex;
+
+      TransactionIndex transactionIndex() const
+      {
+        return {block, transaction};
+      }
+    };
+
+    Crypto::Hash getTransactionHashByIndex(TransactionIndex index);
+
     bool rollbackBlockchainTo(uint32_t height);
     bool have_tx_keyimg_as_spent(const Crypto::KeyImage &key_im);
 
@@ -267,12 +322,18 @@ namespace CryptoNote
 
     typedef parallel_flat_hash_map<Crypto::KeyImage, uint32_t> key_images_container;
     typedef parallel_flat_hash_map<Crypto::Hash, BlockEntry> blocks_ext_by_hash;
-    typedef parallel_flat_hash_map<uint64_t, std::vector<std::pair<TransactionIndex, uint16_t>>> outputs_container; //Crypto::Hash - tx hash, size_t - index of out in transaction
+    typedef parallel_flat_hash_map<uint64_t, std::vector<KeyOutputEntry>> outputs_container; // amount -> outputs by global index
     typedef parallel_flat_hash_map<uint64_t, std::vector<MultisignatureOutputUsage>> MultisignatureOutputsContainer;
 
     const Currency &m_currency;
     tx_memory_pool &m_tx_pool;
-    mutable std::recursive_mutex m_blockchain_lock; // TODO: add here reader/writer lock
+    // Exclusive for chain modifications, shared for read-only queries.
+    mutable Tools::RecursiveSharedMutex m_blockchain_lock;
+    std::mutex m_precomputedProofOfWorkLock;
+    parallel_flat_hash_map<Crypto::Hash, Crypto::Hash> m_precomputedProofOfWork;
+    // blob boundaries of stored blocks served raw, by height; readers fill it under the shared lock
+    std::mutex m_rawBlockOffsetsLock;
+    parallel_flat_hash_map<uint32_t, std::vector<uint32_t>> m_rawBlockOffsets;
     Crypto::cn_context m_cn_context;
     Tools::ObserverManager<IBlockchainStorageObserver> m_observerManager;
 
@@ -284,17 +345,34 @@ namespace CryptoNote
     std::string m_config_folder;
     Checkpoints m_checkpoints;
     std::atomic<bool> m_is_in_checkpoint_zone;
+    std::chrono::steady_clock::time_point m_lastCacheSave;
+    uint64_t m_poppedBlocks; // blocks taken off the main chain, a cache save fails if it changes
+    Crypto::Hash m_savedCacheTail; // tail block of the last successful cache save
+    BlockProcessingStatistics m_processingStatistics;
 
-    typedef SwappedVector<BlockEntry> Blocks;
+    typedef MappedBlobVector<BlockEntry> Blocks;
     typedef parallel_flat_hash_map<Crypto::Hash, uint32_t> BlockMap;
     typedef parallel_flat_hash_map<Crypto::Hash, TransactionIndex> TransactionMap;
     typedef BasicUpgradeDetector<Blocks> UpgradeDetector;
 
+    // Shared lock for read-only queries. Readers share the block cache, so
+    // blocks read under it are pinned until this ReadLock is released.
+    class ReadLock
+    {
+    public:
+      explicit ReadLock(Tools::RecursiveSharedMutex &mutex) : m_lock(mutex) {}
+
+    private:
+      Tools::SharedLockGuard m_lock;
+      Blocks::PinScope m_pins;
+    };
+
     friend class BlockCacheSerializer;
     friend class BlockchainIndicesSerializer;
 
     Blocks m_blocks;
     CryptoNote::BlockIndex m_blockIndex;
+    CryptoNote::BlockHeaderIndex m_blockHeaderIndex;
     CryptoNote::DepositIndex m_depositIndex;
     TransactionMap m_transactionMap;
     MultisignatureOutputsContainer m_multisignatureOutputs;
@@ -309,18 +387,25 @@ namespace CryptoNote
     IntrusiveLinkedList<MessageQueue<BlockchainMessage>> m_messageQueueList;
 
     Logging::LoggerRef logger;
+    std::mutex m_cacheSavingLock; // guards m_cacheSaving, held by storeCache() while it saves
+    std::future<void> m_cacheSaving; // periodic cache save being written, destroyed first
 
     bool switch_to_alternative_blockchain(std::list<blocks_ext_by_hash::iterator> &alt_chain, bool discard_disconnected_chain);
     bool handle_alternative_block(const Block &b, const Crypto::Hash &id, block_verification_context &bvc, bool sendNewAlternativeBlockMessage = true);
     difficulty_type get_next_difficulty_for_alternative_chain(const std::list<blocks_ext_by_hash::iterator> &alt_chain, BlockEntry &bei);
     void pushToDepositIndex(const BlockEntry &block, uint64_t interest);
+    void replayCache(uint32_t startHeight);
+    bool saveCache();
+    void saveCacheInBackground();
+    void pushToBlockHeaderIndex(const BlockEntry &block);
     bool prevalidate_miner_transaction(const Block &b, uint32_t height);
     bool validate_miner_transaction(const Block &b, uint32_t height, size_t cumulativeBlockSize, uint64_t alreadyGeneratedCoins, uint64_t fee, uint64_t &reward, int64_t &emissionChange);
     bool rollback_blockchain_switching(std::list<Block> &original_chain, size_t rollback_height);
     bool get_last_n_blocks_sizes(std::vector<size_t> &sz, size_t count);
-    bool add_out_to_get_random_outs(std::vector<std::pair<TransactionIndex, uint16_t>> &amount_outs, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_outs_for_amount &result_outs, uint64_t amount, size_t i);
+    bool add_out_to_get_random_outs(const std::vector<KeyOutputEntry> &amount_outs, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_outs_for_amount &result_outs, size_t i, uint32_t height, uint64_t time);
     bool is_tx_spendtime_unlocked(uint64_t unlock_time);
-    size_t find_end_of_allowed_index(const std::vector<std::pair<TransactionIndex, uint16_t>> &amount_outs);
+    bool is_tx_spendtime_unlocked(uint64_t unlock_time, uint32_t height, uint64_t time) const;
+    size_t find_end_of_allowed_index(const std::vector<KeyOutputEntry> &amount_outs, uint32_t height) const;
     bool check_block_timestamp_main(const Block &b);
     bool check_block_timestamp(std::vector<uint64_t> timestamps, const Block &b);
     uint64_t get_adjusted_time();
@@ -330,12 +415,16 @@ namespace CryptoNote
     std::vector<Crypto::Hash> doBuildSparseChain(const Crypto::Hash &startBlockId) const;
     bool getBlockCumulativeSize(const Block &block, size_t &cumulativeSize);
     bool update_next_comulative_size_limit();
-    bool check_tx_input(const KeyInput &txin, const Crypto::Hash &tx_prefix_hash, const std::vector<Crypto::Signature> &sig, uint32_t *pmax_related_block_height = NULL);
-    bool checkTransactionInputs(const Transaction &tx, const Crypto::Hash &tx_prefix_hash, uint32_t *pmax_used_block_height = NULL);
+    bool check_tx_input(const KeyInput &txin, const Crypto::Hash &tx_prefix_hash, const std::vector<Crypto::Signature> &sig, uint32_t *pmax_related_block_height = NULL, bool signatureChecked = false);
+    bool checkTransactionInputs(const Transaction &tx, const Crypto::Hash &tx_prefix_hash, uint32_t *pmax_used_block_height = NULL, const std::vector<bool> *checkedSignatures = NULL);
+    bool takePrecomputedProofOfWork(const Crypto::Hash &blockHash, Crypto::Hash &proofOfWork);
+    std::vector<std::vector<bool>> checkRingSignatures(const std::vector<Transaction> &transactions, const std::vector<Crypto::Hash> &prefixHashes);
     bool checkTransactionInputs(const Transaction &tx, uint32_t *pmax_used_block_height = NULL);
     bool check_tx_outputs(const Transaction &tx) const;
 
     const TransactionEntry &transactionByIndex(TransactionIndex index);
+    bool extractRawBlock(uint32_t height, std::string &blockBlob, std::vector<std::string> *transactionBlobs);
+    bool getRawBlockOffsets(uint32_t height, std::vector<uint32_t> &offsets);
     bool pushBlock(const Block &blockData, const Crypto::Hash &id, block_verification_context &bvc, uint32_t height);
     bool pushBlock(const Block &blockData, const std::vector<Transaction> &transactions, const Crypto::Hash &id, block_verification_context &bvc);
     bool pushBlock(BlockEntry &block);
@@ -355,6 +444,7 @@ namespace CryptoNote
     void sendMessage(const BlockchainMessage &message);
 
     friend class LockedBlockchainStorage;
+    friend class SharedLockedBlockchainStorage;
   };
 
   class LockedBlockchainStorage : boost::noncopyable
@@ -370,19 +460,37 @@ namespace CryptoNote
 
   private:
     Blockchain &m_bc;
-    std::lock_guard<std::recursive_mutex> m_lock;
+    std::lock_guard<Tools::RecursiveSharedMutex> m_lock;
+  };
+
+  // Same as LockedBlockchainStorage, but lets other readers in. Only
+  // read-only Blockchain methods may be called through it.
+  class SharedLockedBlockchainStorage : boost::noncopyable
+  {
+  public:
+    SharedLockedBlockchainStorage(Blockchain &bc)
+        : m_bc(bc), m_lock(bc.m_blockchain_lock) {}
+
+    Blockchain *operator->()
+    {
+      return &m_bc;
+    }
+
+  private:
+    Blockchain &m_bc;
+    Blockchain::ReadLock m_lock;
   };
 
   template <class visitor_t>
   bool Blockchain::scanOutputKeysForIndexes(const KeyInput &tx_in_to_key, visitor_t &vis, uint32_t *pmax_related_block_height)
   {
-    std::lock_guard<std::recursive_mutex> lk(m_blockchain_lock);
+    ReadLock lk(m_blockchain_lock);
     auto it = m_outputs.find(tx_in_to_key.amount);
     if (it == m_outputs.end() || !tx_in_to_key.outputIndexes.size())
       return false;
 
     std::vector<uint32_t> absolute_offsets = relative_output_offsets_to_absolute(tx_in_to_key.outputIndexes);
-    std::vector<std::pair<TransactionIndex, uint16_t>> &amount_outs_vec = it->second;
+    std::vector<KeyOutputEntry> &amount_outs_vec = it->second;
     size_t count = 0;
     for (uint64_t i : absolute_offsets)
     {
@@ -392,21 +500,7 @@ namespace CryptoNote
         return false;
       }
 
-      //auto tx_it = m_transactionMap.find(amount_outs_vec[i].first);
-      //if (!(tx_it != m_transactionMap.end())) { logger(ERROR, BRIGHT_RED) << "Wrong transaction id in output indexes: " << Common::podToHex(amount_outs_vec[i].first); return false; }
-
-      const TransactionEntry &tx = transactionByIndex(amount_outs_vec[i].first);
-
-      if (!(amount_outs_vec[i].second < tx.tx.outputs.size()))
-      {
-        logger(Logging::ERROR, Logging::BRIGHT_RED)
-            << "Wrong index in transaction outputs: "
-            << amount_outs_vec[i].second << ", expected less then "
-            << tx.tx.outputs.size();
-        return false;
-      }
-
-      if (!vis.handle_output(tx.tx, tx.tx.outputs[amount_outs_vec[i].second], amount_outs_vec[i].second))
+      if (!vis.handle_output(amount_outs_vec[i]))
       {
         logger(Logging::INFO) << "Failed to handle_output for output no = " << count << ", with absolute offset " << i;
         return false;
@@ -414,9 +508,9 @@ namespace CryptoNote
 
       if (count++ == absolute_offsets.size() - 1 && pmax_related_block_height)
       {
-        if (*pmax_related_block_height < amount_outs_vec[i].first.block)
+        if (*pmax_related_block_height < amount_outs_vec[i].block)
         {
-          *pmax_related_block_height = amount_outs_vec[i].first.block;
+          *pmax_related_block_height = amount_outs_vec[i].block;
         }
       }
     }
@@ -96,6 +96,10 @@ bool core::isInCheckpointZone(uint32_t height) const {
   return m_checkpoints.is_in_checkpoint_zone(height);
 }
 //-----------------------------------------------------------------------------------
+void core::addPrecomputedProofOfWork(const Crypto::Hash& blockHash, const Crypto::Hash& proofOfWork) {
+  m_blockchain.addPrecomputedProofOfWork(blockHash, proofOfWork);
+}
+//-----------------------------------------------------------------------------------
 void core::init_options(boost::program_options::options_description& /*desc*/) {
 }
 
@@ -121,6 +125,10 @@ bool core::saveBlockchain() {
   return m_blockchain.storeCache();
 }
 
+BlockProcessingStatistics core::getBlockProcessingStatistics() {
+  return m_blockchain.getProcessingStatistics();
+}
+
 bool core::get_blocks(uint32_t start_offset, uint32_t count, std::list<Block>& blocks, std::list<Transaction>& txs) {
   return m_blockchain.getBlocks(start_offset, count, blocks, txs);
 }
@@ -337,7 +345,7 @@ size_t core::get_blockchain_total_transactions() {
 bool core::add_new_tx(const Transaction& tx, const Crypto::Hash& tx_hash, size_t blob_size, tx_verification_context& tvc, bool keeped_by_block, uint32_t height) {
   //Locking on m_mempool and m_blockchain closes possibility to add tx to memory pool which is already in blockchain
   std::lock_guard<decltype(m_mempool)> lk(m_mempool);
-  LockedBlockchainStorage lbs(m_blockchain);
+  SharedLockedBlockchainStorage lbs(m_blockchain);
 
   if (m_blockchain.haveTransaction(tx_hash)) {
     logger(TRACE) << "<< Core.cpp << " << "tx " << tx_hash << " is already in blockchain";
@@ -356,7 +364,7 @@ bool core::get_block_template(Block& b, const AccountPublicAddress& adr, difficu
   uint64_t already_generated_coins;
 
   {
-    LockedBlockchainStorage blockchainLock(m_blockchain);
+    SharedLockedBlockchainStorage blockchainLock(m_blockchain);
     height = m_blockchain.getCurrentBlockchainHeight();
     diffic = m_blockchain.getDifficultyForNextBlock();
     if (!(diffic)) {
@@ -645,7 +653,7 @@ std::vector<Crypto::Hash> core::buildSparseChain() {
 }
 
 std::vector<Crypto::Hash> core::buildSparseChain(const Crypto::Hash& startBlockId) {
-  LockedBlockchainStorage lbs(m_blockchain);
+  SharedLockedBlockchainStorage lbs(m_blockchain);
   assert(m_blockchain.haveBlock(startBlockId));
   return m_blockchain.buildSparseChain(startBlockId);
 }
@@ -655,7 +663,7 @@ bool core::handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, NOTIFY_R
 }
 
 Crypto::Hash core::getBlockIdByHeight(uint32_t height) {
-  LockedBlockchainStorage lbs(m_blockchain);
+  SharedLockedBlockchainStorage lbs(m_blockchain);
   if (height < m_blockchain.getCurrentBlockchainHeight()) {
     return m_blockchain.getBlockIdByHeight(height);
   } else {
@@ -717,6 +725,9 @@ bool core::removeObserver(ICoreObserver* observer) {
 }
 
 void core::blockchainUpdated() {
+  uint32_t topHeight;
+  Crypto::Hash topId = m_blockchain.getTailId(topHeight);
+  m_mempool.on_blockchain_inc(topHeight + 1, topId);
   m_observerManager.notify(&ICoreObserver::blockchainUpdated);
 }
 
@@ -731,7 +742,7 @@ void core::poolUpdated() {
 bool core::queryBlocks(const std::vector<Crypto::Hash>& knownBlockIds, uint64_t timestamp,
   uint32_t& resStartHeight, uint32_t& resCurrentHeight, uint32_t& resFullOffset, std::vector<BlockFullInfo>& entries) {
 
-  LockedBlockchainStorage lbs(m_blockchain);
+  SharedLockedBlockchainStorage lbs(m_blockchain);
 
   uint32_t currentHeight = lbs->getCurrentBlockchainHeight();
   uint32_t startOffset = 0;
@@ -759,36 +770,30 @@ bool core::queryBlocks(const std::vector<Crypto::Hash>& knownBlockIds, uint64_t
     return true;
   }
 
-  std::list<Block> blocks;
-  lbs->getBlocks(startFullOffset, blocksLeft, blocks);
-
-  for (auto& b : blocks) {
+  // ids and timestamps come from the indexes, the stored blobs go out as they are
+  std::vector<Crypto::Hash> fullBlockIds = lbs->getBlockIds(startFullOffset, blocksLeft);
+  uint32_t height = startFullOffset;
+  for (const auto& id : fullBlockIds) {
     BlockFullInfo item;
 
-    item.block_id = get_block_hash(b);
-
-    if (b.timestamp >= timestamp) {
-      // query transactions
-      std::list<Transaction> txs;
-      std::list<Crypto::Hash> missedTxs;
-      lbs->getTransactions(b.transactionHashes, txs, missedTxs);
+    item.block_id = id;
 
-      // fill data
+    if (lbs->getBlockTimestamp(height) >= timestamp) {
       block_complete_entry& completeEntry = item;
-      completeEntry.block = asString(toBinaryArray(b));
-      for (auto& tx : txs) {
-        completeEntry.txs.push_back(asString(toBinaryArray(tx)));
+      if (!lbs->getRawBlock(height, completeEntry)) {
+        return false;
       }
     }
 
     entries.push_back(std::move(item));
+    ++height;
   }
 
   return true;
 }
 
 bool core::findStartAndFullOffsets(const std::vector<Crypto::Hash>& knownBlockIds, uint64_t timestamp, uint32_t& startOffset, uint32_t& startFullOffset) {
-  LockedBlockchainStorage lbs(m_blockchain);
+  SharedLockedBlockchainStorage lbs(m_blockchain);
 
   if (knownBlockIds.empty()) {
     logger(ERROR, BRIGHT_RED) << "<< Core.cpp << " << "knownBlockIds is empty";
@@ -811,7 +816,7 @@ bool core::findStartAndFullOffsets(const std::vector<Crypto::Hash>& knownBlockId
 std::vector<Crypto::Hash> core::findIdsForShortBlocks(uint32_t startOffset, uint32_t startFullOffset) {
   assert(startOffset <= startFullOffset);
 
-  LockedBlockchainStorage lbs(m_blockchain);
+  SharedLockedBlockchainStorage lbs(m_blockchain);
 
   std::vector<Crypto::Hash> result;
   if (startOffset < startFullOffset) {
@@ -822,8 +827,8 @@ std::vector<Crypto::Hash> core::findIdsForShortBlocks(uint32_t startOffset, uint
 }
 
 bool core::queryBlocksLite(const std::vector<Crypto::Hash>& knownBlockIds, uint64_t timestamp, uint32_t& resStartHeight,
-  uint32_t& resCurrentHeight, uint32_t& resFullOffset, std::vector<BlockShortInfo>& entries) {
-  LockedBlockchainStorage lbs(m_blockchain);
+  uint32_t& resCurrentHeight, uint32_t& resFullOffset, std::vector<BlockShortInfo>& entries, bool includeGlobalIndexes) {
+  SharedLockedBlockchainStorage lbs(m_blockchain);
 
   resCurrentHeight = lbs->getCurrentBlockchainHeight();
   resStartHeight = 0;
@@ -847,31 +852,20 @@ bool core::queryBlocksLite(const std::vector<Crypto::Hash>& knownBlockIds, uint6
     return true;
   }
 
-  std::list<Block> blocks;
-  lbs->getBlocks(resFullOffset, blocksLeft, blocks);
-
-  for (auto& b : blocks) {
+  std::vector<Crypto::Hash> fullBlockIds = lbs->getBlockIds(resFullOffset, blocksLeft);
+  uint32_t height = resFullOffset;
+  for (const auto& id : fullBlockIds) {
     BlockShortInfo item;
 
-    item.blockId = get_block_hash(b);
-
-    if (b.timestamp >= timestamp) {
-      std::list<Transaction> txs;
-      std::list<Crypto::Hash> missedTxs;
-      lbs->getTransactions(b.transactionHashes, txs, missedTxs);
-
-      item.block = asString(toBinaryArray(b));
-
-      for (const auto& tx: txs) {
-        TransactionPrefixInfo info;
-        info.txPrefix = tx;
-        info.txHash = getObjectHash(tx);
+    item.blockId = id;
 
-        item.txPrefixes.push_back(std::move(info));
-      }
+    // the wallet would otherwise ask for the indexes of each of its transactions separately
+    if (lbs->getBlockTimestamp(height) >= timestamp && !lbs->getBlockShortInfo(height, item, includeGlobalIndexes)) {
+      return false;
     }
 
     entries.push_back(std::move(item));
+    ++height;
   }
 
   return true;
@@ -898,15 +892,16 @@ bool core::scanOutputkeysForIndices(const KeyInput& txInToKey, std::list<std::pa
   struct outputs_visitor
   {
     std::list<std::pair<Crypto::Hash, size_t>>& m_resultsCollector;
-    outputs_visitor(std::list<std::pair<Crypto::Hash, size_t>>& resultsCollector):m_resultsCollector(resultsCollector){}
-    bool handle_output(const Transaction& tx, const TransactionOutput& out, size_t transactionOutputIndex)
+    Blockchain& m_blockchain;
+    outputs_visitor(std::list<std::pair<Crypto::Hash, size_t>>& resultsCollector, Blockchain& blockchain):m_resultsCollector(resultsCollector), m_blockchain(blockchain){}
+    bool handle_output(const Blockchain::KeyOutputEntry& output)
     {
-      m_resultsCollector.push_back(std::make_pair(getObjectHash(tx), transactionOutputIndex));
+      m_resultsCollector.push_back(std::make_pair(m_blockchain.getTransactionHashByIndex(output.transactionIndex()), output.outputIndex));
       return true;
     }
   };
 
-  outputs_visitor vi(outputReferences);
+  outputs_visitor vi(outputReferences, m_blockchain);
 
   return m_blockchain.scanOutputKeysForIndexes(txInToKey, vi);
 }
@@ -1003,7 +998,7 @@ bool core::getTransactionsByPaymentId(const Crypto::Hash& paymentId, std::vector
 
 std::error_code core::executeLocked(const std::function<std::error_code()>& func) {
   std::lock_guard<decltype(m_mempool)> lk(m_mempool);
-  LockedBlockchainStorage lbs(m_blockchain);
+  SharedLockedBlockchainStorage lbs(m_blockchain);
 
   return func();
 }
@@ -1102,7 +1097,7 @@ bool core::handleIncomingTransaction(const Transaction& tx, const Crypto::Hash&
 
 std::unique_ptr<IBlock> core::getBlock(const Crypto::Hash& blockId) {
   std::lock_guard<decltype(m_mempool)> lk(m_mempool);
-  LockedBlockchainStorage lbs(m_blockchain);
+  SharedLockedBlockchainStorage lbs(m_blockchain);
 
   std::unique_ptr<BlockWithTransactions> blockPtr(new BlockWithTransactions());
   if (!lbs->getBlockByHash(blockId, blockPtr->block)) {
@@ -1123,6 +1118,10 @@ std::unique_ptr<IBlock> core::getBlock(const Crypto::Hash& blockId) {
   return std::move(blockPtr);
 }
 
+bool core::getRawBlock(const Crypto::Hash& blockId, block_complete_entry& entry) {
+  return m_blockchain.getRawBlock(blockId, entry);
+}
+
 bool core::is_key_image_spent(const Crypto::KeyImage& key_im) {
   return m_blockchain.have_tx_keyimg_as_spent(key_im);
 }
@@ -6,6 +6,7 @@
 
 #include "CryptoNoteFormatUtils.h"
 
+#include <algorithm>
 #include <set>
 #include <Logging/LoggerRef.h>
 #include <Common/int-util.h>
@@ -498,6 +499,42 @@ bool get_block_longhash(cn_context &context, const Block& b, Hash& res) {
   return true;
 }
 
+bool get_block_longhashes(cn_context &context, const Block* blocks, size_t count, Hash* res) {
+  BinaryArray blobs[CN_MAX_LANES];
+  const void* data[CN_MAX_LANES];
+  size_t length[CN_MAX_LANES];
+  size_t lanes = std::min<size_t>(context.lanes(), CN_MAX_LANES);
+
+  for (size_t begin = 0; begin < count; begin += lanes) {
+    size_t n = std::min(lanes, count - begin);
+    bool sameAlgorithm = true;
+    for (size_t i = 0; i < n; ++i) {
+      if (!get_block_hashing_blob(blocks[begin + i], blobs[i])) {
+        return false;
+      }
+
+      data[i] = blobs[i].data();
+      length[i] = blobs[i].size();
+      sameAlgorithm = sameAlgorithm && (blocks[begin + i].majorVersion >= 2) == (blocks[begin].majorVersion >= 2);
+    }
+
+    if (!sameAlgorithm) {
+      // the blocks straddle the switch to the new algorithm, hash them one by one
+      for (size_t i = 0; i < n; ++i) {
+        if (!get_block_longhash(context, blocks[begin + i], res[begin + i])) {
+          return false;
+        }
+      }
+    } else if (blocks[begin].majorVersion >= 2) {
+      cn_cache_slow_hash_v0_multi(context, data, length, res + begin, n);
+    } else {
+      cn_slow_hash_multi(context, data, length, res + begin, n);
+    }
+  }
+
+  return true;
+}
+
 std::vector<uint32_t> relative_output_offsets_to_absolute(const std::vector<uint32_t>& off) {
   std::vector<uint32_t> res = off;
   for (size_t i = 1; i < res.size(); i++)
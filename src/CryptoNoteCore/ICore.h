@@ -32,6 +32,7 @@ class Currency;
 class IBlock;
 class ICoreObserver;
 struct Block;
+struct block_complete_entry;
 struct block_verification_context;
 struct BlockFullInfo;
 struct BlockShortInfo;
@@ -83,7 +84,7 @@ public:
   virtual bool queryBlocks(const std::vector<Crypto::Hash>& block_ids, uint64_t timestamp,
     uint32_t& start_height, uint32_t& current_height, uint32_t& full_offset, std::vector<BlockFullInfo>& entries) = 0;
   virtual bool queryBlocksLite(const std::vector<Crypto::Hash>& block_ids, uint64_t timestamp,
-    uint32_t& start_height, uint32_t& current_height, uint32_t& full_offset, std::vector<BlockShortInfo>& entries) = 0;
+    uint32_t& start_height, uint32_t& current_height, uint32_t& full_offset, std::vector<BlockShortInfo>& entries, bool includeGlobalIndexes) = 0;
 
   virtual Crypto::Hash getBlockIdByHeight(uint32_t height) = 0;
   virtual bool getBlockByHash(const Crypto::Hash &h, Block &blk) = 0;
@@ -107,6 +108,7 @@ public:
   virtual std::vector<Crypto::Hash> getTransactionHashesByPaymentId(const Crypto::Hash& paymentId) = 0;
 
   virtual std::unique_ptr<IBlock> getBlock(const Crypto::Hash& blocksId) = 0;
+  virtual bool getRawBlock(const Crypto::Hash& blockId, block_complete_entry& entry) = 0;
   virtual bool handleIncomingTransaction(const Transaction& tx, const Crypto::Hash& txHash, size_t blobSize, tx_verification_context& tvc, bool keptByBlock, uint32_t height) = 0;
   virtual std::error_code executeLocked(const std::function<std::error_code()>& func) = 0;
 
@@ -114,6 +116,7 @@ public:
   virtual bool removeMessageQueue(MessageQueue<BlockchainMessage>& messageQueue) = 0;
 
   virtual bool isInCheckpointZone(uint32_t height) const = 0;
+  virtual void addPrecomputedProofOfWork(const Crypto::Hash& blockHash, const Crypto::Hash& proofOfWork) = 0;
 
   virtual bool saveBlockchain() = 0;
 };
@@ -0,0 +1,595 @@
+// Copyright (c) 2011-2017 The Cryptonote developers
+// Copyright (c) 2017-2018 The Circle Foundation & Conceal Devs
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <fstream>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "Common/ArrayView.h"
+#include "Common/FileMappedVector.h"
+#include "Common/MemoryInputStream.h"
+#include "Common/StdOutputStream.h"
+#include "Serialization/BinaryInputStreamSerializer.h"
+#include "Serialization/BinaryOutputStreamSerializer.h"
+#include "System/MemoryMappedFile.h"
+
+// Drop-in replacement for SwappedVector that reads items straight from a
+// memory mapping of the items file. Item boundaries are kept in a mapped
+// fixed-width offset table (<index file>.offsets), so opening does not parse
+// the index. The legacy size index is still written for compatibility and is
+// used to rebuild the offset table when it is missing, or when its item count
+// or its end offset disagree with the index or the items file size.
+//
+// Reads may run concurrently with each other but not with modifications.
+// Threads reading concurrently must hold a PinScope so that the items they
+// got references to are not freed when another reader evicts them.
+template<class T> class MappedBlobVector {
+public:
+  typedef T value_type;
+
+  class const_iterator {
+  public:
+    typedef ptrdiff_t difference_type;
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef const T* pointer;
+    typedef const T& reference;
+    typedef T value_type;
+
+    const_iterator() {
+    }
+
+    const_iterator(MappedBlobVector* mappedBlobVector, size_t index) : m_mappedBlobVector(mappedBlobVector), m_index(index) {
+    }
+
+    bool operator!=(const const_iterator& other) const {
+      return m_index != other.m_index;
+    }
+
+    bool operator<(const const_iterator& other) const {
+      return m_index < other.m_index;
+    }
+
+    bool operator<=(const const_iterator& other) const {
+      return m_index <= other.m_index;
+    }
+
+    bool operator==(const const_iterator& other) const {
+      return m_index == other.m_index;
+    }
+
+    bool operator>(const const_iterator& other) const {
+      return m_index > other.m_index;
+    }
+
+    bool operator>=(const const_iterator& other) const {
+      return m_index >= other.m_index;
+    }
+
+    const_iterator& operator++() {
+      ++m_index;
+      return *this;
+    }
+
+    const_iterator operator++(int) {
+      const_iterator i = *this;
+      ++m_index;
+      return i;
+    }
+
+    const_iterator& operator--() {
+      --m_index;
+      return *this;
+    }
+
+    const_iterator operator--(int) {
+      const_iterator i = *this;
+      --m_index;
+      return i;
+    }
+
+    const_iterator& operator+=(difference_type n) {
+      m_index += n;
+      return *this;
+    }
+
+    const_iterator& operator-=(difference_type n) {
+      m_index -= n;
+      return *this;
+    }
+
+    const_iterator operator+(difference_type n) const {
+      return const_iterator(m_mappedBlobVector, m_index + n);
+    }
+
+    friend const_iterator operator+(difference_type n, const const_iterator& i) {
+      return const_iterator(i.m_mappedBlobVector, n + i.m_index);
+    }
+
+    difference_type operator-(const const_iterator& other) const {
+      return m_index - other.m_index;
+    }
+
+    const_iterator operator-(difference_type n) const {
+      return const_iterator(m_mappedBlobVector, m_index - n);
+    }
+
+    const T& operator*() const {
+      return (*m_mappedBlobVector)[m_index];
+    }
+
+    const T* operator->() const {
+      return &(*m_mappedBlobVector)[m_index];
+    }
+
+    const T& operator[](difference_type offset) const {
+      return (*m_mappedBlobVector)[m_index + offset];
+    }
+
+    size_t index() const {
+      return m_index;
+    }
+
+  private:
+    MappedBlobVector* m_mappedBlobVector;
+    size_t m_index;
+  };
+
+  // Keeps every item read by the current thread inside the scope alive until
+  // the scope ends. Items read in a nested scope are released when the nested
+  // scope ends, so references must not outlive the scope they were read in.
+  class PinScope {
+  public:
+    PinScope();
+    ~PinScope();
+    PinScope(const PinScope&) = delete;
+    PinScope& operator=(const PinScope&) = delete;
+
+  private:
+    size_t m_mark;
+  };
+
+  MappedBlobVector();
+  MappedBlobVector(const MappedBlobVector&) = delete;
+  ~MappedBlobVector();
+  MappedBlobVector& operator=(const MappedBlobVector&) = delete;
+
+  bool open(const std::string& itemFileName, const std::string& indexFileName, size_t poolSize);
+  void close();
+
+  bool empty() const;
+  uint64_t size() const;
+  const_iterator begin();
+  const_iterator end();
+  const T& operator[](uint64_t index);
+  const T& front();
+  const T& back();
+  void clear();
+  void pop_back();
+  void push_back(const T& item);
+
+  // Serialized item as stored on disk. The view points into the file mapping
+  // and stays valid until the vector is next modified.
+  Common::ArrayView<uint8_t> getBlob(uint64_t index);
+
+private:
+  struct ItemEntry;
+  struct CacheEntry;
+
+  struct ItemEntry {
+  public:
+    std::shared_ptr<T> item;
+    typename std::list<CacheEntry>::iterator cacheIter;
+  };
+
+  struct CacheEntry {
+  public:
+    typename std::map<uint64_t, ItemEntry>::iterator itemIter;
+  };
+
+  std::string m_itemsFileName;
+  std::fstream m_itemsFile;
+  std::fstream m_indexesFile;
+  System::MemoryMappedFile m_itemsMapping;
+  std::list<System::MemoryMappedFile> m_retiredMappings; // outgrown mappings that readers may still point into
+  Common::FileMappedVector<uint64_t> m_offsets; // end offset of every item in the items file
+  size_t m_poolSize;
+  std::map<uint64_t, ItemEntry> m_items;
+  std::list<CacheEntry> m_cache;
+  uint64_t m_cacheHits;
+  uint64_t m_cacheMisses;
+  std::mutex m_mutex; // guards the item cache and the mapping against concurrent readers
+
+  struct Pins {
+    size_t depth;
+    std::vector<std::shared_ptr<const T>> items;
+  };
+
+  static Pins& threadPins();
+  static const T& pin(const std::shared_ptr<T>& item);
+
+  bool openOffsets(const std::string& offsetsFileName, uint64_t count);
+  bool rebuildOffsets(uint64_t count);
+  uint64_t itemsFileSize() const;
+  void writeCount(uint64_t count);
+  std::shared_ptr<T>& prepare(uint64_t index, std::shared_ptr<T>&& item);
+  void releaseRetiredMappings();
+};
+
+template<class T> MappedBlobVector<T>::PinScope::PinScope() {
+  Pins& pins = threadPins();
+  ++pins.depth;
+  m_mark = pins.items.size();
+}
+
+template<class T> MappedBlobVector<T>::PinScope::~PinScope() {
+  Pins& pins = threadPins();
+  --pins.depth;
+  pins.items.erase(pins.items.begin() + m_mark, pins.items.end());
+}
+
+template<class T> typename MappedBlobVector<T>::Pins& MappedBlobVector<T>::threadPins() {
+  static thread_local Pins pins = { 0, {} };
+  return pins;
+}
+
+template<class T> const T& MappedBlobVector<T>::pin(const std::shared_ptr<T>& item) {
+  Pins& pins = threadPins();
+  // loops reading the same item over and over pin it once
+  if (pins.depth > 0 && (pins.items.empty() || pins.items.back() != item)) {
+    pins.items.push_back(item);
+  }
+
+  return *item;
+}
+
+template<class T> MappedBlobVector<T>::MappedBlobVector() : m_poolSize(0), m_cacheHits(0), m_cacheMisses(0) {
+}
+
+template<class T> MappedBlobVector<T>::~MappedBlobVector() {
+  close();
+}
+
+template<class T> bool MappedBlobVector<T>::open(const std::string& itemFileName, const std::string& indexFileName, size_t poolSize) {
+  if (poolSize == 0) {
+    return false;
+  }
+
+  close();
+
+  uint64_t count = 0;
+  m_itemsFile.open(itemFileName, std::ios::in | std::ios::out | std::ios::binary);
+  m_indexesFile.open(indexFileName, std::ios::in | std::ios::out | std::ios::binary);
+  if (m_itemsFile && m_indexesFile) {
+    m_indexesFile.read(reinterpret_cast<char*>(&count), sizeof count);
+    if (!m_indexesFile) {
+      return false;
+    }
+  } else {
+    m_itemsFile.close();
+    m_indexesFile.close();
+    m_itemsFile.clear();
+    m_indexesFile.clear();
+    m_itemsFile.open(itemFileName, std::ios::out | std::ios::binary);
+    m_itemsFile.close();
+    m_itemsFile.open(itemFileName, std::ios::in | std::ios::out | std::ios::binary);
+    m_indexesFile.open(indexFileName, std::ios::out | std::ios::binary);
+    m_indexesFile.write(reinterpret_cast<char*>(&count), sizeof count);
+    if (!m_indexesFile) {
+      return false;
+    }
+
+    m_indexesFile.close();
+    m_indexesFile.open(indexFileName, std::ios::in | std::ios::out | std::ios::binary);
+  }
+
+  if (!openOffsets(indexFileName + ".offsets", count)) {
+    return false;
+  }
+
+  boost::system::error_code ec;
+  uint64_t actualItemsFileSize = boost::filesystem::file_size(itemFileName, ec);
+  if (ec) {
+    return false;
+  }
+
+  // A binary still using SwappedVector appends and pops through the legacy
+  // index only, so an offset table of the right length can still be stale.
+  if (actualItemsFileSize != itemsFileSize()) {
+    if (!rebuildOffsets(count) || actualItemsFileSize < itemsFileSize()) {
+      return false;
+    }
+
+    if (actualItemsFileSize > itemsFileSize()) {
+      // bytes of popped items, cut them so that the next open finds the sizes matching
+      m_itemsFile.close();
+      boost::filesystem::resize_file(itemFileName, itemsFileSize(), ec);
+      m_itemsFile.open(itemFileName, std::ios::in | std::ios::out | std::ios::binary);
+      if (ec || !m_itemsFile) {
+        return false;
+      }
+    }
+  }
+
+  m_itemsFileName = itemFileName;
+  m_poolSize = poolSize;
+  m_items.clear();
+  m_cache.clear();
+  m_cacheHits = 0;
+  m_cacheMisses = 0;
+  return true;
+}
+
+template<class T> void MappedBlobVector<T>::close() {
+  std::error_code ignore;
+  m_itemsMapping.close(ignore);
+  m_retiredMappings.clear();
+  if (m_offsets.isOpened()) {
+    m_offsets.flush();
+    m_offsets.close(ignore);
+  }
+
+  if (m_itemsFile.is_open()) {
+    m_itemsFile.close();
+  }
+
+  if (m_indexesFile.is_open()) {
+    m_indexesFile.close();
+  }
+
+  m_itemsFile.clear();
+  m_indexesFile.clear();
+  m_items.clear();
+  m_cache.clear();
+}
+
+template<class T> bool MappedBlobVector<T>::empty() const {
+  return size() == 0;
+}
+
+template<class T> uint64_t MappedBlobVector<T>::size() const {
+  return m_offsets.isOpened() ? m_offsets.size() : 0;
+}
+
+template<class T> typename MappedBlobVector<T>::const_iterator MappedBlobVector<T>::begin() {
+  return const_iterator(this, 0);
+}
+
+template<class T> typename MappedBlobVector<T>::const_iterator MappedBlobVector<T>::end() {
+  return const_iterator(this, size());
+}
+
+template<class T> const T& MappedBlobVector<T>::operator[](uint64_t index) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto itemIter = m_items.find(index);
+    if (itemIter != m_items.end()) {
+      if (itemIter->second.cacheIter != --m_cache.end()) {
+        m_cache.splice(m_cache.end(), m_cache, itemIter->second.cacheIter);
+      }
+
+      ++m_cacheHits;
+      return pin(itemIter->second.item);
+    }
+  }
+
+  // Deserialize outside the lock so that concurrent misses do not serialize on each other.
+  Common::ArrayView<uint8_t> blob = getBlob(index);
+  std::shared_ptr<T> item = std::make_shared<T>();
+
+  Common::MemoryInputStream stream(blob.getData(), blob.getSize());
+  CryptoNote::BinaryInputStreamSerializer archive(stream);
+  serialize(*item, archive);
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  ++m_cacheMisses;
+  return pin(prepare(index, std::move(item)));
+}
+
+template<class T> const T& MappedBlobVector<T>::front() {
+  return operator[](0);
+}
+
+template<class T> const T& MappedBlobVector<T>::back() {
+  return operator[](size() - 1);
+}
+
+template<class T> Common::ArrayView<uint8_t> MappedBlobVector<T>::getBlob(uint64_t index) {
+  if (index >= size()) {
+    throw std::runtime_error("MappedBlobVector::getBlob");
+  }
+
+  uint64_t itemBegin = index == 0 ? 0 : m_offsets[index - 1];
+  uint64_t itemEnd = m_offsets[index];
+  if (itemBegin == itemEnd) {
+    return Common::ArrayView<uint8_t>(nullptr, 0);
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!m_itemsMapping.isOpened() || m_itemsMapping.size() < itemEnd) {
+    // Items are appended through the stream, so the mapping is extended lazily
+    // the first time a read goes past its end.
+    m_itemsFile.flush();
+    if (!m_itemsFile) {
+      throw std::runtime_error("MappedBlobVector::getBlob");
+    }
+
+    if (m_itemsMapping.isOpened()) {
+      m_retiredMappings.emplace_back();
+      m_retiredMappings.back().swap(m_itemsMapping);
+    }
+
+    m_itemsMapping.open(m_itemsFileName);
+    if (m_itemsMapping.size() < itemEnd) {
+      throw std::runtime_error("MappedBlobVector::getBlob, items file is truncated");
+    }
+  }
+
+  return Common::ArrayView<uint8_t>(m_itemsMapping.data() + itemBegin, static_cast<size_t>(itemEnd - itemBegin));
+}
+
+template<class T> void MappedBlobVector<T>::clear() {
+  writeCount(0);
+  m_offsets.clear();
+  m_items.clear();
+  m_cache.clear();
+  releaseRetiredMappings();
+}
+
+template<class T> void MappedBlobVector<T>::pop_back() {
+  if (empty()) {
+    throw std::runtime_error("MappedBlobVector::pop_back");
+  }
+
+  writeCount(size() - 1);
+  m_offsets.pop_back();
+  auto itemIter = m_items.find(size());
+  if (itemIter != m_items.end()) {
+    m_cache.erase(itemIter->second.cacheIter);
+    m_items.erase(itemIter);
+  }
+
+  releaseRetiredMappings();
+}
+
+template<class T> void MappedBlobVector<T>::push_back(const T& item) {
+  uint64_t oldItemsFileSize = itemsFileSize();
+  uint64_t newItemsFileSize;
+
+  {
+    if (!m_itemsFile) {
+      throw std::runtime_error("MappedBlobVector::push_back");
+    }
+
+    m_itemsFile.seekp(oldItemsFileSize);
+
+    Common::StdOutputStream stream(m_itemsFile);
+    CryptoNote::BinaryOutputStreamSerializer archive(stream);
+    serialize(const_cast<T&>(item), archive);
+
+    m_itemsFile.flush();
+    newItemsFileSize = m_itemsFile.tellp();
+    if (!m_itemsFile) {
+      throw std::runtime_error("MappedBlobVector::push_back");
+    }
+  }
+
+  {
+    if (!m_indexesFile) {
+      throw std::runtime_error("MappedBlobVector::push_back");
+    }
+
+    m_indexesFile.seekp(sizeof(uint64_t) + sizeof(uint32_t) * size());
+    uint32_t itemSize = static_cast<uint32_t>(newItemsFileSize - oldItemsFileSize);
+    m_indexesFile.write(reinterpret_cast<char*>(&itemSize), sizeof itemSize);
+    if (!m_indexesFile) {
+      throw std::runtime_error("MappedBlobVector::push_back");
+    }
+
+    writeCount(size() + 1);
+  }
+
+  m_offsets.push_back(newItemsFileSize);
+
+  prepare(size() - 1, std::make_shared<T>(item));
+  releaseRetiredMappings();
+}
+
+template<class T> bool MappedBlobVector<T>::openOffsets(const std::string& offsetsFileName, uint64_t count) {
+  try {
+    m_offsets.open(offsetsFileName, Common::FileMappedVectorOpenMode::OPEN_OR_CREATE);
+  } catch (std::exception&) {
+    boost::system::error_code ignore;
+    boost::filesystem::remove(offsetsFileName, ignore);
+    try {
+      m_offsets.open(offsetsFileName, Common::FileMappedVectorOpenMode::CREATE);
+    } catch (std::exception&) {
+      return false;
+    }
+  }
+
+  // Elements are flushed on close; the legacy index is the source of truth after a crash.
+  m_offsets.setAutoFlush(false);
+  if (m_offsets.size() != count) {
+    return rebuildOffsets(count);
+  }
+
+  return true;
+}
+
+template<class T> bool MappedBlobVector<T>::rebuildOffsets(uint64_t count) {
+  std::vector<uint32_t> itemSizes(static_cast<size_t>(count));
+  m_indexesFile.seekg(sizeof(uint64_t));
+  if (count > 0) {
+    m_indexesFile.read(reinterpret_cast<char*>(itemSizes.data()), sizeof(uint32_t) * itemSizes.size());
+    if (!m_indexesFile) {
+      return false;
+    }
+  }
+
+  m_offsets.clear();
+  m_offsets.reserve(count);
+  uint64_t itemsFileSize = 0;
+  for (uint32_t itemSize : itemSizes) {
+    itemsFileSize += itemSize;
+    m_offsets.push_back(itemsFileSize);
+  }
+
+  m_offsets.flush();
+  return true;
+}
+
+template<class T> uint64_t MappedBlobVector<T>::itemsFileSize() const {
+  return empty() ? 0 : m_offsets.back();
+}
+
+template<class T> void MappedBlobVector<T>::writeCount(uint64_t count) {
+  if (!m_indexesFile) {
+    throw std::runtime_error("MappedBlobVector::writeCount");
+  }
+
+  m_indexesFile.seekp(0);
+  m_indexesFile.write(reinterpret_cast<char*>(&count), sizeof count);
+  m_indexesFile.flush();
+  if (!m_indexesFile) {
+    throw std::runtime_error("MappedBlobVector::writeCount");
+  }
+}
+
+template<class T> std::shared_ptr<T>& MappedBlobVector<T>::prepare(uint64_t index, std::shared_ptr<T>&& item) {
+  // another reader may have loaded the same item in the meantime
+  auto existing = m_items.find(index);
+  if (existing != m_items.end()) {
+    return existing->second.item;
+  }
+
+  if (m_items.size() == m_poolSize) {
+    auto cacheIter = m_cache.begin();
+    m_items.erase(cacheIter->itemIter);
+    m_cache.erase(cacheIter);
+  }
+
+  auto itemIter = m_items.insert(std::make_pair(index, ItemEntry()));
+  CacheEntry cacheEntry = { itemIter.first };
+  auto cacheIter = m_cache.insert(m_cache.end(), cacheEntry);
+  itemIter.first->second.item = std::move(item);
+  itemIter.first->second.cacheIter = cacheIter;
+  return itemIter.first->second.item;
+}
+
+template<class T> void MappedBlobVector<T>::releaseRetiredMappings() {
+  // Only called from modifications, which never run concurrently with readers.
+  m_retiredMappings.clear();
+}
@@ -42,6 +42,7 @@ namespace CryptoNote
     m_handler(handler),
     m_pausers_count(0),
     m_threads_total(0),
+    m_lanes(CN_MINER_LANES),
     m_starter_nonce(0),
     m_last_hr_merge_time(0),
     m_hashes(0),
@@ -170,6 +171,15 @@ namespace CryptoNote
       logger(INFO) << "Loaded " << m_extra_messages.size() << " extra messages, current index " << m_config.current_extra_message_index;
     }
 
+    if (config.miningLanes > CN_MAX_LANES) {
+      logger(ERROR, BRIGHT_RED) << "Mining lanes must be 1.." << CN_MAX_LANES;
+      return false;
+    }
+
+    if (config.miningLanes > 0) {
+      m_lanes = config.miningLanes;
+    }
+
     if(!config.startMining.empty()) {
       if (!m_currency.parseAccountAddressString(config.startMining, m_mine_address)) {
         logger(ERROR) << "Target account address " << config.startMining << " has wrong format, starting daemon canceled";
@@ -347,8 +357,10 @@ namespace CryptoNote
     uint32_t nonce = m_starter_nonce + th_local_index;
     difficulty_type local_diff = 0;
     uint32_t local_template_ver = 0;
-    Crypto::cn_context context;
-    Block b;
+    Crypto::cn_context context(m_lanes);
+    // one copy of the template per lane, only the nonces change between rounds
+    Block blocks[CN_MAX_LANES];
+    Crypto::Hash hashes[CN_MAX_LANES];
 
     while(!m_stop)
     {
@@ -360,7 +372,9 @@ namespace CryptoNote
 
       if(local_template_ver != m_template_no) {
         std::unique_lock<std::mutex> lk(m_template_lock);
-        b = m_template;
+        for (size_t i = 0; i < m_lanes; ++i) {
+          blocks[i] = m_template;
+        }
         local_diff = m_diffic;
         lk.unlock();
 
@@ -375,30 +389,36 @@ namespace CryptoNote
         continue;
       }
 
-      b.nonce = nonce;
-      Crypto::Hash h;
-      if (!m_stop && !get_block_longhash(context, b, h)) {
+      // the lanes hash the nonces this thread would have tried in sequence
+      for (size_t i = 0; i < m_lanes; ++i) {
+        blocks[i].nonce = nonce + static_cast<uint32_t>(i) * m_threads_total;
+      }
+
+      if (!m_stop && !get_block_longhashes(context, blocks, m_lanes, hashes)) {
         logger(ERROR) << "Failed to get block long hash";
         m_stop = true;
       }
 
-      if (!m_stop && check_hash(h, local_diff))
-      {
-        //we lucky!
-        ++m_config.current_extra_message_index;
+      for (size_t i = 0; i < m_lanes && !m_stop; ++i) {
+        if (check_hash(hashes[i], local_diff))
+        {
+          //we lucky!
+          ++m_config.current_extra_message_index;
 
-        logger(INFO, GREEN) << "Found block for difficulty: " << local_diff;
+          logger(INFO, GREEN) << "Found block for difficulty: " << local_diff;
 
-        if(!m_handler.handle_block_found(b)) {
-          --m_config.current_extra_message_index;
-        } else {
-          //success update, lets update config
-          Common::saveStringToFile(m_config_folder_path + "/" + CryptoNote::parameters::MINER_CONFIG_FILE_NAME, storeToJson(m_config));
+          if(!m_handler.handle_block_found(blocks[i])) {
+            --m_config.current_extra_message_index;
+          } else {
+            //success update, lets update config
+            Common::saveStringToFile(m_config_folder_path + "/" + CryptoNote::parameters::MINER_CONFIG_FILE_NAME, storeToJson(m_config));
+            break;
+          }
         }
       }
 
-      nonce += m_threads_total;
-      ++m_hashes;
+      nonce += static_cast<uint32_t>(m_lanes) * m_threads_total;
+      m_hashes += m_lanes;
     }
     logger(INFO) << "Miner thread stopped ["<< th_local_index << "]";
     return true;
@@ -68,6 +68,7 @@ namespace CryptoNote {
     difficulty_type m_diffic;
 
     std::atomic<uint32_t> m_threads_total;
+    size_t m_lanes; // hashes computed at once by every thread
     std::atomic<int32_t> m_pausers_count;
     std::mutex m_miners_count_lock;
 
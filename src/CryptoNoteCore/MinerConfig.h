@@ -23,6 +23,7 @@ public:
   std::string extraMessages;
   std::string startMining;
   uint32_t miningThreads;
+  uint32_t miningLanes; // 0 means CN_MINER_LANES
 };
 
 } //namespace CryptoNote
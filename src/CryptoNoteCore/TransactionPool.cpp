@@ -115,6 +115,9 @@ namespace CryptoNote
                                m_timeProvider(timeProvider),
                                m_txCheckInterval(60, timeProvider),
                                m_fee_index(boost::get<1>(m_transactions)),
+                               m_readyValid(false),
+                               m_readyTop(NULL_HASH),
+                               m_readyHeight(0),
                                logger(log, "txpool")
   {
   }
@@ -246,6 +249,12 @@ namespace CryptoNote
         logger(WARNING, BRIGHT_YELLOW) << " Transaction already exists at inserting in memory pool";
         return false;
       }
+
+      // transactions kept by a block are checked at the next chain top
+      if (!keptByBlock && m_readyValid && ttl.ttl == 0 && isReadyForBlock(*txd_p.first, m_readyHeight))
+      {
+        m_readyTransactions.insert(&*txd_p.first);
+      }
       m_paymentIdIndex.add(txd.tx);
       m_timestampIndex.add(txd.receiveTime, txd.id);
 
@@ -293,6 +302,8 @@ namespace CryptoNote
     blobSize = txd.blobSize;
     fee = txd.fee;
 
+    // the transaction goes into a block, pool transactions spending the same inputs cannot follow it
+    removeConflictingReadyTransactions(txd);
     removeTransaction(it);
     return true;
   }
@@ -346,11 +357,15 @@ namespace CryptoNote
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::on_blockchain_inc(uint64_t new_block_height, const Crypto::Hash &top_block_id)
   {
+    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    updateReadyTransactions(top_block_id, static_cast<uint32_t>(new_block_height));
     return true;
   }
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::on_blockchain_dec(uint64_t new_block_height, const Crypto::Hash &top_block_id)
   {
+    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    invalidateReadyTransactions();
     return true;
   }
   //---------------------------------------------------------------------------------
@@ -429,6 +444,115 @@ namespace CryptoNote
     return ss.str();
   }
   //---------------------------------------------------------------------------------
+  bool tx_memory_pool::isReadyForBlock(const TransactionDetails &txd, uint32_t height) const
+  {
+    uint64_t inputs_amount = m_currency.getTransactionAllInputsAmount(txd.tx, height);
+    uint64_t outputs_amount = get_outs_money_amount(txd.tx);
+
+    if (outputs_amount > inputs_amount)
+    {
+      logger(WARNING, BRIGHT_YELLOW) << "Transaction, with id " << txd.id << " uses more money than it has: uses " << m_currency.formatAmount(outputs_amount) << ", has " << m_currency.formatAmount(inputs_amount)
+                                     << " and will not be included in the block template";
+      return false;
+    }
+
+    TransactionCheckInfo checkInfo(txd);
+    return is_transaction_ready_to_go(txd.tx, checkInfo);
+  }
+  //---------------------------------------------------------------------------------
+  // Brings the set to a new chain top. While the chain only grows, a ready
+  // transaction stays ready: the ones spending the inputs of a new block were
+  // dropped when the block took its transactions. So only the transactions
+  // outside the set are re-checked, new blocks may have unlocked them. After
+  // blocks were popped the whole pool is re-checked.
+  void tx_memory_pool::updateReadyTransactions(const Crypto::Hash &topBlockId, uint32_t height)
+  {
+    if (m_readyValid && m_readyTop == topBlockId && m_readyHeight == height)
+    {
+      return;
+    }
+
+    if (!m_readyValid || height < m_readyHeight)
+    {
+      m_readyTransactions.clear();
+    }
+
+    for (const auto &txd : m_transactions)
+    {
+      if (m_readyTransactions.count(&txd) == 0 && m_ttlIndex.count(txd.id) == 0 && isReadyForBlock(txd, height))
+      {
+        m_readyTransactions.insert(&txd);
+      }
+    }
+
+    m_readyValid = true;
+    m_readyTop = topBlockId;
+    m_readyHeight = height;
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::invalidateReadyTransactions()
+  {
+    m_readyTransactions.clear();
+    m_readyValid = false;
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::removeConflictingReadyTransactions(const TransactionDetails &txd)
+  {
+    std::set<GlobalOutput> multisignatureOutputs;
+    for (const auto &in : txd.tx.inputs)
+    {
+      if (in.type() == typeid(KeyInput))
+      {
+        auto it = m_spent_key_images.find(boost::get<KeyInput>(in).keyImage);
+        if (it == m_spent_key_images.end())
+        {
+          continue;
+        }
+
+        for (const auto &id : it->second)
+        {
+          auto conflicting = m_transactions.find(id);
+          if (id != txd.id && conflicting != m_transactions.end())
+          {
+            m_readyTransactions.erase(&*conflicting);
+          }
+        }
+      }
+      else if (in.type() == typeid(MultisignatureInput))
+      {
+        const auto &msig = boost::get<MultisignatureInput>(in);
+        multisignatureOutputs.insert(GlobalOutput(msig.amount, msig.outputIndex));
+      }
+    }
+
+    if (multisignatureOutputs.empty())
+    {
+      return;
+    }
+
+    for (auto it = m_readyTransactions.begin(); it != m_readyTransactions.end();)
+    {
+      bool conflicts = false;
+      for (const auto &in : (*it)->tx.inputs)
+      {
+        if (in.type() == typeid(MultisignatureInput))
+        {
+          const auto &msig = boost::get<MultisignatureInput>(in);
+          conflicts = conflicts || multisignatureOutputs.count(GlobalOutput(msig.amount, msig.outputIndex)) != 0;
+        }
+      }
+
+      if (conflicts && (*it)->id != txd.id)
+      {
+        it = m_readyTransactions.erase(it);
+      }
+      else
+      {
+        ++it;
+      }
+    }
+  }
+  //---------------------------------------------------------------------------------
   bool tx_memory_pool::fill_block_template(
       Block &bl,
       size_t median_size,
@@ -444,26 +568,13 @@ namespace CryptoNote
     size_t max_total_size = (125 * median_size) / 100 - m_currency.minerTxBlobReservedSize();
     max_total_size = std::min(max_total_size, maxCumulativeSize);
 
+    updateReadyTransactions(bl.previousBlockHash, height);
+
     BlockTemplate blockTemplate;
 
-    for (auto it = m_fee_index.rbegin(); it != m_fee_index.rend(); ++it)
+    for (auto it = m_readyTransactions.rbegin(); it != m_readyTransactions.rend(); ++it)
     {
-      const auto &txd = *it;
-
-      if (m_ttlIndex.count(txd.id) > 0)
-      {
-        continue;
-      }
-
-      uint64_t inputs_amount = m_currency.getTransactionAllInputsAmount(txd.tx, height);
-      uint64_t outputs_amount = get_outs_money_amount(txd.tx);
-
-      if (outputs_amount > inputs_amount)
-      {
-        logger(WARNING, BRIGHT_YELLOW) << "Transaction, with id " << txd.id << " uses more money than it has: uses " << m_currency.formatAmount(outputs_amount) << ", has " << m_currency.formatAmount(inputs_amount)
-                                       << " and will not be included in the block template";
-        continue;
-      }
+      const auto &txd = **it;
 
       size_t blockSizeLimit = (txd.fee == 0) ? median_size : max_total_size;
       if (blockSizeLimit < total_size + txd.blobSize)
@@ -471,10 +582,7 @@ namespace CryptoNote
         continue;
       }
 
-      TransactionCheckInfo checkInfo(txd);
-      bool ready = is_transaction_ready_to_go(txd.tx, checkInfo);
-
-      if (ready && blockTemplate.addTransaction(txd.id, txd.tx))
+      if (blockTemplate.addTransaction(txd.id, txd.tx))
       {
         total_size += txd.blobSize;
         fee += txd.fee;
@@ -506,6 +614,7 @@ namespace CryptoNote
     {
       logger(ERROR) << "Failed to load memory pool from file " << state_file_path;
 
+      invalidateReadyTransactions();
       m_transactions.clear();
       m_spent_key_images.clear();
       m_spentOutputs.clear();
@@ -579,6 +688,7 @@ namespace CryptoNote
 
     if (s.type() == ISerializer::INPUT)
     {
+      invalidateReadyTransactions();
       m_transactions.clear();
       readSequence<TransactionDetails>(std::inserter(m_transactions, m_transactions.end()), "transactions", s);
     }
@@ -660,6 +770,7 @@ namespace CryptoNote
 
   tx_memory_pool::tx_container_t::iterator tx_memory_pool::removeTransaction(tx_memory_pool::tx_container_t::iterator i)
   {
+    m_readyTransactions.erase(&*i);
     removeTransactionInputs(i->id, i->tx, i->keptByBlock);
     m_paymentIdIndex.remove(i->tx);
     m_timestampIndex.remove(i->receiveTime, i->id);
@@ -91,6 +91,8 @@ namespace CryptoNote {
     //gets tx and remove it from pool
     bool take_tx(const Crypto::Hash &id, Transaction &tx, size_t& blobSize, uint64_t& fee);
 
+    // Called with the height of the next block once blocks were added to or
+    // popped from the main chain, keeps the block-ready set current.
     bool on_blockchain_inc(uint64_t new_block_height, const Crypto::Hash& top_block_id);
     bool on_blockchain_dec(uint64_t new_block_height, const Crypto::Hash& top_block_id);
 
@@ -162,6 +164,17 @@ namespace CryptoNote {
       }
     };
 
+    struct ReadyTransactionComparator {
+      bool operator()(const TransactionDetails* lhs, const TransactionDetails* rhs) const {
+        TransactionPriorityComparator better;
+        return better(*lhs, *rhs) || (!better(*rhs, *lhs) && std::less<const TransactionDetails*>()(lhs, rhs));
+      }
+    };
+
+    // Transactions that can go into a block on top of m_readyTop, in fee order.
+    // Pool elements do not move, so the set keeps pointers into m_transactions.
+    typedef std::set<const TransactionDetails*, ReadyTransactionComparator> ready_set_t;
+
     typedef hashed_unique<BOOST_MULTI_INDEX_MEMBER(TransactionDetails, Crypto::Hash, id)> main_index_t;
     typedef ordered_non_unique<identity<TransactionDetails>, TransactionPriorityComparator> fee_index_t;
 
@@ -182,6 +195,10 @@ namespace CryptoNote {
     tx_container_t::iterator removeTransaction(tx_container_t::iterator i);
     bool removeExpiredTransactions();
     bool is_transaction_ready_to_go(const Transaction& tx, TransactionCheckInfo& txd) const;
+    bool isReadyForBlock(const TransactionDetails& txd, uint32_t height) const;
+    void updateReadyTransactions(const Crypto::Hash& topBlockId, uint32_t height);
+    void invalidateReadyTransactions();
+    void removeConflictingReadyTransactions(const TransactionDetails& txd);
 
     void buildIndices();
 
@@ -198,6 +215,10 @@ namespace CryptoNote {
 
     tx_container_t m_transactions;  
     tx_container_t::nth_index<1>::type& m_fee_index;
+    ready_set_t m_readyTransactions;
+    bool m_readyValid;
+    Crypto::Hash m_readyTop;
+    uint32_t m_readyHeight;
     std::unordered_map<Crypto::Hash, uint64_t> m_recentlyDeletedTransactions;
 
     Logging::LoggerRef logger;
@@ -0,0 +1,305 @@
+// Copyright (c) 2011-2017 The Cryptonote developers
+// Copyright (c) 2017-2018 The Circle Foundation & Conceal Devs
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <boost/uuid/uuid.hpp>
+
+#include "crypto/hash.h"
+
+namespace CryptoNote {
+
+// Splits the blocks needed during synchronization into spans, hands them out
+// to several peers at once and gives the downloaded blocks back in chain
+// order. Peers may be on different chains: a span is only handed to peers
+// whose chain entries contain all of its blocks, and a span is given back
+// once the block it builds on is no longer scheduled, so spans of one chain
+// never wait for spans of another. A span that is not delivered within the
+// timeout is handed to the next free peer that has it; a late delivery from
+// the original peer is then rejected.
+// Not thread safe, used from the dispatcher thread only.
+template<class BlockEntry> class BlockSyncScheduler {
+public:
+  typedef boost::uuids::uuid PeerId;
+  typedef std::chrono::steady_clock Clock;
+
+  BlockSyncScheduler(size_t spanSize, Clock::duration spanTimeout) : m_spanSize(spanSize), m_spanTimeout(spanTimeout) {
+  }
+
+  // Schedules the blocks of a chain entry the peer sent, in chain order.
+  // Blocks for which 'isKnown' returns true are skipped, blocks that are
+  // already scheduled are only marked as available from the peer.
+  template<class IsKnown> void addBlocks(const PeerId& peer, const std::vector<Crypto::Hash>& chainEntry, IsKnown isKnown) {
+    std::unordered_set<Crypto::Hash>& peerIds = m_peerIds[peer];
+    for (size_t i = 1; i < chainEntry.size(); ++i) {
+      const Crypto::Hash& id = chainEntry[i];
+      const Crypto::Hash& previousId = chainEntry[i - 1];
+      if (isKnown(id)) {
+        continue;
+      }
+
+      peerIds.insert(id);
+      if (!m_scheduledIds.insert(id).second) {
+        continue;
+      }
+
+      if (m_spans.empty() || m_spans.back().blockIds.back() != previousId || m_spans.back().blockIds.size() >= m_spanSize ||
+        m_spans.back().assigned || m_spans.back().delivered) {
+        m_spans.push_back(Span());
+        m_spans.back().previousId = previousId;
+      }
+
+      m_spans.back().blockIds.push_back(id);
+    }
+  }
+
+  bool empty() const {
+    return m_spans.empty();
+  }
+
+  // Whether a span the peer can deliver is still waiting to be downloaded or committed.
+  bool hasPendingBlocks(const PeerId& peer) const {
+    auto it = m_peerIds.find(peer);
+    return it != m_peerIds.end() && !it->second.empty();
+  }
+
+  // Picks the first span the peer has that nobody is downloading, or else the
+  // first one it has that timed out on another peer.
+  bool assign(const PeerId& peer, std::vector<Crypto::Hash>& blockIds) {
+    auto peerIt = m_peerIds.find(peer);
+    if (peerIt == m_peerIds.end()) {
+      return false;
+    }
+
+    Span* candidate = nullptr;
+    Clock::time_point now = Clock::now();
+    for (auto& span : m_spans) {
+      if (span.delivered || (span.assigned && (candidate != nullptr || span.peer == peer || now - span.requestTime <= m_spanTimeout))) {
+        continue;
+      }
+
+      if (!contains(peerIt->second, span.blockIds)) {
+        continue;
+      }
+
+      candidate = &span;
+      if (!span.assigned) {
+        break;
+      }
+    }
+
+    if (candidate == nullptr) {
+      return false;
+    }
+
+    candidate->assigned = true;
+    candidate->peer = peer;
+    candidate->requestTime = now;
+    blockIds = candidate->blockIds;
+    return true;
+  }
+
+  // Stores the blocks of the span assigned to the peer. Returns false, and
+  // makes the span available to other peers, if the peer has no span or did
+  // not deliver all of its blocks.
+  bool deliver(const PeerId& peer, const std::vector<Crypto::Hash>& blockIds, std::vector<BlockEntry>&& blocks) {
+    for (auto& span : m_spans) {
+      if (!span.assigned || span.delivered || span.peer != peer) {
+        continue;
+      }
+
+      if (blockIds.size() != span.blockIds.size() || blocks.size() != blockIds.size()) {
+        span.assigned = false;
+        return false;
+      }
+
+      std::unordered_map<Crypto::Hash, size_t> positions;
+      for (size_t i = 0; i < span.blockIds.size(); ++i) {
+        positions[span.blockIds[i]] = i;
+      }
+
+      span.blocks.resize(blocks.size());
+      for (size_t i = 0; i < blockIds.size(); ++i) {
+        auto it = positions.find(blockIds[i]);
+        if (it == positions.end()) {
+          span.blocks.clear();
+          span.assigned = false;
+          return false;
+        }
+
+        span.blocks[it->second] = std::move(blocks[i]);
+        positions.erase(it);
+      }
+
+      span.delivered = true;
+      return true;
+    }
+
+    return false;
+  }
+
+  // The peer answered that it doesn't have these blocks, it may have switched
+  // to another chain since it sent its chain entry. Spans containing them are
+  // not handed to the peer anymore, spans nobody else has are dropped.
+  void notAvailable(const PeerId& peer, const std::vector<Crypto::Hash>& blockIds) {
+    auto peerIt = m_peerIds.find(peer);
+    if (peerIt == m_peerIds.end()) {
+      return;
+    }
+
+    std::unordered_set<Crypto::Hash> missed(blockIds.begin(), blockIds.end());
+    for (auto& span : m_spans) {
+      if (span.delivered || !intersects(missed, span.blockIds)) {
+        continue;
+      }
+
+      if (span.assigned && span.peer == peer) {
+        span.assigned = false;
+      }
+
+      for (const auto& id : span.blockIds) {
+        peerIt->second.erase(id);
+      }
+    }
+
+    dropUnavailable();
+  }
+
+  // Forgets the peer. The spans it was downloading are handed to other peers
+  // that have them, spans nobody else has are dropped.
+  void release(const PeerId& peer) {
+    for (auto& span : m_spans) {
+      if (span.assigned && !span.delivered && span.peer == peer) {
+        span.assigned = false;
+      }
+    }
+
+    m_peerIds.erase(peer);
+    dropUnavailable();
+  }
+
+  // Takes the first delivered span whose preceding block is not scheduled
+  // anymore, that is committed or known before it was scheduled.
+  bool popReady(std::vector<BlockEntry>& blocks, std::vector<Crypto::Hash>& blockIds, PeerId& peer) {
+    for (auto it = m_spans.begin(); it != m_spans.end(); ++it) {
+      if (!it->delivered || m_scheduledIds.count(it->previousId) != 0) {
+        continue;
+      }
+
+      blocks = std::move(it->blocks);
+      blockIds = std::move(it->blockIds);
+      peer = it->peer;
+      forget(blockIds);
+      m_spans.erase(it);
+      return true;
+    }
+
+    return false;
+  }
+
+  // The blocks were rejected, drops the spans building on them.
+  void reject(const std::vector<Crypto::Hash>& blockIds) {
+    std::unordered_set<Crypto::Hash> dropped(blockIds.begin(), blockIds.end());
+    dropDescendants(dropped);
+  }
+
+private:
+  struct Span {
+    Span() : previousId(), assigned(false), delivered(false), peer() {
+    }
+
+    Crypto::Hash previousId;
+    std::vector<Crypto::Hash> blockIds;
+    bool assigned;
+    bool delivered;
+    PeerId peer;
+    Clock::time_point requestTime;
+    std::vector<BlockEntry> blocks;
+  };
+
+  static bool contains(const std::unordered_set<Crypto::Hash>& ids, const std::vector<Crypto::Hash>& blockIds) {
+    for (const auto& id : blockIds) {
+      if (ids.count(id) == 0) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  static bool intersects(const std::unordered_set<Crypto::Hash>& ids, const std::vector<Crypto::Hash>& blockIds) {
+    for (const auto& id : blockIds) {
+      if (ids.count(id) != 0) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  void forget(const std::vector<Crypto::Hash>& blockIds) {
+    for (const auto& id : blockIds) {
+      m_scheduledIds.erase(id);
+    }
+
+    for (auto& peerIds : m_peerIds) {
+      for (const auto& id : blockIds) {
+        peerIds.second.erase(id);
+      }
+    }
+  }
+
+  // Drops undelivered spans no peer has all blocks of, and the spans building on them.
+  void dropUnavailable() {
+    std::unordered_set<Crypto::Hash> dropped;
+    for (auto it = m_spans.begin(); it != m_spans.end();) {
+      bool available = it->delivered;
+      for (auto peerIt = m_peerIds.begin(); !available && peerIt != m_peerIds.end(); ++peerIt) {
+        available = contains(peerIt->second, it->blockIds);
+      }
+
+      if (available) {
+        ++it;
+        continue;
+      }
+
+      dropped.insert(it->blockIds.begin(), it->blockIds.end());
+      forget(it->blockIds);
+      it = m_spans.erase(it);
+    }
+
+    dropDescendants(dropped);
+  }
+
+  // Spans come after the spans they build on, so one pass finds all descendants.
+  void dropDescendants(std::unordered_set<Crypto::Hash>& dropped) {
+    for (auto it = m_spans.begin(); it != m_spans.end();) {
+      if (dropped.count(it->previousId) == 0) {
+        ++it;
+        continue;
+      }
+
+      dropped.insert(it->blockIds.begin(), it->blockIds.end());
+      forget(it->blockIds);
+      it = m_spans.erase(it);
+    }
+  }
+
+  size_t m_spanSize;
+  Clock::duration m_spanTimeout;
+  std::deque<Span> m_spans;
+  std::unordered_set<Crypto::Hash> m_scheduledIds;
+  std::map<PeerId, std::unordered_set<Crypto::Hash>> m_peerIds; // scheduled blocks each peer's chain entries contain
+};
+
+}
@@ -48,10 +48,15 @@ namespace CryptoNote
   struct TransactionPrefixInfo {
     Crypto::Hash txHash;
     TransactionPrefix txPrefix;
+    // output global indexes, only filled when requested
+    std::vector<uint32_t> globalIndexes;
 
     void serialize(ISerializer& s) {
       KV_MEMBER(txHash);
       KV_MEMBER(txPrefix);
+      if (s.type() == ISerializer::INPUT || !globalIndexes.empty()) {
+        KV_MEMBER(globalIndexes);
+      }
     }
   };
 
@@ -59,11 +64,16 @@ namespace CryptoNote
     Crypto::Hash blockId;
     std::string block;
     std::vector<TransactionPrefixInfo> txPrefixes;
+    // output global indexes of the coinbase transaction, only filled when requested
+    std::vector<uint32_t> baseTransactionGlobalIndexes;
 
     void serialize(ISerializer& s) {
       KV_MEMBER(blockId);
       KV_MEMBER(block);
       KV_MEMBER(txPrefixes);
+      if (s.type() == ISerializer::INPUT || !baseTransactionGlobalIndexes.empty()) {
+        KV_MEMBER(baseTransactionGlobalIndexes);
+      }
     }
   };
 
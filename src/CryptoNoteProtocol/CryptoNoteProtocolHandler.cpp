@@ -6,10 +6,13 @@
 
 #include "CryptoNoteProtocolHandler.h"
 
+#include <algorithm>
 #include <future>
+#include <thread>
 #include <boost/scope_exit.hpp>
 #include <boost/uuid/uuid_io.hpp>
 #include <System/Dispatcher.h>
+#include <System/RemoteContext.h>
 
 #include "CryptoNoteCore/CryptoNoteBasicImpl.h"
 #include "CryptoNoteCore/CryptoNoteFormatUtils.h"
@@ -27,6 +30,11 @@ namespace CryptoNote
 namespace
 {
 
+// blocks prepared on worker threads per step of the sync pipeline
+const size_t SYNC_PREPARE_CHUNK_SIZE = 16;
+// a span of blocks not delivered within this time is requested from another connection
+const std::chrono::seconds SYNC_SPAN_TIMEOUT(30);
+
 template <class t_parametr>
 bool post_notify(IP2pEndpoint &p2p, typename t_parametr::request &arg, const CryptoNoteConnectionContext &context)
 {
@@ -48,6 +56,8 @@ CryptoNoteProtocolHandler::CryptoNoteProtocolHandler(const Currency &currency, S
                                                                                                                                                                                   m_stop(false),
                                                                                                                                                                                   m_observedHeight(0),
                                                                                                                                                                                   m_peersCount(0),
+                                                                                                                                                                                  m_syncScheduler(BLOCKS_SYNCHRONIZING_DEFAULT_COUNT, SYNC_SPAN_TIMEOUT),
+                                                                                                                                                                                  m_committingSpans(false),
                                                                                                                                                                                   logger(log, "protocol")
 {
 
@@ -98,6 +108,8 @@ void CryptoNoteProtocolHandler::onConnectionClosed(CryptoNoteConnectionContext &
     m_peersCount--;
     m_observerManager.notify(&ICryptoNoteProtocolObserver::peerCountUpdated, m_peersCount.load());
   }
+
+  m_syncScheduler.release(context.m_connection_id);
 }
 
 void CryptoNoteProtocolHandler::stop()
@@ -389,6 +401,12 @@ int CryptoNoteProtocolHandler::handle_request_get_objects(int command, NOTIFY_RE
 int CryptoNoteProtocolHandler::handle_response_get_objects(int command, NOTIFY_RESPONSE_GET_OBJECTS::request& arg, CryptoNoteConnectionContext& context) {
   logger(Logging::TRACE) << context << "NOTIFY_RESPONSE_GET_OBJECTS";
 
+  if (context.m_state != CryptoNoteConnectionContext::state_synchronizing) {
+    // response to a prefetch request that was abandoned when the connection went idle
+    logger(DEBUGGING) << context << "NOTIFY_RESPONSE_GET_OBJECTS received while not synchronizing, ignoring";
+    return 1;
+  }
+
   if (context.m_last_response_height > arg.current_blockchain_height) {
     logger(Logging::ERROR) << context << "sent wrong NOTIFY_HAVE_OBJECTS: arg.m_current_blockchain_height=" << arg.current_blockchain_height
       << " < m_last_response_height=" << context.m_last_response_height << ", dropping connection";
@@ -400,13 +418,11 @@ int CryptoNoteProtocolHandler::handle_response_get_objects(int command, NOTIFY_R
 
   context.m_remote_blockchain_height = arg.current_blockchain_height;
 
-  size_t count = 0;
   std::vector<Crypto::Hash> block_hashes;
   block_hashes.reserve(arg.blocks.size());
   std::vector<parsed_block_entry> parsed_blocks;
   parsed_blocks.reserve(arg.blocks.size());
   for (const block_complete_entry& block_entry : arg.blocks) {
-    ++count;
     Block b;
     BinaryArray block_blob = asBinaryArray(block_entry.block);
     if (block_blob.size() > m_currency.maxBlockBlobSize()) {
@@ -421,18 +437,7 @@ int CryptoNoteProtocolHandler::handle_response_get_objects(int command, NOTIFY_R
       return 1;
     }
 
-    //to avoid concurrency in core between connections, suspend connections which delivered block later then first one
     auto blockHash = get_block_hash(b);
-    if (count == 2) {
-      if (m_core.have_block(blockHash)) {
-        context.m_state = CryptoNoteConnectionContext::state_idle;
-        context.m_needed_objects.clear();
-        context.m_requested_objects.clear();
-        logger(DEBUGGING) << context << "Connection set to idle state.";
-        return 1;
-      }
-    }
-
     auto req_it = context.m_requested_objects.find(blockHash);
     if (req_it == context.m_requested_objects.end()) {
       logger(Logging::ERROR) << context << "sent wrong NOTIFY_RESPONSE_GET_OBJECTS: block with id=" << Common::podToHex(blockHash)
@@ -460,54 +465,133 @@ int CryptoNoteProtocolHandler::handle_response_get_objects(int command, NOTIFY_R
     parsed_blocks.push_back(parsedBlock);
   }
 
-  if (context.m_requested_objects.size()) {
-    logger(Logging::ERROR, Logging::BRIGHT_RED) << context <<
-      "returned not all requested objects (context.m_requested_objects.size()="
-      << context.m_requested_objects.size() << "), dropping connection";
-    context.m_state = CryptoNoteConnectionContext::state_shutdown;
+  if (!context.m_requested_objects.empty()) {
+    // The peer may have switched to another chain since it sent its chain
+    // entry, the span is downloaded from a connection that still has it.
+    logger(DEBUGGING) << context << "doesn't have " << context.m_requested_objects.size() << " of the requested blocks, missed_ids.size()="
+      << arg.missed_ids.size();
+    std::vector<Crypto::Hash> missedIds(context.m_requested_objects.begin(), context.m_requested_objects.end());
+    context.m_requested_objects.clear();
+    m_syncScheduler.notAvailable(context.m_connection_id, missedIds);
+  } else if (!m_syncScheduler.deliver(context.m_connection_id, block_hashes, std::move(parsed_blocks))) {
+    // the span timed out and was downloaded from another peer, or the sync was restarted
+    logger(DEBUGGING) << context << "Blocks are no longer scheduled for this connection, ignoring them";
+  }
+
+  // Ask for the next span before committing, so that it is downloaded while
+  // the delivered ones are being verified.
+  if (!m_stop) {
+    request_missing_objects(context);
+  }
+
+  return commitSyncSpans(context);
+}
+
+int CryptoNoteProtocolHandler::commitSyncSpans(CryptoNoteConnectionContext& context) {
+  // Spans are committed in chain order by one handler at a time; other
+  // connections delivering meanwhile leave their spans to it.
+  if (m_committingSpans) {
     return 1;
   }
 
-  uint32_t height;
-  Crypto::Hash top;
-  {
-    m_core.pause_mining();
+  m_committingSpans = true;
+  BOOST_SCOPE_EXIT_ALL(this) { m_committingSpans = false; };
 
-    // we lock all the rest to avoid having multiple connections redo a lot
-    // of the same work, and one of them doing it for nothing: subsequent
-    // connections will wait until the current one's added its blocks, then
-    // will add any extra it has, if any
-    std::lock_guard<std::recursive_mutex> lk(m_sync_lock);
+  // connections waiting for spans of others to be committed
+  std::vector<boost::uuids::uuid> waiting;
+  m_p2p->for_each_connection([&](CryptoNoteConnectionContext& ctx, PeerIdType peerId) {
+    if (ctx.m_connection_id != context.m_connection_id && m_syncScheduler.hasPendingBlocks(ctx.m_connection_id)) {
+      waiting.push_back(ctx.m_connection_id);
+    }
+  });
 
-    // dismiss what another connection might already have done (likely everything)
-    m_core.get_blockchain_top(height, top);
-    uint64_t dismiss = 1;
-    for (const auto &h : block_hashes) {
-      if (top == h) {
-        logger(DEBUGGING) << "Found current top block in synced blocks, dismissing "
-          << dismiss << "/" << arg.blocks.size() << " blocks";
-        while (dismiss--) {
-          arg.blocks.erase(arg.blocks.begin());
-          parsed_blocks.erase(parsed_blocks.begin());
+  std::vector<parsed_block_entry> blocks;
+  std::vector<Crypto::Hash> blockIds;
+  boost::uuids::uuid deliveredBy;
+  while (!m_stop && m_syncScheduler.popReady(blocks, blockIds, deliveredBy)) {
+    // blocks delivered by another connection are committed on a copy of its
+    // context, the connection itself may be closed while they are processed,
+    // and the outcome is applied to the connection afterwards
+    CryptoNoteConnectionContext delivererCopy = context;
+    bool delivererIsCurrent = deliveredBy == context.m_connection_id;
+    if (!delivererIsCurrent) {
+      m_p2p->for_each_connection([&](CryptoNoteConnectionContext& ctx, PeerIdType peerId) {
+        if (ctx.m_connection_id == deliveredBy) {
+          delivererCopy = ctx;
         }
-        break;
-      }
-      ++dismiss;
+      });
     }
 
-    BOOST_SCOPE_EXIT_ALL(this) { m_core.update_block_template_and_resume_mining(); };
+    CryptoNoteConnectionContext& deliverer = delivererIsCurrent ? context : delivererCopy;
+
+    uint32_t height;
+    Crypto::Hash top;
+    int result = 0;
+    {
+      m_core.pause_mining();
+
+      // we lock all the rest to avoid having multiple connections redo a lot
+      // of the same work, and one of them doing it for nothing: subsequent
+      // connections will wait until the current one's added its blocks, then
+      // will add any extra it has, if any
+      std::lock_guard<std::recursive_mutex> lk(m_sync_lock);
+
+      // dismiss what another connection might already have done (likely everything)
+      m_core.get_blockchain_top(height, top);
+      size_t dismiss = 1;
+      for (const auto& block : blocks) {
+        if (top == get_block_hash(block.block)) {
+          logger(DEBUGGING) << "Found current top block in synced blocks, dismissing "
+            << dismiss << "/" << blocks.size() << " blocks";
+          blocks.erase(blocks.begin(), blocks.begin() + dismiss);
+          break;
+        }
+        ++dismiss;
+      }
+
+      BOOST_SCOPE_EXIT_ALL(this) { m_core.update_block_template_and_resume_mining(); };
+
+      result = processObjects(deliverer, blocks);
+    }
 
-    int result = processObjects(context, parsed_blocks);
     if (result != 0) {
-      return result;
+      // the spans building on a rejected one cannot be connected either
+      m_syncScheduler.reject(blockIds);
+      if (deliverer.m_state == CryptoNoteConnectionContext::state_shutdown) {
+        m_syncScheduler.release(deliveredBy);
+        if (!delivererIsCurrent) {
+          m_p2p->for_each_connection([&](CryptoNoteConnectionContext& ctx, PeerIdType peerId) {
+            if (ctx.m_connection_id == deliveredBy) {
+              ctx.m_state = CryptoNoteConnectionContext::state_shutdown;
+              m_p2p->drop_connection(ctx, true);
+            }
+          });
+        }
+      }
+
+      // spans of other chains may still connect
+      continue;
     }
+
+    m_core.get_blockchain_top(height, top);
+    logger(DEBUGGING, BRIGHT_GREEN) << "Local blockchain updated, new height = " << height;
   }
 
-  m_core.get_blockchain_top(height, top);
-  logger(DEBUGGING, BRIGHT_GREEN) << "Local blockchain updated, new height = " << height;
+  if (m_stop) {
+    return 1;
+  }
 
-  if (!m_stop && context.m_state == CryptoNoteConnectionContext::state_synchronizing) {
-    request_missing_objects(context, true);
+  // connections that were waiting for others to finish their spans can
+  // request the next chain entry or complete synchronization now
+  m_p2p->for_each_connection([&](CryptoNoteConnectionContext& ctx, PeerIdType peerId) {
+    if (ctx.m_state == CryptoNoteConnectionContext::state_synchronizing && ctx.m_requested_objects.empty() &&
+      std::find(waiting.begin(), waiting.end(), ctx.m_connection_id) != waiting.end()) {
+      request_missing_objects(ctx);
+    }
+  });
+
+  if (context.m_state == CryptoNoteConnectionContext::state_synchronizing && context.m_requested_objects.empty()) {
+    request_missing_objects(context);
   }
 
   return 1;
@@ -515,15 +599,45 @@ int CryptoNoteProtocolHandler::handle_response_get_objects(int command, NOTIFY_R
 
 int CryptoNoteProtocolHandler::processObjects(CryptoNoteConnectionContext& context, const std::vector<parsed_block_entry>& blocks) {
 
-  for (const parsed_block_entry& block_entry : blocks) {
+  // Transactions are parsed and hashed and proof of work is computed for the
+  // next chunk of blocks on worker threads while the current chunk is committed.
+  std::vector<bool> needProofOfWork(blocks.size());
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    needProofOfWork[i] = !m_core.isInCheckpointZone(get_block_height(blocks[i].block));
+  }
+
+  std::vector<prepared_block_entry> preparedBlocks(blocks.size());
+  auto startPreparing = [&](size_t begin) {
+    size_t end = std::min(begin + SYNC_PREPARE_CHUNK_SIZE, blocks.size());
+    return std::unique_ptr<System::RemoteContext<void>>(new System::RemoteContext<void>(m_dispatcher, [&, begin, end] {
+      prepareObjects(blocks, needProofOfWork, begin, end, preparedBlocks);
+    }));
+  };
+
+  std::unique_ptr<System::RemoteContext<void>> preparing;
+  if (!blocks.empty()) {
+    preparing = startPreparing(0);
+  }
+
+  for (size_t blockIndex = 0; blockIndex < blocks.size(); ++blockIndex) {
     if (m_stop) {
       break;
     }
 
+    if (blockIndex % SYNC_PREPARE_CHUNK_SIZE == 0) {
+      preparing->get();
+      preparing.reset();
+      if (blockIndex + SYNC_PREPARE_CHUNK_SIZE < blocks.size()) {
+        preparing = startPreparing(blockIndex + SYNC_PREPARE_CHUNK_SIZE);
+      }
+    }
+
+    const parsed_block_entry& block_entry = blocks[blockIndex];
+    const prepared_block_entry& prepared = preparedBlocks[blockIndex];
+
     //process transactions
     for (size_t i = 0; i < block_entry.txs.size(); ++i) {
-      auto transactionBinary = block_entry.txs[i];
-      Crypto::Hash transactionHash = Crypto::cn_fast_hash(transactionBinary.data(), transactionBinary.size());
+      const Crypto::Hash& transactionHash = prepared.txHashes[i];
       logger(DEBUGGING) << "transaction " << transactionHash << " came in processObjects";
 
       // check if tx hashes match
@@ -535,7 +649,16 @@ int CryptoNoteProtocolHandler::processObjects(CryptoNoteConnectionContext& conte
       }
 
       tx_verification_context tvc = boost::value_initialized<decltype(tvc)>();
-      m_core.handle_incoming_tx(transactionBinary, tvc, true);
+      if (block_entry.txs[i].size() > m_currency.maxTxSize()) {
+        logger(INFO) << "WRONG TRANSACTION BLOB, too big size " << block_entry.txs[i].size() << ", rejected";
+        tvc.m_verification_failed = true;
+      } else if (!prepared.txParsed[i]) {
+        logger(INFO) << "WRONG TRANSACTION BLOB, Failed to parse, rejected";
+        tvc.m_verification_failed = true;
+      } else {
+        m_core.handleIncomingTransaction(prepared.txs[i], transactionHash, block_entry.txs[i].size(), tvc, true, get_block_height(block_entry.block));
+      }
+
       if (tvc.m_verification_failed) {
         logger(DEBUGGING) << context << "transaction verification failed on NOTIFY_RESPONSE_GET_OBJECTS, \r\ntx_id = "
           << Common::podToHex(transactionHash) << ", dropping connection";
@@ -544,6 +667,10 @@ int CryptoNoteProtocolHandler::processObjects(CryptoNoteConnectionContext& conte
       }
     }
 
+    if (prepared.hasProofOfWork) {
+      m_core.addPrecomputedProofOfWork(get_block_hash(block_entry.block), prepared.proofOfWork);
+    }
+
     // process block
     block_verification_context bvc = boost::value_initialized<block_verification_context>();
     m_core.handle_incoming_block(block_entry.block, bvc, false, false);
@@ -557,11 +684,8 @@ int CryptoNoteProtocolHandler::processObjects(CryptoNoteConnectionContext& conte
       context.m_state = CryptoNoteConnectionContext::state_shutdown;
       return 1;
     } else if (bvc.m_already_exists) {
-      logger(DEBUGGING) << context << "Block already exists, switching to idle state";
-      context.m_state = CryptoNoteConnectionContext::state_idle;
-      context.m_needed_objects.clear();
-      context.m_requested_objects.clear();
-      return 1;
+      // added meanwhile, e.g. relayed as a new block
+      logger(DEBUGGING) << context << "Block already exists, skipping it";
     }
 
     m_dispatcher.yield();
@@ -571,8 +695,66 @@ int CryptoNoteProtocolHandler::processObjects(CryptoNoteConnectionContext& conte
 
 }
 
+void CryptoNoteProtocolHandler::prepareObjects(const std::vector<parsed_block_entry>& blocks, const std::vector<bool>& needProofOfWork,
+  size_t begin, size_t end, std::vector<prepared_block_entry>& prepared) const {
+  std::atomic<size_t> next(begin);
+  auto worker = [&] {
+    // each worker takes as many blocks at a time as its context has lanes
+    Crypto::cn_context context(CN_MINER_LANES);
+    for (size_t first = next.fetch_add(CN_MINER_LANES); first < end; first = next.fetch_add(CN_MINER_LANES)) {
+      size_t last = std::min<size_t>(first + CN_MINER_LANES, end);
+      Block powBlocks[CN_MINER_LANES];
+      size_t powIndices[CN_MINER_LANES];
+      size_t powCount = 0;
+      for (size_t i = first; i < last; ++i) {
+        const parsed_block_entry& block = blocks[i];
+        prepared_block_entry& entry = prepared[i];
+
+        entry.txs.resize(block.txs.size());
+        entry.txHashes.resize(block.txs.size());
+        entry.txParsed.resize(block.txs.size());
+        for (size_t j = 0; j < block.txs.size(); ++j) {
+          Crypto::Hash prefixHash;
+          entry.txParsed[j] = parseAndValidateTransactionFromBinaryArray(block.txs[j], entry.txs[j], entry.txHashes[j], prefixHash);
+          if (!entry.txParsed[j]) {
+            entry.txHashes[j] = Crypto::cn_fast_hash(block.txs[j].data(), block.txs[j].size());
+          }
+        }
+
+        entry.hasProofOfWork = false;
+        if (needProofOfWork[i]) {
+          powBlocks[powCount] = block.block;
+          powIndices[powCount++] = i;
+        }
+      }
+
+      Crypto::Hash hashes[CN_MINER_LANES];
+      if (powCount > 0 && get_block_longhashes(context, powBlocks, powCount, hashes)) {
+        for (size_t k = 0; k < powCount; ++k) {
+          prepared[powIndices[k]].proofOfWork = hashes[k];
+          prepared[powIndices[k]].hasProofOfWork = true;
+        }
+      }
+    }
+  };
+
+  size_t workers = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+  workers = std::min(workers, end - begin);
+  std::vector<std::future<void>> helpers;
+  for (size_t w = 1; w < workers; ++w) {
+    helpers.push_back(std::async(std::launch::async, worker));
+  }
+
+  worker();
+  for (auto& helper : helpers) {
+    helper.get();
+  }
+}
+
 bool CryptoNoteProtocolHandler::on_idle()
 {
+  // hand spans that timed out on slow connections to free ones
+  requestSyncSpans();
   return m_core.on_idle();
 }
 
@@ -602,27 +784,46 @@ int CryptoNoteProtocolHandler::handle_request_chain(int command, NOTIFY_REQUEST_
   return 1;
 }
 
-bool CryptoNoteProtocolHandler::request_missing_objects(CryptoNoteConnectionContext &context, bool check_having_blocks)
+bool CryptoNoteProtocolHandler::requestSyncSpan(CryptoNoteConnectionContext &context)
 {
-  if (context.m_needed_objects.size())
+  //we know objects that we need, request the next span of them
+  NOTIFY_REQUEST_GET_OBJECTS::request req;
+  if (!m_syncScheduler.assign(context.m_connection_id, req.blocks))
   {
-    //we know objects that we need, request this objects
-    NOTIFY_REQUEST_GET_OBJECTS::request req;
-    size_t count = 0;
-    auto it = context.m_needed_objects.begin();
+    return false;
+  }
+
+  context.m_requested_objects.insert(req.blocks.begin(), req.blocks.end());
+  logger(Logging::TRACE) << context << "-->>NOTIFY_REQUEST_GET_OBJECTS: blocks.size()=" << req.blocks.size() << ", txs.size()=" << req.txs.size();
+  post_notify<NOTIFY_REQUEST_GET_OBJECTS>(*m_p2p, req, context);
+  return true;
+}
 
-    while (it != context.m_needed_objects.end() && count < BLOCKS_SYNCHRONIZING_DEFAULT_COUNT)
+void CryptoNoteProtocolHandler::requestSyncSpans()
+{
+  if (m_syncScheduler.empty())
+  {
+    return;
+  }
+
+  m_p2p->for_each_connection([this](CryptoNoteConnectionContext &ctx, PeerIdType peerId) {
+    if (ctx.m_state == CryptoNoteConnectionContext::state_synchronizing && ctx.m_requested_objects.empty())
     {
-      if (!(check_having_blocks && m_core.have_block(*it)))
-      {
-        req.blocks.push_back(*it);
-        ++count;
-        context.m_requested_objects.insert(*it);
-      }
-      it = context.m_needed_objects.erase(it);
+      requestSyncSpan(ctx);
     }
-    logger(Logging::TRACE) << context << "-->>NOTIFY_REQUEST_GET_OBJECTS: blocks.size()=" << req.blocks.size() << ", txs.size()=" << req.txs.size();
-    post_notify<NOTIFY_REQUEST_GET_OBJECTS>(*m_p2p, req, context);
+  });
+}
+
+bool CryptoNoteProtocolHandler::request_missing_objects(CryptoNoteConnectionContext &context)
+{
+  if (!context.m_requested_objects.empty() || requestSyncSpan(context))
+  {
+    //blocks are being downloaded from this connection
+  }
+  else if (m_syncScheduler.hasPendingBlocks(context.m_connection_id))
+  {
+    //the remaining spans are being downloaded from other connections
+    logger(Logging::TRACE) << context << "no blocks to request, waiting for other connections";
   }
   else if (context.m_last_response_height < context.m_remote_blockchain_height - 1)
   { //we have to fetch more objects ids, request blockchain entry
@@ -665,9 +866,8 @@ bool CryptoNoteProtocolHandler::on_connection_synchronized()
   {
     logger(Logging::INFO) << ENDL << "********************************************************************************" << ENDL
                           << "You are now synchronized with the Cache network." << ENDL
-                          << "Please note, that the blockchain will be saved only after you quit the daemon" << ENDL
-                          << "with the \"exit\" command or if you use the \"save\" command." << ENDL
-                          << "Otherwise, you will possibly need to synchronize the blockchain again." << ENDL
+                          << "The blockchain cache is saved periodically and when you quit the daemon" << ENDL
+                          << "with the \"exit\" command or use the \"save\" command." << ENDL
                           << "Use \"help\" command to see the list of available commands." << ENDL
                           << "********************************************************************************";
     m_core.on_synchronized();
@@ -715,13 +915,10 @@ int CryptoNoteProtocolHandler::handle_response_chain_entry(int command, NOTIFY_R
     context.m_state = CryptoNoteConnectionContext::state_shutdown;
   }
 
-  for (auto &bl_id : arg.m_block_ids)
-  {
-    if (!m_core.have_block(bl_id))
-      context.m_needed_objects.push_back(bl_id);
-  }
-
-  request_missing_objects(context, false);
+  // spans are only handed to connections whose chain entries contain them
+  m_syncScheduler.addBlocks(context.m_connection_id, arg.m_block_ids, [this](const Crypto::Hash &id) { return m_core.have_block(id); });
+  request_missing_objects(context);
+  requestSyncSpans();
   return 1;
 }
 
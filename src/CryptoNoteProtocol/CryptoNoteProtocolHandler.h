@@ -12,6 +12,7 @@
 
 #include "CryptoNoteCore/ICore.h"
 
+#include "CryptoNoteProtocol/BlockSyncScheduler.h"
 #include "CryptoNoteProtocol/CryptoNoteProtocolDefinitions.h"
 #include "CryptoNoteProtocol/CryptoNoteProtocolHandlerCommon.h"
 #include "CryptoNoteProtocol/ICryptoNoteProtocolObserver.h"
@@ -90,11 +91,28 @@ namespace CryptoNote
 
     //----------------------------------------------------------------------------------
     uint32_t get_current_blockchain_height();
-    bool request_missing_objects(CryptoNoteConnectionContext& context, bool check_having_blocks);
+    bool request_missing_objects(CryptoNoteConnectionContext& context);
+    bool requestSyncSpan(CryptoNoteConnectionContext& context);
+    void requestSyncSpans();
+    int commitSyncSpans(CryptoNoteConnectionContext& context);
     bool on_connection_synchronized();
     void updateObservedHeight(uint32_t peerHeight, const CryptoNoteConnectionContext& context);
     void recalculateMaxObservedHeight(const CryptoNoteConnectionContext& context);
     int processObjects(CryptoNoteConnectionContext& context, const std::vector<parsed_block_entry>& blocks);
+
+    // Results of the chain independent part of block verification, computed
+    // on worker threads ahead of committing the block.
+    struct prepared_block_entry
+    {
+      std::vector<Transaction> txs;
+      std::vector<Crypto::Hash> txHashes;
+      std::vector<bool> txParsed;
+      bool hasProofOfWork;
+      Crypto::Hash proofOfWork;
+    };
+
+    void prepareObjects(const std::vector<parsed_block_entry>& blocks, const std::vector<bool>& needProofOfWork,
+      size_t begin, size_t end, std::vector<prepared_block_entry>& prepared) const;
     Logging::LoggerRef logger;
 
   private:
@@ -114,6 +132,8 @@ namespace CryptoNote
     uint32_t m_blockchainHeight;
 
     std::atomic<size_t> m_peersCount;
+    BlockSyncScheduler<parsed_block_entry> m_syncScheduler;
+    bool m_committingSpans;
     Tools::ObserverManager<ICryptoNoteProtocolObserver> m_observerManager;
   };
 }
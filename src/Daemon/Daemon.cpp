@@ -76,6 +76,7 @@ void print_example_hash() {
 JsonValue buildLoggerConfiguration(Level level, const std::string& logfile) {
   JsonValue loggerConfiguration(JsonValue::OBJECT);
   loggerConfiguration.insert("globalLevel", static_cast<int64_t>(level));
+  loggerConfiguration.insert("async", JsonValue(true));
 
   JsonValue& cfgLoggers = loggerConfiguration.insert("loggers", JsonValue::ARRAY);
   JsonValue& fileLogger = cfgLoggers.pushBack(JsonValue::OBJECT);
@@ -319,6 +320,7 @@ int main(int argc, char* argv[])
       }
     }
  
+    rpcServer.setWorkerThreads(rpcConfig.workerThreads);
     rpcServer.start(rpcConfig.bindIp, rpcConfig.bindPort);
     logger(INFO, BRIGHT_GREEN) << "Core RPC server has been initialized on " << rpcConfig.getBindAddress();
 
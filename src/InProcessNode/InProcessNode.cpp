@@ -147,16 +147,9 @@ std::error_code InProcessNode::doGetNewBlocks(std::vector<Crypto::Hash>&& knownB
     std::vector<Crypto::Hash> supplement = core.findBlockchainSupplement(knownBlockIds, CryptoNote::COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT, totalBlockCount, startHeight);
 
     for (const auto& blockId : supplement) {
-      assert(core.have_block(blockId));
-      auto completeBlock = core.getBlock(blockId);
-      assert(completeBlock != nullptr);
-
       CryptoNote::block_complete_entry be;
-      be.block = asString(toBinaryArray(completeBlock->getBlock()));
-
-      be.txs.reserve(completeBlock->getTransactionCount());
-      for (size_t i = 0; i < completeBlock->getTransactionCount(); ++i) {
-        be.txs.push_back(asString(toBinaryArray(completeBlock->getTransaction(i))));
+      if (!core.getRawBlock(blockId, be)) {
+        return make_error_code(CryptoNote::error::INTERNAL_NODE_ERROR);
       }
 
       newBlocks.push_back(std::move(be));
@@ -478,14 +471,15 @@ std::error_code InProcessNode::doQueryBlocksLite(std::vector<Crypto::Hash>&& kno
   uint32_t currentHeight, fullOffset;
   std::vector<CryptoNote::BlockShortInfo> entries;
 
-  if (!core.queryBlocksLite(knownBlockIds, timestamp, startHeight, currentHeight, fullOffset, entries)) {
+  if (!core.queryBlocksLite(knownBlockIds, timestamp, startHeight, currentHeight, fullOffset, entries, true)) {
     return make_error_code(CryptoNote::error::INTERNAL_NODE_ERROR);
   }
 
-  for (const auto& entry: entries) {
+  for (auto& entry: entries) {
     BlockShortEntry bse;
     bse.blockHash = entry.blockId;
     bse.hasBlock = false;
+    bse.baseTransactionGlobalIndexes = std::move(entry.baseTransactionGlobalIndexes);
 
     if (!entry.block.empty()) {
       bse.hasBlock = true;
@@ -494,10 +488,11 @@ std::error_code InProcessNode::doQueryBlocksLite(std::vector<Crypto::Hash>&& kno
       }
     }
 
-    for (const auto& tsi: entry.txPrefixes) {
+    for (auto& tsi: entry.txPrefixes) {
       TransactionShortInfo tpi;
       tpi.txId = tsi.txHash;
       tpi.txPrefix = tsi.txPrefix;
+      tpi.globalIndexes = std::move(tsi.globalIndexes);
 
       bse.txsShortInfo.push_back(std::move(tpi));
     }
@@ -42,7 +42,9 @@ void JsonRpcServer::start(const std::string& bindAddress, uint16_t bindPort, con
 
 void JsonRpcServer::processRequest(const CryptoNote::HttpRequest& req, CryptoNote::HttpResponse& resp) {
   try {
-    logger(Logging::TRACE) << "HTTP request came: \n" << req;
+    if (logger.isEnabled(Logging::TRACE)) {
+      logger(Logging::TRACE) << "HTTP request came: \n" << req;
+    }
 
     if (req.getUrl() == "/json_rpc") {
       std::istringstream jsonInputStream(req.getBody());
@@ -59,13 +61,20 @@ void JsonRpcServer::processRequest(const CryptoNote::HttpRequest& req, CryptoNot
         return;
       }
 
-      processJsonRpcRequest(jsonRpcRequest, jsonRpcResponse);
+      std::string result;
+      processJsonRpcRequest(jsonRpcRequest, jsonRpcResponse, result);
 
-      std::ostringstream jsonOutputStream;
-      jsonOutputStream << jsonRpcResponse;
+      std::string body = jsonRpcResponse.toString();
+      if (!result.empty()) {
+        body.pop_back();
+        body.reserve(body.size() + result.size() + 11);
+        body += ",\"result\":";
+        body += result;
+        body += '}';
+      }
 
       resp.setStatus(CryptoNote::HttpResponse::STATUS_200);
-      resp.setBody(jsonOutputStream.str());
+      resp.setBody(body);
 
     } else {
       logger(Logging::WARNING) << "Requested url \"" << req.getUrl() << "\" is not found";
@@ -45,7 +45,8 @@ protected:
   static void prepareJsonResponse(const Common::JsonValue& req, Common::JsonValue& resp);
   static void makeJsonParsingErrorResponse(Common::JsonValue& resp);
 
-  virtual void processJsonRpcRequest(const Common::JsonValue& req, Common::JsonValue& resp) = 0;
+  // A handler may leave its result in 'result' as JSON text instead of adding it to 'resp'.
+  virtual void processJsonRpcRequest(const Common::JsonValue& req, Common::JsonValue& resp, std::string& result) = 0;
 
 private:
   // HttpServer
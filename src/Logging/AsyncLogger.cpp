@@ -0,0 +1,121 @@
+// Copyright (c) 2011-2017 The Cryptonote developers
+// Copyright (c) 2017-2018 The Circle Foundation & Conceal Devs
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "AsyncLogger.h"
+#include <cassert>
+
+namespace Logging {
+
+AsyncLogger::AsyncLogger(ILogger& logger, size_t capacity) :
+  logger(logger),
+  cells(new Cell[capacity]),
+  mask(capacity - 1),
+  pushPosition(0),
+  popPosition(0),
+  writerSleeping(false),
+  stopped(false) {
+  assert(capacity >= 2 && (capacity & mask) == 0);
+  for (size_t i = 0; i < capacity; ++i) {
+    cells[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  writer = std::thread(&AsyncLogger::writerProcedure, this);
+}
+
+AsyncLogger::~AsyncLogger() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopped = true;
+  }
+
+  condition.notify_one();
+  writer.join();
+}
+
+void AsyncLogger::operator()(const std::string& category, Level level, boost::posix_time::ptime time, const std::string& body) {
+  Message message = {category, level, time, body};
+  while (!tryPush(message)) {
+    std::this_thread::yield();
+  }
+
+  // pairs with the fence in writerProcedure: either the writer sees the
+  // message before going to sleep or we see it sleeping and wake it up
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (writerSleeping.load(std::memory_order_relaxed)) {
+    std::lock_guard<std::mutex> lock(mutex);
+    condition.notify_one();
+  }
+}
+
+Level AsyncLogger::getMaxLevel() const {
+  return logger.getMaxLevel();
+}
+
+// A cell is free for the push at 'position' when its sequence equals
+// 'position', and holds a message for the pop at 'position' when its
+// sequence equals 'position + 1'.
+bool AsyncLogger::tryPush(Message& message) {
+  size_t position = pushPosition.load(std::memory_order_relaxed);
+  for (;;) {
+    Cell& cell = cells[position & mask];
+    size_t sequence = cell.sequence.load(std::memory_order_acquire);
+    if (sequence == position) {
+      if (pushPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+        cell.message = std::move(message);
+        cell.sequence.store(position + 1, std::memory_order_release);
+        return true;
+      }
+    } else if (sequence < position) {
+      return false;
+    } else {
+      position = pushPosition.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+// Only the writer thread pops.
+bool AsyncLogger::tryPop(Message& message) {
+  size_t position = popPosition.load(std::memory_order_relaxed);
+  Cell& cell = cells[position & mask];
+  if (cell.sequence.load(std::memory_order_acquire) != position + 1) {
+    return false;
+  }
+
+  message = std::move(cell.message);
+  cell.sequence.store(position + mask + 1, std::memory_order_release);
+  popPosition.store(position + 1, std::memory_order_relaxed);
+  return true;
+}
+
+bool AsyncLogger::hasMessage() const {
+  size_t position = popPosition.load(std::memory_order_relaxed);
+  return cells[position & mask].sequence.load(std::memory_order_acquire) == position + 1;
+}
+
+void AsyncLogger::writerProcedure() {
+  Message message;
+  for (;;) {
+    while (tryPop(message)) {
+      logger(message.category, message.level, message.time, message.body);
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    if (stopped) {
+      break;
+    }
+
+    writerSleeping.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    condition.wait(lock, [this] { return stopped || hasMessage(); });
+    writerSleeping.store(false, std::memory_order_relaxed);
+  }
+
+  while (tryPop(message)) {
+    logger(message.category, message.level, message.time, message.body);
+  }
+}
+
+}
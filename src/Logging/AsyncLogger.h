@@ -0,0 +1,63 @@
+// Copyright (c) 2011-2017 The Cryptonote developers
+// Copyright (c) 2017-2018 The Circle Foundation & Conceal Devs
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "ILogger.h"
+
+namespace Logging {
+
+// Passes messages to another logger from a thread of its own, so the threads
+// that log never wait for the console or a file. Messages go through a
+// bounded lock-free ring; when it is full, the logging thread waits for room
+// rather than losing the message. The destructor writes out what is left.
+class AsyncLogger : public ILogger {
+public:
+  AsyncLogger(ILogger& logger, size_t capacity = 4096);
+  ~AsyncLogger();
+  AsyncLogger(const AsyncLogger&) = delete;
+  AsyncLogger& operator=(const AsyncLogger&) = delete;
+
+  virtual void operator()(const std::string& category, Level level, boost::posix_time::ptime time, const std::string& body) override;
+  virtual Level getMaxLevel() const override;
+
+private:
+  struct Message {
+    std::string category;
+    Level level;
+    boost::posix_time::ptime time;
+    std::string body;
+  };
+
+  struct Cell {
+    std::atomic<size_t> sequence;
+    Message message;
+  };
+
+  bool tryPush(Message& message);
+  bool tryPop(Message& message);
+  bool hasMessage() const;
+  void writerProcedure();
+
+  ILogger& logger;
+  std::unique_ptr<Cell[]> cells;
+  size_t mask;
+  std::atomic<size_t> pushPosition;
+  std::atomic<size_t> popPosition;
+
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::atomic<bool> writerSleeping;
+  bool stopped;
+  std::thread writer;
+};
+
+}
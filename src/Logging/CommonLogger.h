@@ -18,6 +18,7 @@ public:
   virtual void enableCategory(const std::string& category);
   virtual void disableCategory(const std::string& category);
   virtual void setMaxLevel(Level level);
+  virtual Level getMaxLevel() const override;
 
   void setPattern(const std::string& pattern);
 
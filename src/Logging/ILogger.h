@@ -46,6 +46,9 @@ public:
   const static std::array<std::string, 6> LEVEL_NAMES;
 
   virtual void operator()(const std::string& category, Level level, boost::posix_time::ptime time, const std::string& body) = 0;
+
+  // Messages above this level are dropped anyway, so LoggerMessage skips formatting them.
+  virtual Level getMaxLevel() const;
 };
 
 #ifndef ENDL
@@ -13,7 +13,19 @@ namespace Logging {
 
 using Common::JsonValue;
 
-LoggerManager::LoggerManager() {
+LoggerManager::LoggerManager() : maxLevel(LoggerGroup::getMaxLevel()) {
+}
+
+void LoggerManager::addLogger(ILogger& logger) {
+  std::unique_lock<std::mutex> lock(reconfigureLock);
+  LoggerGroup::addLogger(logger);
+  maxLevel = LoggerGroup::getMaxLevel();
+}
+
+void LoggerManager::removeLogger(ILogger& logger) {
+  std::unique_lock<std::mutex> lock(reconfigureLock);
+  LoggerGroup::removeLogger(logger);
+  maxLevel = LoggerGroup::getMaxLevel();
 }
 
 void LoggerManager::operator()(const std::string& category, Level level, boost::posix_time::ptime time, const std::string& body) {
@@ -21,10 +33,38 @@ void LoggerManager::operator()(const std::string& category, Level level, boost::
   LoggerGroup::operator()(category, level, time, body);
 }
 
+void LoggerManager::setMaxLevel(Level level) {
+  std::unique_lock<std::mutex> lock(reconfigureLock);
+  LoggerGroup::setMaxLevel(level);
+  maxLevel = LoggerGroup::getMaxLevel();
+}
+
+Level LoggerManager::getMaxLevel() const {
+  return maxLevel.load(std::memory_order_relaxed);
+}
+
 void LoggerManager::configure(const JsonValue& val) {
   std::unique_lock<std::mutex> lock(reconfigureLock);
+  // writes out the queued messages before their loggers go away
+  asyncLogger.reset();
+  asyncGroup.reset();
   loggers.clear();
   LoggerGroup::loggers.clear();
+
+  bool async = false;
+  if (val.contains("async")) {
+    auto asyncVal = val("async");
+    if (asyncVal.isBool()) {
+      async = asyncVal.getBool();
+    } else {
+      throw std::runtime_error("parameter async has wrong type");
+    }
+  }
+
+  if (async) {
+    asyncGroup.reset(new LoggerGroup(TRACE));
+  }
+
   Level globalLevel;
   if (val.contains("globalLevel")) {
     auto levelVal = val("globalLevel");
@@ -99,7 +139,11 @@ void LoggerManager::configure(const JsonValue& val) {
         }
 
         loggers.emplace_back(std::move(logger));
-        addLogger(*loggers.back());
+        if (asyncGroup) {
+          asyncGroup->addLogger(*loggers.back());
+        } else {
+          LoggerGroup::addLogger(*loggers.back());
+        }
       }
     } else {
       throw std::runtime_error("loggers parameter has wrong type");
@@ -107,10 +151,18 @@ void LoggerManager::configure(const JsonValue& val) {
   } else {
     throw std::runtime_error("loggers parameter missing");
   }
-  setMaxLevel(globalLevel);
+
+  if (asyncGroup) {
+    asyncLogger.reset(new AsyncLogger(*asyncGroup));
+    LoggerGroup::addLogger(*asyncLogger);
+  }
+
+  LoggerGroup::setMaxLevel(globalLevel);
   for (const auto& category : globalDisabledCategories) {
     disableCategory(category);
   }
+
+  maxLevel = LoggerGroup::getMaxLevel();
 }
 
 }
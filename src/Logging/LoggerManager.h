@@ -6,10 +6,12 @@
 
 #pragma once
 
+#include <atomic>
 #include <list>
 #include <memory>
 #include <mutex>
 #include "../Common/JsonValue.h"
+#include "AsyncLogger.h"
 #include "LoggerGroup.h"
 
 namespace Logging {
@@ -18,10 +20,20 @@ class LoggerManager : public LoggerGroup {
 public:
   LoggerManager();
   void configure(const Common::JsonValue& val);
+  void addLogger(ILogger& logger);
+  void removeLogger(ILogger& logger);
   virtual void operator()(const std::string& category, Level level, boost::posix_time::ptime time, const std::string& body) override;
+  virtual void setMaxLevel(Level level) override;
+  // Cached, as it is asked for every message; levels of the added loggers
+  // are taken when they are added.
+  virtual Level getMaxLevel() const override;
 
 private:
   std::vector<std::unique_ptr<CommonLogger>> loggers;
+  // with "async" set, the configured loggers are reached through these
+  std::unique_ptr<LoggerGroup> asyncGroup;
+  std::unique_ptr<AsyncLogger> asyncLogger;
+  std::atomic<Level> maxLevel;
   std::mutex reconfigureLock;
 };
 
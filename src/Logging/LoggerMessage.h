@@ -7,11 +7,14 @@
 #pragma once
 
 #include <iostream>
+#include <memory>
 #include "ILogger.h"
 
 namespace Logging {
 
-class LoggerMessage : public std::ostream, std::streambuf {
+// The stream is only created when the logger takes messages of this level,
+// otherwise every operator<< is a single branch and nothing gets formatted.
+class LoggerMessage {
 public:
   LoggerMessage(ILogger& logger, const std::string& category, Level level, const std::string& color);
   ~LoggerMessage();
@@ -19,16 +22,37 @@ public:
   LoggerMessage& operator=(const LoggerMessage&) = delete;
   LoggerMessage(LoggerMessage&& other);
 
+  template<typename T>
+  LoggerMessage& operator<<(const T& value) {
+    if (stream) {
+      *stream << value;
+    }
+
+    return *this;
+  }
+
+  LoggerMessage& operator<<(std::ostream& (*manipulator)(std::ostream&));
+  LoggerMessage& operator<<(std::ios_base& (*manipulator)(std::ios_base&));
+
 private:
-  int sync() override;
-  int overflow(int c) override;
-
-  std::string message;
-  const std::string category;
-  Level logLevel;
-  ILogger& logger;
-  boost::posix_time::ptime timestamp;
-  bool gotText;
+  class Stream : public std::ostream, std::streambuf {
+  public:
+    Stream(ILogger& logger, const std::string& category, Level level, const std::string& color);
+    ~Stream();
+
+  private:
+    int sync() override;
+    int overflow(int c) override;
+
+    std::string message;
+    const std::string category;
+    Level logLevel;
+    ILogger& logger;
+    boost::posix_time::ptime timestamp;
+    bool gotText;
+  };
+
+  std::unique_ptr<Stream> stream;
 };
 
 }
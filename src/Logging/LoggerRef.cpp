@@ -19,4 +19,8 @@ ILogger& LoggerRef::getLogger() const {
   return *logger;
 }
 
+bool LoggerRef::isEnabled(Level level) const {
+  return level <= logger->getMaxLevel();
+}
+
 }
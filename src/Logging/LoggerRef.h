@@ -16,6 +16,8 @@ public:
   LoggerRef(ILogger& logger, const std::string& category);
   LoggerMessage operator()(Level level = INFO, const std::string& color = DEFAULT) const;
   ILogger& getLogger() const;
+  // For messages whose arguments are expensive to build, e.g. request dumps.
+  bool isEnabled(Level level) const;
 
 private:
   ILogger* logger;
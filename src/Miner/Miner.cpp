@@ -26,11 +26,15 @@ Miner::~Miner() {
   assert(m_state != MiningState::MINING_IN_PROGRESS);
 }
 
-Block Miner::mine(const BlockMiningParameters& blockMiningParameters, size_t threadCount) {
+Block Miner::mine(const BlockMiningParameters& blockMiningParameters, size_t threadCount, size_t lanes) {
   if (threadCount == 0) {
     throw std::runtime_error("Miner requires at least one thread");
   }
 
+  if (lanes == 0 || lanes > CN_MAX_LANES) {
+    throw std::runtime_error("Miner lanes must be 1.." + std::to_string(CN_MAX_LANES));
+  }
+
   if (m_state == MiningState::MINING_IN_PROGRESS) {
     throw std::runtime_error("Mining is already in progress");
   }
@@ -38,7 +42,7 @@ Block Miner::mine(const BlockMiningParameters& blockMiningParameters, size_t thr
   m_state = MiningState::MINING_IN_PROGRESS;
   m_miningStopped.clear();
 
-  runWorkers(blockMiningParameters, threadCount);
+  runWorkers(blockMiningParameters, threadCount, lanes);
 
   assert(m_state != MiningState::MINING_IN_PROGRESS);
   if (m_state == MiningState::MINING_STOPPED) {
@@ -59,7 +63,7 @@ void Miner::stop() {
   }
 }
 
-void Miner::runWorkers(BlockMiningParameters blockMiningParameters, size_t threadCount) {
+void Miner::runWorkers(BlockMiningParameters blockMiningParameters, size_t threadCount, size_t lanes) {
   assert(threadCount > 0);
 
   m_logger(Logging::INFO) << "Starting mining for difficulty " << blockMiningParameters.difficulty;
@@ -69,7 +73,7 @@ void Miner::runWorkers(BlockMiningParameters blockMiningParameters, size_t threa
 
     for (size_t i = 0; i < threadCount; ++i) {
       m_workers.emplace_back(std::unique_ptr<System::RemoteContext<void>> (
-        new System::RemoteContext<void>(m_dispatcher, std::bind(&Miner::workerFunc, this, blockMiningParameters.blockTemplate, blockMiningParameters.difficulty, threadCount)))
+        new System::RemoteContext<void>(m_dispatcher, std::bind(&Miner::workerFunc, this, blockMiningParameters.blockTemplate, blockMiningParameters.difficulty, threadCount, lanes)))
       );
 
       blockMiningParameters.blockTemplate.nonce++;
@@ -85,33 +89,42 @@ void Miner::runWorkers(BlockMiningParameters blockMiningParameters, size_t threa
   m_miningStopped.set();
 }
 
-void Miner::workerFunc(const Block& blockTemplate, difficulty_type difficulty, uint32_t nonceStep) {
+void Miner::workerFunc(const Block& blockTemplate, difficulty_type difficulty, uint32_t nonceStep, size_t lanes) {
   try {
-    Block block = blockTemplate;
-    Crypto::cn_context cryptoContext;
+    Block blocks[CN_MAX_LANES];
+    for (size_t i = 0; i < lanes; ++i) {
+      blocks[i] = blockTemplate;
+      blocks[i].nonce = blockTemplate.nonce + static_cast<uint32_t>(i) * nonceStep;
+    }
+
+    Crypto::cn_context cryptoContext(lanes);
 
     while (m_state == MiningState::MINING_IN_PROGRESS) {
-      Crypto::Hash hash;
-      if (!get_block_longhash(cryptoContext, block, hash)) {
+      Crypto::Hash hashes[CN_MAX_LANES];
+      if (!get_block_longhashes(cryptoContext, blocks, lanes, hashes)) {
         //error occured
         m_logger(Logging::DEBUGGING) << "calculating long hash error occured";
         m_state = MiningState::MINING_STOPPED;
         return;
       }
 
-      if (check_hash(hash, difficulty)) {
-        m_logger(Logging::INFO) << "Found block for difficulty " << difficulty;
+      for (size_t i = 0; i < lanes; ++i) {
+        if (check_hash(hashes[i], difficulty)) {
+          m_logger(Logging::INFO) << "Found block for difficulty " << difficulty;
 
-        if (!setStateBlockFound()) {
-          m_logger(Logging::DEBUGGING) << "block is already found or mining stopped";
+          if (!setStateBlockFound()) {
+            m_logger(Logging::DEBUGGING) << "block is already found or mining stopped";
+            return;
+          }
+
+          m_block = blocks[i];
           return;
         }
-
-        m_block = block;
-        return;
       }
 
-      block.nonce += nonceStep;
+      for (size_t i = 0; i < lanes; ++i) {
+        blocks[i].nonce += static_cast<uint32_t>(lanes) * nonceStep;
+      }
     }
   } catch (std::exception& e) {
     m_logger(Logging::ERROR) << "Miner got error: " << e.what();
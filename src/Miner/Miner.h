@@ -30,7 +30,8 @@ public:
   Miner(System::Dispatcher& dispatcher, Logging::ILogger& logger);
   ~Miner();
 
-  Block mine(const BlockMiningParameters& blockMiningParameters, size_t threadCount);
+  // every thread computes lanes hashes at once, each lane needs its own scratchpad
+  Block mine(const BlockMiningParameters& blockMiningParameters, size_t threadCount, size_t lanes);
 
   //NOTE! this is blocking method
   void stop();
@@ -48,8 +49,8 @@ private:
 
   Logging::LoggerRef m_logger;
 
-  void runWorkers(BlockMiningParameters blockMiningParameters, size_t threadCount);
-  void workerFunc(const Block& blockTemplate, difficulty_type difficulty, uint32_t nonceStep);
+  void runWorkers(BlockMiningParameters blockMiningParameters, size_t threadCount, size_t lanes);
+  void workerFunc(const Block& blockTemplate, difficulty_type difficulty, uint32_t nonceStep, size_t lanes);
   bool setStateBlockFound();
 };
 
@@ -16,6 +16,7 @@
 
 #include "CryptoNoteConfig.h"
 #include "Logging/ILogger.h"
+#include "crypto/hash.h"
 
 namespace po = boost::program_options;
 
@@ -60,6 +61,7 @@ MiningConfig::MiningConfig(): help(false) {
       ("daemon-rpc-port", po::value<uint16_t>()->default_value(static_cast<uint16_t>(RPC_DEFAULT_PORT)), "Daemon's RPC port")
       ("daemon-address", po::value<std::string>(), "Daemon host:port. If you use this option you must not use --daemon-host and --daemon-port options")
       ("threads", po::value<size_t>()->default_value(CONCURRENCY_LEVEL), "Mining threads count. Must not be greater than you concurrency level. Default value is your hardware concurrency level")
+      ("lanes", po::value<size_t>()->default_value(CN_MINER_LANES), "Hashes computed at once by every thread. Each lane needs its own scratchpad. Must be 1..4")
       ("scan-time", po::value<size_t>()->default_value(DEFAULT_SCANT_PERIOD), "Blockchain polling interval (seconds). How often miner will check blockchain for updates")
       ("log-level", po::value<int>()->default_value(1), "Log level. Must be 0..5")
       ("limit", po::value<size_t>()->default_value(0), "Mine exact quantity of blocks. 0 means no limit")
@@ -100,6 +102,11 @@ void MiningConfig::parse(int argc, char** argv) {
     throw std::runtime_error("--threads option must be 1.." + std::to_string(CONCURRENCY_LEVEL));
   }
 
+  lanes = options["lanes"].as<size_t>();
+  if (lanes == 0 || lanes > CN_MAX_LANES) {
+    throw std::runtime_error("--lanes option must be 1.." + std::to_string(CN_MAX_LANES));
+  }
+
   scanPeriod = options["scan-time"].as<size_t>();
   if (scanPeriod == 0) {
     throw std::runtime_error("--scan-time must not be zero");
@@ -21,6 +21,7 @@ struct MiningConfig {
   std::string daemonHost;
   uint16_t daemonPort;
   size_t threadCount;
+  size_t lanes;
   size_t scanPeriod;
   uint8_t logLevel;
   size_t blocksLimit;
@@ -538,6 +538,7 @@ std::error_code NodeRpcProxy::doQueryBlocksLite(const std::vector<Crypto::Hash>&
 
   req.blockIds = knownBlockIds;
   req.timestamp = timestamp;
+  req.globalIndexes = true;
 
   //m_logger(TRACE) << "Send queryblockslite.bin request, timestamp " << req.timestamp;
   std::error_code ec = binaryCommand("/queryblockslite.bin", req, rsp);
@@ -554,6 +555,7 @@ std::error_code NodeRpcProxy::doQueryBlocksLite(const std::vector<Crypto::Hash>&
     bse.hasBlock = false;
 
     bse.blockHash = std::move(item.blockId);
+    bse.baseTransactionGlobalIndexes = std::move(item.baseTransactionGlobalIndexes);
     if (!item.block.empty()) {
       if (!fromBinaryArray(bse.block, asBinaryArray(item.block))) {
         return std::make_error_code(std::errc::invalid_argument);
@@ -562,10 +564,11 @@ std::error_code NodeRpcProxy::doQueryBlocksLite(const std::vector<Crypto::Hash>&
       bse.hasBlock = true;
     }
 
-    for (const auto& txp: item.txPrefixes) {
+    for (auto& txp: item.txPrefixes) {
       TransactionShortInfo tsi;
       tsi.txId = txp.txHash;
       tsi.txPrefix = txp.txPrefix;
+      tsi.globalIndexes = std::move(txp.globalIndexes);
       bse.txsShortInfo.push_back(std::move(tsi));
     }
 
@@ -49,15 +49,7 @@ void LevinProtocol::sendMessage(uint32_t command, const BinaryArray& out, bool n
   head.m_protocol_version = LEVIN_PROTOCOL_VER_1;
   head.m_flags = LEVIN_PACKET_REQUEST;
 
-  // write header and body in one operation
-  BinaryArray writeBuffer;
-  writeBuffer.reserve(sizeof(head) + out.size());
-
-  Common::VectorOutputStream stream(writeBuffer);
-  stream.writeSome(&head, sizeof(head));
-  stream.writeSome(out.data(), out.size());
-
-  writeStrict(writeBuffer.data(), writeBuffer.size());
+  writeStrict(reinterpret_cast<const uint8_t*>(&head), sizeof(head), out);
 }
 
 bool LevinProtocol::readCommand(Command& cmd) {
@@ -102,20 +94,27 @@ void LevinProtocol::sendReply(uint32_t command, const BinaryArray& out, int32_t
   head.m_flags = LEVIN_PACKET_RESPONSE;
   head.m_return_code = returnCode;
 
-  BinaryArray writeBuffer;
-  writeBuffer.reserve(sizeof(head) + out.size());
-
-  Common::VectorOutputStream stream(writeBuffer);
-  stream.writeSome(&head, sizeof(head));
-  stream.writeSome(out.data(), out.size());
-
-  writeStrict(writeBuffer.data(), writeBuffer.size());
+  writeStrict(reinterpret_cast<const uint8_t*>(&head), sizeof(head), out);
 }
 
-void LevinProtocol::writeStrict(const uint8_t* ptr, size_t size) {
-  size_t offset = 0;
-  while (offset < size) {
-    offset += m_conn.write(ptr + offset, size - offset);
+// Header and body go out in one gather write, so the body, which may be shared
+// between many connections, is never copied.
+void LevinProtocol::writeStrict(const uint8_t* head, size_t headSize, const BinaryArray& body) {
+  System::TcpConnection::Buffer buffers[] = {{head, headSize}, {body.data(), body.size()}};
+  System::TcpConnection::Buffer* next = buffers;
+  size_t count = body.empty() ? 1 : 2;
+  while (count > 0) {
+    size_t transferred = m_conn.writev(next, count);
+    while (count > 0 && transferred >= next->size) {
+      transferred -= next->size;
+      ++next;
+      --count;
+    }
+
+    if (count > 0) {
+      next->data += transferred;
+      next->size -= transferred;
+    }
   }
 }
 
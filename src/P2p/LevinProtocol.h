@@ -72,8 +72,7 @@ public:
   template <typename T>
   static bool decode(const BinaryArray& buf, T& value) {
     try {
-      Common::MemoryInputStream stream(buf.data(), buf.size());
-      KVBinaryInputStreamSerializer serializer(stream);
+      KVBinaryInputStreamSerializer serializer(buf.data(), buf.size());
       serialize(value, serializer);
     } catch (std::exception&) {
       return false;
@@ -95,7 +94,7 @@ public:
 private:
 
   bool readStrict(uint8_t* ptr, size_t size);
-  void writeStrict(const uint8_t* ptr, size_t size);
+  void writeStrict(const uint8_t* head, size_t headSize, const BinaryArray& body);
   System::TcpConnection& m_conn;
 };
 
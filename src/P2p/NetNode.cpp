@@ -730,7 +730,7 @@ namespace CryptoNote
   bool NodeServer::timedSync() {
     COMMAND_TIMED_SYNC::request arg = boost::value_initialized<COMMAND_TIMED_SYNC::request>();
     m_payload_handler.get_payload_sync_data(arg.payload_data);
-    auto cmdBuf = LevinProtocol::encode<COMMAND_TIMED_SYNC::request>(arg);
+    auto cmdBuf = std::make_shared<const BinaryArray>(LevinProtocol::encode<COMMAND_TIMED_SYNC::request>(arg));
 
     forEachConnection([&](P2pConnectionContext& conn) {
       if (conn.peerId &&
@@ -1236,12 +1236,17 @@ namespace CryptoNote
 
   void NodeServer::relay_notify_to_all(int command, const BinaryArray& data_buff, const net_connection_id* excludeConnection) {
     net_connection_id excludeId = excludeConnection ? *excludeConnection : boost::value_initialized<net_connection_id>();
+    std::shared_ptr<const BinaryArray> buffer;
 
     forEachConnection([&](P2pConnectionContext& conn) {
       if (conn.peerId && conn.m_connection_id != excludeId &&
           (conn.m_state == CryptoNoteConnectionContext::state_normal ||
            conn.m_state == CryptoNoteConnectionContext::state_synchronizing)) {
-        conn.pushMessage(P2pMessage(P2pMessage::NOTIFY, command, data_buff));
+        if (!buffer) {
+          buffer = std::make_shared<const BinaryArray>(data_buff);
+        }
+
+        conn.pushMessage(P2pMessage(P2pMessage::NOTIFY, command, buffer));
       }
     });
   }
@@ -1660,13 +1665,13 @@ namespace CryptoNote
           logger(DEBUGGING) << ctx << "msg " << msg.type << ':' << msg.command;
           switch (msg.type) {
           case P2pMessage::COMMAND:
-            proto.sendMessage(msg.command, msg.buffer, true);
+            proto.sendMessage(msg.command, *msg.buffer, true);
             break;
           case P2pMessage::NOTIFY:
-            proto.sendMessage(msg.command, msg.buffer, false);
+            proto.sendMessage(msg.command, *msg.buffer, false);
             break;
           case P2pMessage::REPLY:
-            proto.sendReply(msg.command, msg.buffer, msg.returnCode);
+            proto.sendReply(msg.command, *msg.buffer, msg.returnCode);
             break;
           default:
             assert(false);
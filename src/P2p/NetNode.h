@@ -10,6 +10,7 @@
 #pragma once
 
 #include <functional>
+#include <memory>
 #include <unordered_map>
 
 #include <boost/functional/hash.hpp>
@@ -51,8 +52,13 @@ namespace CryptoNote
       NOTIFY
     };
 
-    P2pMessage(Type type, uint32_t command, const BinaryArray& buffer, int32_t returnCode = 0) :
-      type(type), command(command), buffer(buffer), returnCode(returnCode) {
+    P2pMessage(Type type, uint32_t command, BinaryArray buffer, int32_t returnCode = 0) :
+      type(type), command(command), buffer(std::make_shared<const BinaryArray>(std::move(buffer))), returnCode(returnCode) {
+    }
+
+    // the payload is immutable, so one buffer can be queued to many connections
+    P2pMessage(Type type, uint32_t command, std::shared_ptr<const BinaryArray> buffer, int32_t returnCode = 0) :
+      type(type), command(command), buffer(std::move(buffer)), returnCode(returnCode) {
     }
 
     P2pMessage(P2pMessage&& msg) :
@@ -60,12 +66,12 @@ namespace CryptoNote
     }
 
     size_t size() {
-      return buffer.size();
+      return buffer->size();
     }
 
     Type type;
     uint32_t command;
-    const BinaryArray buffer;
+    std::shared_ptr<const BinaryArray> buffer;
     int32_t returnCode;
   };
 
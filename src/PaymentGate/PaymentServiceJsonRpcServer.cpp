@@ -28,7 +28,7 @@
 #include "CryptoNoteCore/CryptoNoteTools.h"
 #include "CryptoNoteProtocol/CryptoNoteProtocolHandler.h"
 #include "Serialization/JsonInputValueSerializer.h"
-#include "Serialization/JsonOutputStreamSerializer.h"
+#include "Serialization/JsonOutputTextSerializer.h"
 
 namespace PaymentService {
 
@@ -68,7 +68,7 @@ PaymentServiceJsonRpcServer::PaymentServiceJsonRpcServer(System::Dispatcher& sys
   handlers.emplace("sendFusionTransaction", jsonHandler<SendFusionTransaction::Request, SendFusionTransaction::Response>(std::bind(&PaymentServiceJsonRpcServer::handleSendFusionTransaction, this, std::placeholders::_1, std::placeholders::_2)));
 }
 
-void PaymentServiceJsonRpcServer::processJsonRpcRequest(const Common::JsonValue& req, Common::JsonValue& resp) {
+void PaymentServiceJsonRpcServer::processJsonRpcRequest(const Common::JsonValue& req, Common::JsonValue& resp, std::string& result) {
   try {
     prepareJsonResponse(req, resp);
 
@@ -95,14 +95,13 @@ void PaymentServiceJsonRpcServer::processJsonRpcRequest(const Common::JsonValue&
 
     logger(Logging::DEBUGGING) << method << " request came";
 
-    Common::JsonValue params(Common::JsonValue::OBJECT);
-    if (req.contains("params")) {
-      params = req("params");
-    }
+    static const Common::JsonValue emptyParams(Common::JsonValue::OBJECT);
+    const Common::JsonValue& params = req.contains("params") ? req("params") : emptyParams;
 
-    it->second(params, resp);
+    it->second(params, resp, result);
   } catch (std::exception& e) {
     logger(Logging::WARNING) << "Error occurred while processing JsonRpc request: " << e.what();
+    result.clear();
     makeGenericErrorReponse(resp, e.what());
   }
 }
@@ -12,7 +12,7 @@
 #include "JsonRpcServer/JsonRpcServer.h"
 #include "PaymentServiceJsonRpcMessages.h"
 #include "Serialization/JsonInputValueSerializer.h"
-#include "Serialization/JsonOutputStreamSerializer.h"
+#include "Serialization/JsonOutputTextSerializer.h"
 
 namespace PaymentService {
 
@@ -24,17 +24,17 @@ public:
   PaymentServiceJsonRpcServer(const PaymentServiceJsonRpcServer&) = delete;
 
 protected:
-  virtual void processJsonRpcRequest(const Common::JsonValue& req, Common::JsonValue& resp) override;
+  virtual void processJsonRpcRequest(const Common::JsonValue& req, Common::JsonValue& resp, std::string& result) override;
 
 private:
   WalletService& service;
   Logging::LoggerRef logger;
 
-  typedef std::function<void (const Common::JsonValue& jsonRpcParams, Common::JsonValue& jsonResponse)> HandlerFunction;
+  typedef std::function<void (const Common::JsonValue& jsonRpcParams, Common::JsonValue& jsonResponse, std::string& jsonResult)> HandlerFunction;
 
   template <typename RequestType, typename ResponseType, typename RequestHandler>
   HandlerFunction jsonHandler(RequestHandler handler) {
-    return [handler] (const Common::JsonValue& jsonRpcParams, Common::JsonValue& jsonResponse) mutable {
+    return [handler] (const Common::JsonValue& jsonRpcParams, Common::JsonValue& jsonResponse, std::string& jsonResult) mutable {
       RequestType request;
       ResponseType response;
 
@@ -52,9 +52,8 @@ private:
         return;
       }
 
-      CryptoNote::JsonOutputStreamSerializer outputSerializer;
-      serialize(response, outputSerializer);
-      fillJsonResponse(outputSerializer.getValue(), jsonResponse);
+      CryptoNote::JsonOutputTextSerializer outputSerializer(jsonResult);
+      outputSerializer(response, "");
     };
   }
 
@@ -22,9 +22,10 @@
 #include <sys/eventfd.h>
 #include <sys/timerfd.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <string.h>
-#include <ucontext.h>
 #include <unistd.h>
+#include "MachineContext.h"
 #include "ErrorMessage.h"
 
 namespace System {
@@ -57,6 +58,7 @@ static_assert(Dispatcher::SIZEOF_PTHREAD_MUTEX_T == sizeof(pthread_mutex_t), "in
 
 //const size_t STACK_SIZE = 64 * 1024;
 const size_t STACK_SIZE = 512 * 1024;
+const int MAX_EPOLL_EVENTS = 64;
 
 };
 
@@ -66,45 +68,41 @@ Dispatcher::Dispatcher() {
   if (epoll == -1) {
     message = "epoll_create1 failed, " + lastErrorMessage();
   } else {
-    mainContext.ucontext = new ucontext_t;
-    if (getcontext(reinterpret_cast<ucontext_t*>(mainContext.ucontext)) == -1) {
-      message = "getcontext failed, " + lastErrorMessage();
+    mainContext.ucontext = new MachineContext;
+    remoteSpawnEvent = eventfd(0, O_NONBLOCK);
+    if(remoteSpawnEvent == -1) {
+      message = "eventfd failed, " + lastErrorMessage();
     } else {
-      remoteSpawnEvent = eventfd(0, O_NONBLOCK);
-      if(remoteSpawnEvent == -1) {
-        message = "eventfd failed, " + lastErrorMessage();
-      } else {
-        remoteSpawnEventContext.writeContext = nullptr;
-        remoteSpawnEventContext.readContext = nullptr;
+      remoteSpawnEventContext.writeContext = nullptr;
+      remoteSpawnEventContext.readContext = nullptr;
 
-        epoll_event remoteSpawnEventEpollEvent;
-        remoteSpawnEventEpollEvent.events = EPOLLIN;
-        remoteSpawnEventEpollEvent.data.ptr = &remoteSpawnEventContext;
+      epoll_event remoteSpawnEventEpollEvent;
+      remoteSpawnEventEpollEvent.events = EPOLLIN;
+      remoteSpawnEventEpollEvent.data.ptr = &remoteSpawnEventContext;
 
-        if (epoll_ctl(epoll, EPOLL_CTL_ADD, remoteSpawnEvent, &remoteSpawnEventEpollEvent) == -1) {
-          message = "epoll_ctl failed, " + lastErrorMessage();
-        } else {
-          *reinterpret_cast<pthread_mutex_t*>(this->mutex) = pthread_mutex_t(PTHREAD_MUTEX_INITIALIZER);
-
-          mainContext.interrupted = false;
-          mainContext.group = &contextGroup;
-          mainContext.groupPrev = nullptr;
-          mainContext.groupNext = nullptr;
-          mainContext.inExecutionQueue = false;
-          contextGroup.firstContext = nullptr;
-          contextGroup.lastContext = nullptr;
-          contextGroup.firstWaiter = nullptr;
-          contextGroup.lastWaiter = nullptr;
-          currentContext = &mainContext;
-          firstResumingContext = nullptr;
-          firstReusableContext = nullptr;
-          runningContextCount = 0;
-          return;
-        }
-
-        auto result = close(remoteSpawnEvent);
-        assert(result == 0);
+      if (epoll_ctl(epoll, EPOLL_CTL_ADD, remoteSpawnEvent, &remoteSpawnEventEpollEvent) == -1) {
+        message = "epoll_ctl failed, " + lastErrorMessage();
+      } else {
+        *reinterpret_cast<pthread_mutex_t*>(this->mutex) = pthread_mutex_t(PTHREAD_MUTEX_INITIALIZER);
+
+        mainContext.interrupted = false;
+        mainContext.group = &contextGroup;
+        mainContext.groupPrev = nullptr;
+        mainContext.groupNext = nullptr;
+        mainContext.inExecutionQueue = false;
+        contextGroup.firstContext = nullptr;
+        contextGroup.lastContext = nullptr;
+        contextGroup.firstWaiter = nullptr;
+        contextGroup.lastWaiter = nullptr;
+        currentContext = &mainContext;
+        firstResumingContext = nullptr;
+        firstReusableContext = nullptr;
+        runningContextCount = 0;
+        return;
       }
+
+      auto result = close(remoteSpawnEvent);
+      assert(result == 0);
     }
 
     auto result = close(epoll);
@@ -125,11 +123,11 @@ Dispatcher::~Dispatcher() {
   assert(firstResumingContext == nullptr);
   assert(runningContextCount == 0);
   while (firstReusableContext != nullptr) {
-    auto ucontext = static_cast<ucontext_t*>(firstReusableContext->ucontext);
-    auto stackPtr = static_cast<uint8_t *>(firstReusableContext->stackPtr);
+    auto context = static_cast<MachineContext*>(firstReusableContext->ucontext);
+    auto stackPtr = firstReusableContext->stackPtr;
     firstReusableContext = firstReusableContext->next;
-    delete[] stackPtr;
-    delete ucontext;
+    freeStack(stackPtr, STACK_SIZE);
+    delete context;
   }
 
   while (!timers.empty()) {
@@ -148,11 +146,11 @@ Dispatcher::~Dispatcher() {
 
 void Dispatcher::clear() {
   while (firstReusableContext != nullptr) {
-    auto ucontext = static_cast<ucontext_t*>(firstReusableContext->ucontext);
-    auto stackPtr = static_cast<uint8_t *>(firstReusableContext->stackPtr);
+    auto context = static_cast<MachineContext*>(firstReusableContext->ucontext);
+    auto stackPtr = firstReusableContext->stackPtr;
     firstReusableContext = firstReusableContext->next;
-    delete[] stackPtr;
-    delete ucontext;
+    freeStack(stackPtr, STACK_SIZE);
+    delete context;
   }
 
   while (!timers.empty()) {
@@ -176,11 +174,21 @@ void Dispatcher::dispatch() {
       break;
     }
 
-    epoll_event event;
-    int count = epoll_wait(epoll, &event, 1, -1);
-    if (count == 1) {
-      ContextPair *contextPair = static_cast<ContextPair*>(event.data.ptr);
-      if(((event.events & (EPOLLIN | EPOLLOUT)) != 0) && contextPair->readContext == nullptr && contextPair->writeContext == nullptr) {
+    // Everything that became ready is queued in one go; pointers taken from the events stay
+    // valid because no context runs before the whole batch is processed.
+    epoll_event events[MAX_EPOLL_EVENTS];
+    int count = epoll_wait(epoll, events, MAX_EPOLL_EVENTS, -1);
+    if (count == -1) {
+      if (errno != EINTR) {
+        throw std::runtime_error("Dispatcher::dispatch, epoll_wait failed, "  + lastErrorMessage());
+      }
+
+      continue;
+    }
+
+    for (int i = 0; i < count; ++i) {
+      ContextPair *contextPair = static_cast<ContextPair*>(events[i].data.ptr);
+      if(((events[i].events & (EPOLLIN | EPOLLOUT)) != 0) && contextPair->readContext == nullptr && contextPair->writeContext == nullptr) {
         uint64_t buf;
         auto transferred = read(remoteSpawnEvent, &buf, sizeof buf);
         if(transferred == -1) {
@@ -196,31 +204,27 @@ void Dispatcher::dispatch() {
         continue;
       }
 
-      if ((event.events & EPOLLOUT) != 0) {
-        context = contextPair->writeContext->context;
-        contextPair->writeContext->events = event.events;
-      } else if ((event.events & EPOLLIN) != 0) {
-        context = contextPair->readContext->context;
-        contextPair->readContext->events = event.events;
+      OperationContext* operationContext;
+      if ((events[i].events & EPOLLOUT) != 0) {
+        operationContext = contextPair->writeContext;
+      } else if ((events[i].events & EPOLLIN) != 0) {
+        operationContext = contextPair->readContext;
       } else {
         continue;
       }
 
-      assert(context != nullptr);
-      break;
-    }
-
-    if (errno != EINTR) {
-      throw std::runtime_error("Dispatcher::dispatch, epoll_wait failed, "  + lastErrorMessage());
+      assert(operationContext->context != nullptr);
+      // the operation has completed, an interrupt arriving before the context runs must not cancel it
+      operationContext->context->interruptProcedure = nullptr;
+      operationContext->events = events[i].events;
+      pushContext(operationContext->context);
     }
   }
 
   if (context != currentContext) {
-    ucontext_t* oldContext = static_cast<ucontext_t*>(currentContext->ucontext);
+    MachineContext* oldContext = static_cast<MachineContext*>(currentContext->ucontext);
     currentContext = context;
-    if (swapcontext(oldContext, static_cast<ucontext_t *>(context->ucontext)) == -1) {
-      throw std::runtime_error("Dispatcher::dispatch, swapcontext failed, " + lastErrorMessage());
-    }
+    switchContext(*oldContext, *static_cast<MachineContext*>(context->ucontext));
   }
 }
 
@@ -303,8 +307,8 @@ void Dispatcher::spawn(std::function<void()>&& procedure) {
 
 void Dispatcher::yield() {
   for(;;){
-    epoll_event events[16];
-    int count = epoll_wait(epoll, events, 16, 0);
+    epoll_event events[MAX_EPOLL_EVENTS];
+    int count = epoll_wait(epoll, events, MAX_EPOLL_EVENTS, 0);
     if (count == 0) {
       break;
     }
@@ -369,22 +373,13 @@ int Dispatcher::getEpoll() const {
 
 NativeContext& Dispatcher::getReusableContext() {
   if(firstReusableContext == nullptr) {
-    ucontext_t* newlyCreatedContext = new ucontext_t;
-    if (getcontext(newlyCreatedContext) == -1) { //makecontext precondition
-      throw std::runtime_error("Dispatcher::getReusableContext, getcontext failed, " + lastErrorMessage());
-    }
-
-    auto stackPointer = new uint8_t[STACK_SIZE];
-    newlyCreatedContext->uc_stack.ss_sp = stackPointer;
-    newlyCreatedContext->uc_stack.ss_size = STACK_SIZE;
-
+    MachineContext* newlyCreatedContext = new MachineContext;
+    auto stackPointer = allocateStack(STACK_SIZE);
     ContextMakingData makingContextData {this, newlyCreatedContext};
-    makecontext(newlyCreatedContext, (void(*)())contextProcedureStatic, 1, reinterpret_cast<int*>(&makingContextData));
+    makeContext(*newlyCreatedContext, stackPointer, STACK_SIZE, contextProcedureStatic, &makingContextData);
 
-    ucontext_t* oldContext = static_cast<ucontext_t*>(currentContext->ucontext);
-    if (swapcontext(oldContext, newlyCreatedContext) == -1) {
-      throw std::runtime_error("Dispatcher::getReusableContext, swapcontext failed, " + lastErrorMessage());
-    }
+    MachineContext* oldContext = static_cast<MachineContext*>(currentContext->ucontext);
+    switchContext(*oldContext, *newlyCreatedContext);
 
     assert(firstReusableContext != nullptr);
     assert(firstReusableContext->ucontext == newlyCreatedContext);
@@ -433,10 +428,8 @@ void Dispatcher::contextProcedure(void* ucontext) {
   context.next = nullptr;
   context.inExecutionQueue = false;
   firstReusableContext = &context;
-  ucontext_t* oldContext = static_cast<ucontext_t*>(context.ucontext);
-  if (swapcontext(oldContext, static_cast<ucontext_t*>(currentContext->ucontext)) == -1) {
-    throw std::runtime_error("Dispatcher::contextProcedure, swapcontext failed, " + lastErrorMessage());
-  }
+  MachineContext* oldContext = static_cast<MachineContext*>(context.ucontext);
+  switchContext(*oldContext, *static_cast<MachineContext*>(currentContext->ucontext));
 
   for (;;) {
     ++runningContextCount;
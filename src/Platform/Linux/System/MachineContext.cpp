@@ -0,0 +1,143 @@
+// Copyright (c) 2012-2016, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "MachineContext.h"
+#include <cassert>
+#include <cstdint>
+#include <stdexcept>
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include "ErrorMessage.h"
+
+#ifdef __x86_64__
+
+// Saved frame, from the suspended stack pointer up: mxcsr and the x87 control word,
+// r12, r13, r14, r15, rbx, rbp, return address.
+extern "C" void systemSwitchContext(void** from, void* to);
+extern "C" void systemContextEntry();
+
+asm(
+  ".text\n"
+  ".globl systemSwitchContext\n"
+  ".hidden systemSwitchContext\n"
+  ".type systemSwitchContext, @function\n"
+  ".align 16\n"
+  "systemSwitchContext:\n"
+  "  pushq %rbp\n"
+  "  pushq %rbx\n"
+  "  pushq %r15\n"
+  "  pushq %r14\n"
+  "  pushq %r13\n"
+  "  pushq %r12\n"
+  "  subq $8, %rsp\n"
+  "  stmxcsr (%rsp)\n"
+  "  fnstcw 4(%rsp)\n"
+  "  movq %rsp, (%rdi)\n"
+  "  movq %rsi, %rsp\n"
+  "  ldmxcsr (%rsp)\n"
+  "  fldcw 4(%rsp)\n"
+  "  addq $8, %rsp\n"
+  "  popq %r12\n"
+  "  popq %r13\n"
+  "  popq %r14\n"
+  "  popq %r15\n"
+  "  popq %rbx\n"
+  "  popq %rbp\n"
+  "  ret\n"
+  ".size systemSwitchContext, .-systemSwitchContext\n"
+
+  // first 'return' of a new context: r12 holds the argument, r13 the procedure
+  ".globl systemContextEntry\n"
+  ".hidden systemContextEntry\n"
+  ".type systemContextEntry, @function\n"
+  ".align 16\n"
+  "systemContextEntry:\n"
+  "  movq %r12, %rdi\n"
+  "  callq *%r13\n"
+  "  ud2\n"
+  ".size systemContextEntry, .-systemContextEntry\n"
+);
+
+#endif
+
+namespace System {
+
+#ifdef __x86_64__
+
+void makeContext(MachineContext& context, void* stack, size_t stackSize, void (*procedure)(void*), void* argument) {
+  uintptr_t top = (reinterpret_cast<uintptr_t>(stack) + stackSize) & ~static_cast<uintptr_t>(15);
+  uint64_t* frame = reinterpret_cast<uint64_t*>(top);
+  // the entry is 'returned' to with the stack 16-byte aligned, so the procedure is entered as if called
+  *--frame = reinterpret_cast<uint64_t>(&systemContextEntry);
+  *--frame = 0; // rbp
+  *--frame = 0; // rbx
+  *--frame = 0; // r15
+  *--frame = 0; // r14
+  *--frame = reinterpret_cast<uint64_t>(procedure); // r13
+  *--frame = reinterpret_cast<uint64_t>(argument); // r12
+  *--frame = 0x037F00001F80; // default x87 control word and mxcsr
+  context.stackPointer = frame;
+}
+
+void switchContext(MachineContext& from, MachineContext& to) {
+  systemSwitchContext(&from.stackPointer, to.stackPointer);
+}
+
+#else
+
+void makeContext(MachineContext& context, void* stack, size_t stackSize, void (*procedure)(void*), void* argument) {
+  if (getcontext(&context) == -1) { //makecontext precondition
+    throw std::runtime_error("makeContext, getcontext failed, " + lastErrorMessage());
+  }
+
+  context.uc_stack.ss_sp = stack;
+  context.uc_stack.ss_size = stackSize;
+  makecontext(&context, (void(*)())procedure, 1, reinterpret_cast<int*>(argument));
+}
+
+void switchContext(MachineContext& from, MachineContext& to) {
+  if (swapcontext(&from, &to) == -1) {
+    throw std::runtime_error("switchContext, swapcontext failed, " + lastErrorMessage());
+  }
+}
+
+#endif
+
+void* allocateStack(size_t stackSize) {
+  size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  void* mapping = mmap(nullptr, stackSize + pageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+  if (mapping == MAP_FAILED) {
+    throw std::runtime_error("allocateStack, mmap failed, " + lastErrorMessage());
+  }
+
+  if (mprotect(mapping, pageSize, PROT_NONE) == -1) {
+    std::string message = lastErrorMessage();
+    munmap(mapping, stackSize + pageSize);
+    throw std::runtime_error("allocateStack, mprotect failed, " + message);
+  }
+
+  return static_cast<uint8_t*>(mapping) + pageSize;
+}
+
+void freeStack(void* stack, size_t stackSize) {
+  size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  auto result = munmap(static_cast<uint8_t*>(stack) - pageSize, stackSize + pageSize);
+  assert(result == 0);
+}
+
+}
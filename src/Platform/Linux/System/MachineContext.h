@@ -0,0 +1,50 @@
+// Copyright (c) 2012-2016, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstddef>
+
+#ifndef __x86_64__
+#include <ucontext.h>
+#endif
+
+namespace System {
+
+// On x86-64 a context is just the stack pointer it was suspended at; switching saves the
+// callee-saved registers on the old stack and restores them from the new one. Unlike
+// swapcontext it leaves the signal mask alone, which saves a sigprocmask syscall per switch.
+// Other architectures fall back to ucontext.
+#ifdef __x86_64__
+struct MachineContext {
+  void* stackPointer;
+};
+#else
+typedef ucontext_t MachineContext;
+#endif
+
+// 'context' starts running 'procedure(argument)' on the given stack when it is switched to.
+// The procedure must never return.
+void makeContext(MachineContext& context, void* stack, size_t stackSize, void (*procedure)(void*), void* argument);
+void switchContext(MachineContext& from, MachineContext& to);
+
+// Stacks are mapped with a guard page below them, so an overflow faults instead of
+// overwriting another coroutine's memory. Pages are committed as they are touched.
+void* allocateStack(size_t stackSize);
+void freeStack(void* stack, size_t stackSize);
+
+}
@@ -17,9 +17,12 @@
 
 #include "TcpConnection.h"
 
+#include <algorithm>
 #include <arpa/inet.h>
 #include <cassert>
 #include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include <System/ErrorMessage.h>
@@ -28,6 +31,13 @@
 
 namespace System {
 
+namespace {
+
+// sendmsg accepts up to IOV_MAX vectors, the rest goes with the next call
+const size_t MAX_WRITE_BUFFERS = 64;
+
+}
+
 TcpConnection::TcpConnection() : dispatcher(nullptr) {
 }
 
@@ -161,13 +171,12 @@ size_t TcpConnection::read(uint8_t* data, size_t size) {
 
 std::size_t TcpConnection::write(const uint8_t* data, size_t size) {
   assert(dispatcher != nullptr);
-  assert(contextPair.writeContext == nullptr);
-  if (dispatcher->interrupted()) {
-    throw InterruptedException();
-  }
-
-  std::string message;
   if(size == 0) {
+    assert(contextPair.writeContext == nullptr);
+    if (dispatcher->interrupted()) {
+      throw InterruptedException();
+    }
+
     if(shutdown(connection, SHUT_WR) == -1) {
       throw std::runtime_error("TcpConnection::write, shutdown failed, " + lastErrorMessage());
     }
@@ -175,7 +184,30 @@ std::size_t TcpConnection::write(const uint8_t* data, size_t size) {
     return 0;
   }
 
-  ssize_t transferred = ::send(connection, (void *)data, size, MSG_NOSIGNAL);
+  Buffer buffer = {data, size};
+  return writev(&buffer, 1);
+}
+
+std::size_t TcpConnection::writev(const Buffer* buffers, std::size_t count) {
+  assert(dispatcher != nullptr);
+  assert(contextPair.writeContext == nullptr);
+  if (dispatcher->interrupted()) {
+    throw InterruptedException();
+  }
+
+  iovec vectors[MAX_WRITE_BUFFERS];
+  msghdr header = {};
+  header.msg_iov = vectors;
+  header.msg_iovlen = std::min(count, MAX_WRITE_BUFFERS);
+  size_t size = 0;
+  for (size_t i = 0; i < header.msg_iovlen; ++i) {
+    vectors[i].iov_base = const_cast<uint8_t*>(buffers[i].data);
+    vectors[i].iov_len = buffers[i].size;
+    size += buffers[i].size;
+  }
+
+  std::string message;
+  ssize_t transferred = ::sendmsg(connection, &header, MSG_NOSIGNAL);
   if (transferred == -1) {
     if (errno != EAGAIN) {
       message = "send failed, " + lastErrorMessage();
@@ -238,7 +270,7 @@ std::size_t TcpConnection::write(const uint8_t* data, size_t size) {
           throw std::runtime_error("TcpConnection::write, events & (EPOLLERR | EPOLLHUP) != 0");
         }
 
-        ssize_t transferred = ::send(connection, (void *)data, size, 0);
+        ssize_t transferred = ::sendmsg(connection, &header, MSG_NOSIGNAL);
         if (transferred == -1) {
           message = "send failed, "  + lastErrorMessage();
         } else {
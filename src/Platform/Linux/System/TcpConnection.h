@@ -17,6 +17,11 @@ class Ipv4Address;
 
 class TcpConnection {
 public:
+  struct Buffer {
+    const uint8_t* data;
+    std::size_t size;
+  };
+
   TcpConnection();
   TcpConnection(const TcpConnection&) = delete;
   TcpConnection(TcpConnection&& other);
@@ -25,6 +30,8 @@ public:
   TcpConnection& operator=(TcpConnection&& other);
   std::size_t read(uint8_t* data, std::size_t size);
   std::size_t write(const uint8_t* data, std::size_t size);
+  // Writes as much of the buffers as fits in one go, in order. The total size must not be 0.
+  std::size_t writev(const Buffer* buffers, std::size_t count);
   std::pair<Ipv4Address, uint16_t> getPeerAddressAndPort() const;
 
 private:
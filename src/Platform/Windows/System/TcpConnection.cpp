@@ -21,6 +21,9 @@ namespace System {
 
 namespace {
 
+// the rest of a longer buffer array goes with the next call
+const size_t MAX_WRITE_BUFFERS = 64;
+
 struct TcpConnectionContext : public OVERLAPPED {
   NativeContext* context;
   bool interrupted;
@@ -150,10 +153,29 @@ size_t TcpConnection::write(const uint8_t* data, size_t size) {
     return 0;
   }
 
-  WSABUF buf{static_cast<ULONG>(size), reinterpret_cast<char*>(const_cast<uint8_t*>(data))};
+  Buffer buffer = {data, size};
+  return writev(&buffer, 1);
+}
+
+size_t TcpConnection::writev(const Buffer* buffers, size_t count) {
+  assert(dispatcher != nullptr);
+  assert(writeContext == nullptr);
+  if (dispatcher->interrupted()) {
+    throw InterruptedException();
+  }
+
+  WSABUF bufs[MAX_WRITE_BUFFERS];
+  DWORD bufCount = static_cast<DWORD>(count < MAX_WRITE_BUFFERS ? count : MAX_WRITE_BUFFERS);
+  size_t size = 0;
+  for (DWORD i = 0; i < bufCount; ++i) {
+    bufs[i].len = static_cast<ULONG>(buffers[i].size);
+    bufs[i].buf = reinterpret_cast<char*>(const_cast<uint8_t*>(buffers[i].data));
+    size += buffers[i].size;
+  }
+
   TcpConnectionContext context;
   context.hEvent = NULL;
-  if (WSASend(connection, &buf, 1, NULL, 0, &context, NULL) != 0) {
+  if (WSASend(connection, bufs, bufCount, NULL, 0, &context, NULL) != 0) {
     int lastError = WSAGetLastError();
     if (lastError != WSA_IO_PENDING) {
       throw std::runtime_error("TcpConnection::write, WSASend failed, " + errorMessage(lastError));
@@ -365,10 +365,12 @@ struct COMMAND_RPC_GETBLOCKTEMPLATE {
   struct request {
     uint64_t reserve_size; //max 255 bytes
     std::string wallet_address;
+    std::string longpollid; // if set, wait until the template differs from the one with this id
 
     void serialize(ISerializer &s) {
       KV_MEMBER(reserve_size)
       KV_MEMBER(wallet_address)
+      KV_MEMBER(longpollid)
     }
   };
 
@@ -377,6 +379,7 @@ struct COMMAND_RPC_GETBLOCKTEMPLATE {
     uint32_t height;
     uint64_t reserved_offset;
     std::string blocktemplate_blob;
+    std::string longpollid;
     std::string status;
 
     void serialize(ISerializer &s) {
@@ -384,6 +387,7 @@ struct COMMAND_RPC_GETBLOCKTEMPLATE {
       KV_MEMBER(height)
       KV_MEMBER(reserved_offset)
       KV_MEMBER(blocktemplate_blob)
+      KV_MEMBER(longpollid)
       KV_MEMBER(status)
     }
   };
@@ -762,10 +766,12 @@ struct COMMAND_RPC_QUERY_BLOCKS_LITE {
   struct request {
     std::vector<Crypto::Hash> blockIds;
     uint64_t timestamp;
+    bool globalIndexes;  // also return the output global indexes of the transactions
 
     void serialize(ISerializer &s) {
       serializeAsBinary(blockIds, "block_ids", s);
       KV_MEMBER(timestamp)
+      KV_MEMBER(globalIndexes)
     }
   };
 
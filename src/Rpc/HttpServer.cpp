@@ -18,6 +18,9 @@
 // along with Karbo.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "HttpServer.h"
+#include <exception>
+#include <limits>
+#include <stdexcept>
 #include <boost/scope_exit.hpp>
 
 #include <Common/Base64.hpp>
@@ -41,12 +44,25 @@ namespace {
 namespace CryptoNote {
 
 HttpServer::HttpServer(System::Dispatcher& dispatcher, Logging::ILogger& log)
-  : m_dispatcher(dispatcher), workingContextGroup(dispatcher), logger(log, "HttpServer") {
+  : m_dispatcher(dispatcher), workingContextGroup(dispatcher), logger(log, "HttpServer"),
+  m_workerThreadsCount(0), m_workQueue(std::numeric_limits<size_t>::max()) {
 
 }
 
+HttpServer::~HttpServer() {
+  stopWorkers();
+}
+
+void HttpServer::setWorkerThreads(size_t count) {
+  m_workerThreadsCount = count;
+}
+
 void HttpServer::start(const std::string& address, uint16_t port, const std::string& user, const std::string& password) {
   m_listener = System::TcpListener(m_dispatcher, System::Ipv4Address(address), port);
+  for (size_t i = 0; i < m_workerThreadsCount; ++i) {
+    m_workers.emplace_back(std::bind(&HttpServer::workerLoop, this));
+  }
+
   workingContextGroup.spawn(std::bind(&HttpServer::acceptLoop, this));
   
   		if (!user.empty() || !password.empty()) {
@@ -57,6 +73,68 @@ void HttpServer::start(const std::string& address, uint16_t port, const std::str
 void HttpServer::stop() {
   workingContextGroup.interrupt();
   workingContextGroup.wait();
+  stopWorkers();
+}
+
+void HttpServer::stopWorkers() {
+  // connection contexts are gone at this point, so the queue holds no tasks referring to them
+  m_workQueue.close();
+  for (auto& worker : m_workers) {
+    worker.join();
+  }
+
+  m_workers.clear();
+}
+
+void HttpServer::workerLoop() {
+  std::function<void()> task;
+  while (m_workQueue.pop(task)) {
+    task();
+  }
+}
+
+void HttpServer::runOnWorker(const std::function<void()>& task) {
+  if (m_workers.empty()) {
+    task();
+    return;
+  }
+
+  System::Event done(m_dispatcher);
+  std::exception_ptr error;
+  System::Dispatcher& dispatcher = m_dispatcher;
+  bool queued = m_workQueue.push([&task, &done, &error, &dispatcher] {
+    try {
+      task();
+    } catch (...) {
+      error = std::current_exception();
+    }
+
+    // the waiting context may leave as soon as the event is set, touch nothing after it
+    auto event = &done;
+    dispatcher.remoteSpawn([event] { event->set(); });
+  });
+
+  if (!queued) {
+    throw std::runtime_error("HTTP server workers are stopped");
+  }
+
+  // the task refers to this frame, so keep waiting for it even when interrupted
+  bool interrupted = false;
+  while (!done.get()) {
+    try {
+      done.wait();
+    } catch (System::InterruptedException&) {
+      interrupted = true;
+    }
+  }
+
+  if (interrupted) {
+    m_dispatcher.interrupt();
+  }
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
 }
 
 void HttpServer::acceptLoop() {
@@ -18,7 +18,10 @@
 
 #pragma once 
 
+#include <functional>
+#include <thread>
 #include <unordered_set>
+#include <vector>
 
 #include <HTTP/HttpRequest.h>
 #include <HTTP/HttpResponse.h>
@@ -29,6 +32,7 @@
 #include <System/TcpConnection.h>
 #include <System/Event.h>
 
+#include <Common/BlockingQueue.h>
 #include <Logging/LoggerRef.h>
 
 namespace CryptoNote {
@@ -38,7 +42,10 @@ class HttpServer {
 public:
 
   HttpServer(System::Dispatcher& dispatcher, Logging::ILogger& log);
+  virtual ~HttpServer();
 
+  // Number of threads for runOnWorker, must be set before start
+  void setWorkerThreads(size_t count);
   void start(const std::string& address, uint16_t port, const std::string& user = "", const std::string& password = "");
   void stop();
 
@@ -49,17 +56,27 @@ protected:
 
   System::Dispatcher& m_dispatcher;
 
+  // Runs the task on a worker thread while the calling context waits on the dispatcher,
+  // runs it in place when there are no workers. Exceptions are rethrown to the caller.
+  void runOnWorker(const std::function<void()>& task);
+
 private:
 
   void acceptLoop();
   void connectionHandler(System::TcpConnection&& conn);
   bool authenticate(const HttpRequest& request) const;
+  void workerLoop();
+  void stopWorkers();
 
   System::ContextGroup workingContextGroup;
   Logging::LoggerRef logger;
   System::TcpListener m_listener;
   std::unordered_set<System::TcpConnection*> m_connections;
   std::string m_credentials;
+
+  size_t m_workerThreadsCount;
+  BlockingQueue<std::function<void()>> m_workQueue;
+  std::vector<std::thread> m_workers;
 };
 
 }
@@ -20,6 +20,7 @@
 #include <boost/optional.hpp>
 #include <boost/foreach.hpp>
 #include <functional>
+#include <memory>
 
 #include "CoreRpcServerCommandsDefinitions.h"
 #include <Common/JsonValue.h>
@@ -68,31 +69,50 @@ public:
   
   JsonRpcRequest() : psReq(Common::JsonValue::OBJECT) {}
 
+  // the parsed request points into body
+  JsonRpcRequest(const JsonRpcRequest&) = delete;
+  JsonRpcRequest& operator=(const JsonRpcRequest&) = delete;
+
+  // The request is read straight from the text, params included; psReq only
+  // holds requests built with setParams(). The parse is kept for loadParams().
   bool parseRequest(const std::string& requestBody) {
+    body = requestBody;
     try {
-      psReq = Common::JsonValue::fromString(requestBody);
+      parsed.reset(new JsonInputTextSerializer(body));
     } catch (std::exception&) {
       throw JsonRpcError(errParseError);
     }
 
-    if (!psReq.contains("method")) {
+    if (!(*parsed)(method, "method")) {
       throw JsonRpcError(errInvalidRequest);
     }
 
-    method = psReq("method").getString();
-
-    if (psReq.contains("id")) {
-      id = psReq("id");
+    std::string idText;
+    if (parsed->valueText("id", idText)) {
+      id = Common::JsonValue::fromString(idText);
     }
 
+    params.clear();
+    parsed->valueText("params", params);
     return true;
   }
 
+  // Missing or null params are loaded as an empty object.
   template <typename T>
   bool loadParams(T& v) const {
-    loadFromJsonValue(v, psReq.contains("params") ? 
-      psReq("params") : Common::JsonValue(Common::JsonValue::NIL));
-    return true;
+    if (!parsed) {
+      loadFromJsonValue(v, psReq.contains("params") ?
+        psReq("params") : Common::JsonValue(Common::JsonValue::NIL));
+      return true;
+    }
+
+    if (params.empty() || params == "null") {
+      static const char emptyParams[] = "{\"params\":{}}";
+      JsonInputTextSerializer s(emptyParams, sizeof(emptyParams) - 1);
+      return s(v, "params");
+    }
+
+    return (*parsed)(v, "params");
   }
 
   template <typename T>
@@ -105,6 +125,10 @@ public:
     return method;
   }
 
+  const std::string& getParamsString() const {
+    return params;
+  }
+
   void setMethod(const std::string& m) {
     method = m;
   }
@@ -124,6 +148,9 @@ private:
   Common::JsonValue psReq;
   OptionalId id;
   std::string method;
+  std::string body;
+  std::string params;
+  std::unique_ptr<JsonInputTextSerializer> parsed;
 };
 
 
@@ -159,17 +186,36 @@ public:
     return true;
   }
 
+  // The result is kept as text and spliced in last, so a large one is
+  // never turned into a JsonValue.
   std::string getBody() {
     psResp.set("jsonrpc", std::string("2.0"));
-    return psResp.toString();
+    std::string body = psResp.toString();
+    if (!result.empty()) {
+      body.pop_back();
+      body.reserve(body.size() + result.size() + 11);
+      body += ",\"result\":";
+      body += result;
+      body += '}';
+    }
+
+    return body;
   }
 
   template <typename T>
   bool setResult(const T& v) {
-    psResp.set("result", storeToJsonValue(v));
+    result = storeToJson(v);
     return true;
   }
 
+  const std::string& getResultText() const {
+    return result;
+  }
+
+  void setResultText(const std::string& text) {
+    result = text;
+  }
+
   template <typename T>
   bool getResult(T& v) const {
     if (!psResp.contains("result")) {
@@ -182,6 +228,7 @@ public:
 
 private:
   Common::JsonValue psResp;
+  std::string result;
 };
 
 
@@ -8,9 +8,13 @@
 
 #include "RpcServer.h"
 
+#include <chrono>
 #include <future>
 #include <unordered_map>
 
+#include <System/InterruptedException.h>
+#include <System/Timer.h>
+
 // CryptoNote
 #include "BlockchainExplorerData.h"
 #include "Common/StringTools.h"
@@ -82,38 +86,116 @@ RpcServer::HandlerFunction jsonMethod(bool (RpcServer::*handler)(typename Comman
 std::unordered_map<std::string, RpcServer::RpcHandler<RpcServer::HandlerFunction>> RpcServer::s_handlers = {
 
   // binary handlers
-  { "/getblocks.bin", { binMethod<COMMAND_RPC_GET_BLOCKS_FAST>(&RpcServer::on_get_blocks), false } },
-  { "/queryblocks.bin", { binMethod<COMMAND_RPC_QUERY_BLOCKS>(&RpcServer::on_query_blocks), false } },
-  { "/queryblockslite.bin", { binMethod<COMMAND_RPC_QUERY_BLOCKS_LITE>(&RpcServer::on_query_blocks_lite), false } },
-  { "/get_o_indexes.bin", { binMethod<COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES>(&RpcServer::on_get_indexes), false } },
-  { "/getrandom_outs.bin", { binMethod<COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS>(&RpcServer::on_get_random_outs), false } },
-  { "/get_pool_changes.bin", { binMethod<COMMAND_RPC_GET_POOL_CHANGES>(&RpcServer::onGetPoolChanges), false } },
-  { "/get_pool_changes_lite.bin", { binMethod<COMMAND_RPC_GET_POOL_CHANGES_LITE>(&RpcServer::onGetPoolChangesLite), false } },
+  { "/getblocks.bin", { binMethod<COMMAND_RPC_GET_BLOCKS_FAST>(&RpcServer::on_get_blocks), false, true, ResponseCache::NONE } },
+  { "/queryblocks.bin", { binMethod<COMMAND_RPC_QUERY_BLOCKS>(&RpcServer::on_query_blocks), false, true, ResponseCache::NONE } },
+  { "/queryblockslite.bin", { binMethod<COMMAND_RPC_QUERY_BLOCKS_LITE>(&RpcServer::on_query_blocks_lite), false, true, ResponseCache::NONE } },
+  { "/get_o_indexes.bin", { binMethod<COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES>(&RpcServer::on_get_indexes), false, true, ResponseCache::NONE } },
+  { "/getrandom_outs.bin", { binMethod<COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS>(&RpcServer::on_get_random_outs), false, true, ResponseCache::NONE } },
+  { "/get_pool_changes.bin", { binMethod<COMMAND_RPC_GET_POOL_CHANGES>(&RpcServer::onGetPoolChanges), false, true, ResponseCache::NONE } },
+  { "/get_pool_changes_lite.bin", { binMethod<COMMAND_RPC_GET_POOL_CHANGES_LITE>(&RpcServer::onGetPoolChangesLite), false, true, ResponseCache::NONE } },
 
   // json handlers
-  { "/getinfo", { jsonMethod<COMMAND_RPC_GET_INFO>(&RpcServer::on_get_info), true } },
-  { "/getheight", { jsonMethod<COMMAND_RPC_GET_HEIGHT>(&RpcServer::on_get_height), true } },
-  { "/gettransactions", { jsonMethod<COMMAND_RPC_GET_TRANSACTIONS>(&RpcServer::on_get_transactions), false } },
-  { "/sendrawtransaction", { jsonMethod<COMMAND_RPC_SEND_RAW_TX>(&RpcServer::on_send_raw_tx), false } },
-  { "/feeinfo", { jsonMethod<COMMAND_RPC_GET_FEE_ADDRESS>(&RpcServer::on_get_fee_info), true } }, 
-  { "/peers", { jsonMethod<COMMAND_RPC_GET_PEER_LIST>(&RpcServer::on_get_peer_list), true } },
-  { "/getpeers", { jsonMethod<COMMAND_RPC_GET_PEER_LIST>(&RpcServer::on_get_peer_list), true } },
-  { "/get_transaction_hashes_by_payment_id", { jsonMethod<COMMAND_RPC_GET_TRANSACTION_HASHES_BY_PAYMENT_ID>(&RpcServer::on_get_transaction_hashes_by_paymentid), true } },
+  { "/getinfo", { jsonMethod<COMMAND_RPC_GET_INFO>(&RpcServer::on_get_info), true, false, ResponseCache::NODE } },
+  { "/getheight", { jsonMethod<COMMAND_RPC_GET_HEIGHT>(&RpcServer::on_get_height), true, false, ResponseCache::NONE } },
+  { "/gettransactions", { jsonMethod<COMMAND_RPC_GET_TRANSACTIONS>(&RpcServer::on_get_transactions), false, true, ResponseCache::NONE } },
+  { "/sendrawtransaction", { jsonMethod<COMMAND_RPC_SEND_RAW_TX>(&RpcServer::on_send_raw_tx), false, false, ResponseCache::NONE } },
+  { "/feeinfo", { jsonMethod<COMMAND_RPC_GET_FEE_ADDRESS>(&RpcServer::on_get_fee_info), true, false, ResponseCache::CHAIN } },
+  { "/peers", { jsonMethod<COMMAND_RPC_GET_PEER_LIST>(&RpcServer::on_get_peer_list), true, false, ResponseCache::NONE } },
+  { "/getpeers", { jsonMethod<COMMAND_RPC_GET_PEER_LIST>(&RpcServer::on_get_peer_list), true, false, ResponseCache::NONE } },
+  { "/get_transaction_hashes_by_payment_id", { jsonMethod<COMMAND_RPC_GET_TRANSACTION_HASHES_BY_PAYMENT_ID>(&RpcServer::on_get_transaction_hashes_by_paymentid), true, false, ResponseCache::NONE } },
 
   // json rpc
-  { "/json_rpc", { std::bind(&RpcServer::processJsonRpcRequest, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3), true } }
+  { "/json_rpc", { std::bind(&RpcServer::processJsonRpcRequest, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3), true, false, ResponseCache::NONE } }
 };
 
 RpcServer::RpcServer(System::Dispatcher& dispatcher, Logging::ILogger& log, core& c, NodeServer& p2p, const ICryptoNoteProtocolQuery& protocolQuery) :
-  HttpServer(dispatcher, log), logger(log, "RpcServer"), m_core(c), m_p2p(p2p), m_protocolQuery(protocolQuery) {
+  HttpServer(dispatcher, log), logger(log, "RpcServer"), m_core(c), m_p2p(p2p), m_protocolQuery(protocolQuery),
+  m_chainGeneration(0), m_poolGeneration(0), m_pendingNotifications(0), m_blockTemplateChanged(dispatcher), m_responseCacheBytes(0) {
+  m_core.addObserver(this);
+}
+
+RpcServer::~RpcServer() {
+  m_core.removeObserver(this);
+
+  // notifications spawned before the observer was removed still refer to this server
+  while (m_pendingNotifications != 0) {
+    m_dispatcher.yield();
+  }
+}
+
+void RpcServer::blockchainUpdated() {
+  ++m_chainGeneration;
+  spawnBlockTemplateNotification();
+}
+
+void RpcServer::poolUpdated() {
+  ++m_poolGeneration;
+  spawnBlockTemplateNotification();
+}
+
+void RpcServer::spawnBlockTemplateNotification() {
+  ++m_pendingNotifications;
+  m_dispatcher.remoteSpawn([this] {
+    notifyBlockTemplateChanged();
+    --m_pendingNotifications;
+  });
+}
+
+void RpcServer::notifyBlockTemplateChanged() {
+  // wake up all parked long polls, they check themselves whether to return
+  m_blockTemplateChanged.set();
+  m_blockTemplateChanged.clear();
+}
+
+// The id is the top block hash followed by the pool generation.
+std::string RpcServer::getLongPollId() {
+  return Common::podToHex(m_core.get_tail_id()) + std::to_string(m_poolGeneration);
+}
+
+void RpcServer::waitForBlockTemplateChange(const std::string& longPollId) {
+  const size_t topIdSize = 2 * sizeof(Crypto::Hash);
+  auto start = std::chrono::steady_clock::now();
+  auto timeout = std::chrono::seconds(RPC_LONGPOLL_TIMEOUT);
+  auto poolInterval = std::chrono::seconds(RPC_LONGPOLL_POOL_INTERVAL);
+
+  // the timer only wakes this poll up, the loop decides when it is over: once
+  // the pool interval has passed, so that a pool change that came earlier
+  // ends the poll, and at the timeout
+  System::ContextGroup timerGroup(m_dispatcher);
+  timerGroup.spawn([this, timeout, poolInterval] {
+    try {
+      System::Timer timer(m_dispatcher);
+      timer.sleep(poolInterval);
+      notifyBlockTemplateChanged();
+      timer.sleep(timeout - poolInterval);
+      notifyBlockTemplateChanged();
+    } catch (System::InterruptedException&) {
+    }
+  });
+
+  for (;;) {
+    std::string currentId = getLongPollId();
+    if (currentId.compare(0, topIdSize, longPollId, 0, topIdSize) != 0) {
+      break;
+    }
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    if (elapsed >= timeout || (currentId != longPollId && elapsed >= poolInterval)) {
+      break;
+    }
+
+    m_blockTemplateChanged.wait();
+  }
 }
 
 void RpcServer::processRequest(const HttpRequest& request, HttpResponse& response) {
   auto url = request.getUrl();
-  if (url.find(".bin") == std::string::npos) {
-    logger(TRACE) << "RPC request came: \n" << request << std::endl;
-  } else {
-    logger(TRACE) << "RPC request came: " << url << std::endl;
+  if (logger.isEnabled(TRACE)) {
+    if (url.find(".bin") == std::string::npos) {
+      logger(TRACE) << "RPC request came: \n" << request << std::endl;
+    } else {
+      logger(TRACE) << "RPC request came: " << url << std::endl;
+    }
   }
 
   auto it = s_handlers.find(url);
@@ -128,7 +210,28 @@ void RpcServer::processRequest(const HttpRequest& request, HttpResponse& respons
     return;
   }
 
-  it->second.handler(this, request, response);
+  std::string cacheKey;
+  if (it->second.cache != ResponseCache::NONE) {
+    cacheKey = url + '\n' + request.getBody();
+    const CachedResponse* cached = findCachedResponse(it->second.cache, cacheKey);
+    if (cached != nullptr) {
+      response.setBody(cached->body);
+      return;
+    }
+  }
+
+  CachedResponse entry = newCachedResponse();
+  bool result = false;
+  if (it->second.runOnWorker) {
+    runOnWorker([this, &it, &request, &response, &result] { result = it->second.handler(this, request, response); });
+  } else {
+    result = it->second.handler(this, request, response);
+  }
+
+  if (it->second.cache != ResponseCache::NONE && result && response.getStatus() == HttpResponse::STATUS_200) {
+    entry.body = response.getBody();
+    storeCachedResponse(cacheKey, std::move(entry));
+  }
 }
 
 bool RpcServer::processJsonRpcRequest(const HttpRequest& request, HttpResponse& response) {
@@ -146,22 +249,22 @@ bool RpcServer::processJsonRpcRequest(const HttpRequest& request, HttpResponse&
     jsonResponse.setId(jsonRequest.getId()); // copy id
 
     static std::unordered_map<std::string, RpcServer::RpcHandler<JsonMemberMethod>> jsonRpcHandlers = {
-      { "f_blocks_list_json", { makeMemberMethod(&RpcServer::f_on_blocks_list_json), false } },
-      { "f_block_json", { makeMemberMethod(&RpcServer::f_on_block_json), false } },
-      { "f_transaction_json", { makeMemberMethod(&RpcServer::f_on_transaction_json), false } },
-      { "f_on_transactions_pool_json", { makeMemberMethod(&RpcServer::f_on_transactions_pool_json), false } },
-      { "check_tx_key", { makeMemberMethod(&RpcServer::on_check_tx_key), false } },
-      { "check_tx_proof", { makeMemberMethod(&RpcServer::k_on_check_tx_proof), false } },
-      { "check_reserve_proof", { makeMemberMethod(&RpcServer::k_on_check_reserve_proof), false } },
-      { "getblockcount", { makeMemberMethod(&RpcServer::on_getblockcount), true } },
-      { "on_getblockhash", { makeMemberMethod(&RpcServer::on_getblockhash), false } },
-      { "getblocktemplate", { makeMemberMethod(&RpcServer::on_getblocktemplate), false } },
-      { "getcurrencyid", { makeMemberMethod(&RpcServer::on_get_currency_id), true } },
-      { "submitblock", { makeMemberMethod(&RpcServer::on_submitblock), false } },
-      { "getlastblockheader", { makeMemberMethod(&RpcServer::on_get_last_block_header), false } },
-      { "gettransactionhashesbypaymentid", { makeMemberMethod(&RpcServer::on_get_transaction_hashes_by_paymentid), true } },
-      { "getblockheaderbyhash", { makeMemberMethod(&RpcServer::on_get_block_header_by_hash), false } },
-      { "getblockheaderbyheight", { makeMemberMethod(&RpcServer::on_get_block_header_by_height), false } }
+      { "f_blocks_list_json", { makeMemberMethod(&RpcServer::f_on_blocks_list_json), false, true, ResponseCache::CHAIN } },
+      { "f_block_json", { makeMemberMethod(&RpcServer::f_on_block_json), false, true, ResponseCache::NONE } },
+      { "f_transaction_json", { makeMemberMethod(&RpcServer::f_on_transaction_json), false, true, ResponseCache::NONE } },
+      { "f_on_transactions_pool_json", { makeMemberMethod(&RpcServer::f_on_transactions_pool_json), false, true, ResponseCache::NONE } },
+      { "check_tx_key", { makeMemberMethod(&RpcServer::on_check_tx_key), false, false, ResponseCache::NONE } },
+      { "check_tx_proof", { makeMemberMethod(&RpcServer::k_on_check_tx_proof), false, false, ResponseCache::NONE } },
+      { "check_reserve_proof", { makeMemberMethod(&RpcServer::k_on_check_reserve_proof), false, false, ResponseCache::NONE } },
+      { "getblockcount", { makeMemberMethod(&RpcServer::on_getblockcount), true, false, ResponseCache::NONE } },
+      { "on_getblockhash", { makeMemberMethod(&RpcServer::on_getblockhash), false, true, ResponseCache::NONE } },
+      { "getblocktemplate", { makeMemberMethod(&RpcServer::on_getblocktemplate), false, false, ResponseCache::NONE } },
+      { "getcurrencyid", { makeMemberMethod(&RpcServer::on_get_currency_id), true, false, ResponseCache::NONE } },
+      { "submitblock", { makeMemberMethod(&RpcServer::on_submitblock), false, false, ResponseCache::NONE } },
+      { "getlastblockheader", { makeMemberMethod(&RpcServer::on_get_last_block_header), false, true, ResponseCache::CHAIN } },
+      { "gettransactionhashesbypaymentid", { makeMemberMethod(&RpcServer::on_get_transaction_hashes_by_paymentid), true, false, ResponseCache::NONE } },
+      { "getblockheaderbyhash", { makeMemberMethod(&RpcServer::on_get_block_header_by_hash), false, true, ResponseCache::CHAIN } },
+      { "getblockheaderbyheight", { makeMemberMethod(&RpcServer::on_get_block_header_by_height), false, true, ResponseCache::CHAIN } }
     };
 
     auto it = jsonRpcHandlers.find(jsonRequest.getMethod());
@@ -173,7 +276,29 @@ bool RpcServer::processJsonRpcRequest(const HttpRequest& request, HttpResponse&
       throw JsonRpcError(CORE_RPC_ERROR_CODE_CORE_BUSY, "Core is busy");
     }
 
-    it->second.handler(this, jsonRequest, jsonResponse);
+    std::string cacheKey;
+    const CachedResponse* cached = nullptr;
+    if (it->second.cache != ResponseCache::NONE) {
+      cacheKey = "json_rpc\n" + jsonRequest.getMethod() + '\n' + jsonRequest.getParamsString();
+      cached = findCachedResponse(it->second.cache, cacheKey);
+    }
+
+    if (cached != nullptr) {
+      jsonResponse.setResultText(cached->result);
+    } else {
+      CachedResponse entry = newCachedResponse();
+      bool result = false;
+      if (it->second.runOnWorker) {
+        runOnWorker([this, &it, &jsonRequest, &jsonResponse, &result] { result = it->second.handler(this, jsonRequest, jsonResponse); });
+      } else {
+        result = it->second.handler(this, jsonRequest, jsonResponse);
+      }
+
+      if (it->second.cache != ResponseCache::NONE && result && !jsonResponse.getResultText().empty()) {
+        entry.result = jsonResponse.getResultText();
+        storeCachedResponse(cacheKey, std::move(entry));
+      }
+    }
 
   } catch (const JsonRpcError& err) {
     jsonResponse.setError(err);
@@ -182,7 +307,7 @@ bool RpcServer::processJsonRpcRequest(const HttpRequest& request, HttpResponse&
   }
 
   response.setBody(jsonResponse.getBody());
-  logger(TRACE) << "JSON-RPC response: " << jsonResponse.getBody();
+  logger(TRACE) << "JSON-RPC response: " << response.getBody();
   return true;
 }
 
@@ -190,6 +315,59 @@ bool RpcServer::isCoreReady() {
   return m_core.currency().isTestnet() || m_p2p.get_payload_object().isSynchronized();
 }
 
+// Generations are taken before the handler runs, so a response computed while the chain
+// or the pool changes is already stale when it is stored.
+RpcServer::CachedResponse RpcServer::newCachedResponse() const {
+  CachedResponse response;
+  response.chainGeneration = m_chainGeneration;
+  response.poolGeneration = m_poolGeneration;
+  response.created = std::chrono::steady_clock::now();
+  return response;
+}
+
+const RpcServer::CachedResponse* RpcServer::findCachedResponse(ResponseCache cache, const std::string& key) const {
+  auto it = m_responseCache.find(key);
+  if (it == m_responseCache.end() || it->second.chainGeneration != m_chainGeneration) {
+    return nullptr;
+  }
+
+  if (cache == ResponseCache::CHAIN) {
+    return &it->second;
+  }
+
+  if (it->second.poolGeneration != m_poolGeneration) {
+    return nullptr;
+  }
+
+  if (cache == ResponseCache::NODE && std::chrono::steady_clock::now() - it->second.created >= std::chrono::seconds(RPC_RESPONSE_CACHE_MAX_AGE)) {
+    return nullptr;
+  }
+
+  return &it->second;
+}
+
+void RpcServer::storeCachedResponse(const std::string& key, CachedResponse&& response) {
+  size_t size = key.size() + response.body.size() + response.result.size();
+  if (size > RPC_RESPONSE_CACHE_MAX_BYTES) {
+    return;
+  }
+
+  auto it = m_responseCache.find(key);
+  if (it != m_responseCache.end()) {
+    m_responseCacheBytes -= key.size() + it->second.body.size() + it->second.result.size();
+    m_responseCache.erase(it);
+  }
+
+  // stale entries are only replaced on the next identical request, so start over once full
+  if (m_responseCache.size() >= RPC_RESPONSE_CACHE_MAX_ENTRIES || m_responseCacheBytes + size > RPC_RESPONSE_CACHE_MAX_BYTES) {
+    m_responseCache.clear();
+    m_responseCacheBytes = 0;
+  }
+
+  m_responseCache.emplace(key, std::move(response));
+  m_responseCacheBytes += size;
+}
+
 //
 // Binary handlers
 //
@@ -214,16 +392,10 @@ bool RpcServer::on_get_blocks(const COMMAND_RPC_GET_BLOCKS_FAST::request& req, C
   res.start_height = startBlockIndex;
 
   for (const auto& blockId : supplement) {
-    assert(m_core.have_block(blockId));
-    auto completeBlock = m_core.getBlock(blockId);
-    assert(completeBlock != nullptr);
-
     res.blocks.resize(res.blocks.size() + 1);
-    res.blocks.back().block = asString(toBinaryArray(completeBlock->getBlock()));
-
-    res.blocks.back().txs.reserve(completeBlock->getTransactionCount());
-    for (size_t i = 0; i < completeBlock->getTransactionCount(); ++i) {
-      res.blocks.back().txs.push_back(asString(toBinaryArray(completeBlock->getTransaction(i))));
+    if (!m_core.getRawBlock(blockId, res.blocks.back())) {
+      res.status = "Failed";
+      return false;
     }
   }
 
@@ -565,7 +737,7 @@ bool RpcServer::on_query_blocks_lite(const COMMAND_RPC_QUERY_BLOCKS_LITE::reques
   uint32_t startHeight;
   uint32_t currentHeight;
   uint32_t fullOffset;
-  if (!m_core.queryBlocksLite(req.blockIds, req.timestamp, startHeight, currentHeight, fullOffset, res.items)) {
+  if (!m_core.queryBlocksLite(req.blockIds, req.timestamp, startHeight, currentHeight, fullOffset, res.items, req.globalIndexes)) {
     res.status = "Failed to perform query";
     return false;
   }
@@ -631,23 +803,25 @@ bool RpcServer::on_get_random_outs(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOU
 
   res.status = CORE_RPC_STATUS_OK;
 
-  std::stringstream ss;
-  typedef COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount outs_for_amount;
-  typedef COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::out_entry out_entry;
+  if (logger.isEnabled(TRACE)) {
+    std::stringstream ss;
+    typedef COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount outs_for_amount;
+    typedef COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::out_entry out_entry;
 
-  std::for_each(res.outs.begin(), res.outs.end(), [&](outs_for_amount& ofa)  {
-    ss << "[" << ofa.amount << "]:";
+    std::for_each(res.outs.begin(), res.outs.end(), [&](outs_for_amount& ofa)  {
+      ss << "[" << ofa.amount << "]:";
 
-    assert(ofa.outs.size() && "internal error: ofa.outs.size() is empty");
+      assert(ofa.outs.size() && "internal error: ofa.outs.size() is empty");
 
-    std::for_each(ofa.outs.begin(), ofa.outs.end(), [&](out_entry& oe)
-    {
-      ss << oe.global_amount_index << " ";
+      std::for_each(ofa.outs.begin(), ofa.outs.end(), [&](out_entry& oe)
+      {
+        ss << oe.global_amount_index << " ";
+      });
+      ss << ENDL;
     });
-    ss << ENDL;
-  });
-  std::string s = ss.str();
-  logger(TRACE) << "COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS: " << ENDL << s;
+    std::string s = ss.str();
+    logger(TRACE) << "COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS: " << ENDL << s;
+  }
   res.status = CORE_RPC_STATUS_OK;
   return true;
 }
@@ -1260,6 +1434,12 @@ bool RpcServer::on_getblocktemplate(const COMMAND_RPC_GETBLOCKTEMPLATE::request&
     throw JsonRpc::JsonRpcError{ CORE_RPC_ERROR_CODE_WRONG_WALLET_ADDRESS, "Failed to parse wallet address" };
   }
 
+  if (!req.longpollid.empty()) {
+    waitForBlockTemplateChange(req.longpollid);
+  }
+
+  res.longpollid = getLongPollId();
+
   Block b = boost::value_initialized<Block>();
   CryptoNote::BinaryArray blob_reserve;
   blob_reserve.resize(req.reserve_size, 0);
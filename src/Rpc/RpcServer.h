@@ -10,12 +10,15 @@
 
 #include "HttpServer.h"
 
+#include <atomic>
+#include <chrono>
 #include <functional>
 #include <unordered_map>
 
 #include <Logging/LoggerRef.h>
 #include "Common/Math.h"
 #include "CoreRpcServerCommandsDefinitions.h"
+#include "CryptoNoteCore/ICoreObserver.h"
 
 namespace CryptoNote {
 
@@ -23,9 +26,10 @@ class core;
 class NodeServer;
 class ICryptoNoteProtocolQuery;
 
-class RpcServer : public HttpServer {
+class RpcServer : public HttpServer, public ICoreObserver {
 public:
   RpcServer(System::Dispatcher& dispatcher, Logging::ILogger& log, core& c, NodeServer& p2p, const ICryptoNoteProtocolQuery& protocolQuery);
+  ~RpcServer();
   typedef std::function<bool(RpcServer*, const HttpRequest& request, HttpResponse& response)> HandlerFunction;
   bool setFeeAddress(const std::string fee_address);
   bool setFeeAmount(const uint32_t fee_amount);
@@ -39,10 +43,29 @@ public:
 
 private:
 
+  // How long a response may be served again to an identical request
+  enum class ResponseCache {
+    NONE,
+    CHAIN, // until the chain changes
+    POOL,  // until the chain or the pool changes
+    NODE   // as POOL, but also reports node state, so at most RPC_RESPONSE_CACHE_MAX_AGE seconds
+  };
+
   template <class Handler>
   struct RpcHandler {
     const Handler handler;
     const bool allowBusyCore;
+    // reads the core only and may run on a worker thread
+    const bool runOnWorker;
+    const ResponseCache cache;
+  };
+
+  struct CachedResponse {
+    uint64_t chainGeneration;
+    uint64_t poolGeneration;
+    std::chrono::steady_clock::time_point created;
+    std::string body;          // plain requests
+    std::string result;        // JSON-RPC requests, the id differs between them
   };
 
   typedef void (RpcServer::*HandlerPtr)(const HttpRequest& request, HttpResponse& response);
@@ -52,6 +75,20 @@ private:
   bool processJsonRpcRequest(const HttpRequest& request, HttpResponse& response);
   bool isCoreReady();
 
+  // the response cache is used on the dispatcher thread only
+  CachedResponse newCachedResponse() const;
+  const CachedResponse* findCachedResponse(ResponseCache cache, const std::string& key) const;
+  void storeCachedResponse(const std::string& key, CachedResponse&& response);
+
+  // ICoreObserver, may be called from any thread
+  virtual void blockchainUpdated() override;
+  virtual void poolUpdated() override;
+
+  void spawnBlockTemplateNotification();
+  void notifyBlockTemplateChanged();
+  std::string getLongPollId();
+  void waitForBlockTemplateChange(const std::string& longPollId);
+
   // binary handlers
   bool on_get_blocks(const COMMAND_RPC_GET_BLOCKS_FAST::request& req, COMMAND_RPC_GET_BLOCKS_FAST::response& res);
   bool on_query_blocks(const COMMAND_RPC_QUERY_BLOCKS::request& req, COMMAND_RPC_QUERY_BLOCKS::response& res);
@@ -103,6 +140,16 @@ private:
   Crypto::SecretKey m_view_key = NULL_SECRET_KEY;
   AccountPublicAddress m_fee_acc;
   std::string m_node_info;
+
+  // bumped by the core observer callbacks
+  std::atomic<uint64_t> m_chainGeneration;
+  std::atomic<uint64_t> m_poolGeneration;
+  std::atomic<size_t> m_pendingNotifications; // spawned on the dispatcher, not run yet
+
+  // used on the dispatcher thread only
+  System::Event m_blockTemplateChanged;
+  std::unordered_map<std::string, CachedResponse> m_responseCache;
+  size_t m_responseCacheBytes; // keys and payloads of m_responseCache
 };
 
 }
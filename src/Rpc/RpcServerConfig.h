@@ -22,6 +22,7 @@ public:
 
   std::string bindIp;
   uint16_t bindPort;
+  uint32_t workerThreads;
 };
 
 }
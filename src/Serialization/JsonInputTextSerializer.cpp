@@ -0,0 +1,440 @@
+// Copyright (c) 2011-2017 The Cryptonote developers
+// Copyright (c) 2017-2018 The Circle Foundation & Conceal Devs
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "JsonInputTextSerializer.h"
+
+#include <cassert>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include "Common/StringTools.h"
+
+using namespace CryptoNote;
+
+namespace {
+
+const size_t MAX_NESTING_DEPTH = 100;
+
+bool isSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+bool isDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+bool isNumberChar(char c) {
+  return isDigit(c) || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+void decodeHex(const char* text, size_t size, void* data) {
+  for (size_t i = 0; i < size >> 1; ++i) {
+    static_cast<uint8_t*>(data)[i] = Common::fromHex(text[i << 1]) << 4 | Common::fromHex(text[(i << 1) + 1]);
+  }
+}
+
+}
+
+JsonInputTextSerializer::JsonInputTextSerializer(const char* data, size_t size) : m_data(data), m_size(size) {
+  size_t offset = skipSpace(0);
+  if (offset == m_size || m_data[offset] != '{') {
+    throw std::runtime_error("Serializer doesn't support this type of serialization: Object expected.");
+  }
+
+  enter(offset, false);
+}
+
+JsonInputTextSerializer::JsonInputTextSerializer(const std::string& text) : JsonInputTextSerializer(text.data(), text.size()) {
+}
+
+ISerializer::SerializerType JsonInputTextSerializer::type() const {
+  return ISerializer::INPUT;
+}
+
+bool JsonInputTextSerializer::beginObject(Common::StringView name) {
+  size_t offset;
+  if (!findValue(name, offset)) {
+    return false;
+  }
+
+  if (m_data[offset] != '{') {
+    throw std::runtime_error("Object expected");
+  }
+
+  enter(offset, false);
+  return true;
+}
+
+void JsonInputTextSerializer::endObject() {
+  assert(!m_levels.empty() && !m_levels.back().isArray);
+  m_entries.resize(m_levels.back().firstEntry);
+  m_levels.pop_back();
+}
+
+bool JsonInputTextSerializer::beginArray(size_t& size, Common::StringView name) {
+  size_t offset;
+  if (!findValue(name, offset)) {
+    size = 0;
+    return false;
+  }
+
+  if (m_data[offset] != '[') {
+    throw std::runtime_error("Array expected");
+  }
+
+  enter(offset, true);
+  size = m_levels.back().entryCount;
+  return true;
+}
+
+void JsonInputTextSerializer::endArray() {
+  assert(!m_levels.empty() && m_levels.back().isArray);
+  m_entries.resize(m_levels.back().firstEntry);
+  m_levels.pop_back();
+}
+
+bool JsonInputTextSerializer::operator()(uint8_t& value, Common::StringView name) {
+  return readInteger(name, value);
+}
+
+bool JsonInputTextSerializer::operator()(int16_t& value, Common::StringView name) {
+  return readInteger(name, value);
+}
+
+bool JsonInputTextSerializer::operator()(uint16_t& value, Common::StringView name) {
+  return readInteger(name, value);
+}
+
+bool JsonInputTextSerializer::operator()(int32_t& value, Common::StringView name) {
+  return readInteger(name, value);
+}
+
+bool JsonInputTextSerializer::operator()(uint32_t& value, Common::StringView name) {
+  return readInteger(name, value);
+}
+
+bool JsonInputTextSerializer::operator()(int64_t& value, Common::StringView name) {
+  return readInteger(name, value);
+}
+
+bool JsonInputTextSerializer::operator()(uint64_t& value, Common::StringView name) {
+  return readInteger(name, value);
+}
+
+bool JsonInputTextSerializer::operator()(double& value, Common::StringView name) {
+  size_t offset;
+  if (!findValue(name, offset)) {
+    return false;
+  }
+
+  size_t end = offset;
+  while (end < m_size && isNumberChar(m_data[end])) {
+    ++end;
+  }
+
+  std::istringstream stream(std::string(m_data + offset, end - offset));
+  if (end == offset || !(stream >> value)) {
+    throw std::runtime_error("Number expected");
+  }
+
+  return true;
+}
+
+bool JsonInputTextSerializer::operator()(bool& value, Common::StringView name) {
+  size_t offset;
+  if (!findValue(name, offset)) {
+    return false;
+  }
+
+  // literals were checked when the enclosing object was entered
+  if (m_data[offset] == 't') {
+    value = true;
+  } else if (m_data[offset] == 'f') {
+    value = false;
+  } else {
+    throw std::runtime_error("Bool expected");
+  }
+
+  return true;
+}
+
+bool JsonInputTextSerializer::operator()(std::string& value, Common::StringView name) {
+  const char* data;
+  size_t size;
+  if (!readString(name, data, size)) {
+    return false;
+  }
+
+  value.assign(data, size);
+  return true;
+}
+
+bool JsonInputTextSerializer::binary(void* value, size_t size, Common::StringView name) {
+  const char* data;
+  size_t dataSize;
+  if (!readString(name, data, dataSize)) {
+    return false;
+  }
+
+  if ((dataSize & 1) != 0) {
+    throw std::runtime_error("fromHex: invalid string size");
+  }
+
+  if (dataSize >> 1 > size) {
+    throw std::runtime_error("fromHex: invalid buffer size");
+  }
+
+  decodeHex(data, dataSize, value);
+  return true;
+}
+
+bool JsonInputTextSerializer::binary(std::string& value, Common::StringView name) {
+  const char* data;
+  size_t dataSize;
+  if (!readString(name, data, dataSize)) {
+    return false;
+  }
+
+  if ((dataSize & 1) != 0) {
+    throw std::runtime_error("fromHex: invalid string size");
+  }
+
+  value.resize(dataSize >> 1);
+  decodeHex(data, dataSize, &value[0]);
+  return true;
+}
+
+bool JsonInputTextSerializer::valueText(Common::StringView name, std::string& text) {
+  size_t offset;
+  if (!findValue(name, offset)) {
+    return false;
+  }
+
+  text.assign(m_data + offset, skipValue(offset, m_levels.size()) - offset);
+  return true;
+}
+
+// 'offset' points at the opening bracket. Every value inside is checked here,
+// so reading one later only has to look at its first character.
+void JsonInputTextSerializer::enter(size_t offset, bool isArray) {
+  if (m_levels.size() >= MAX_NESTING_DEPTH) {
+    throw std::runtime_error("Objects are nested too deep");
+  }
+
+  Level level = {};
+  level.isArray = isArray;
+  level.firstEntry = m_entries.size();
+
+  char close = isArray ? ']' : '}';
+  offset = skipSpace(offset + 1);
+  if (charAt(offset) == close) {
+    m_levels.push_back(level);
+    return;
+  }
+
+  for (;;) {
+    Entry entry = {Common::StringView::NIL, 0};
+    if (!isArray) {
+      if (charAt(offset) != '"') {
+        throw std::runtime_error("Unable to parse");
+      }
+
+      size_t nameEnd = skipString(offset);
+      entry.name = Common::StringView(m_data + offset + 1, nameEnd - offset - 2);
+      offset = skipSpace(nameEnd);
+      if (charAt(offset) != ':') {
+        throw std::runtime_error("Unable to parse");
+      }
+
+      offset = skipSpace(offset + 1);
+    }
+
+    entry.offset = offset;
+    offset = skipSpace(skipValue(offset, m_levels.size()));
+    m_entries.push_back(entry);
+    ++level.entryCount;
+
+    char c = charAt(offset);
+    if (c == close) {
+      break;
+    }
+
+    if (c != ',') {
+      throw std::runtime_error("Unable to parse");
+    }
+
+    offset = skipSpace(offset + 1);
+  }
+
+  m_levels.push_back(level);
+}
+
+bool JsonInputTextSerializer::findValue(Common::StringView name, size_t& offset) {
+  assert(!m_levels.empty());
+  Level& level = m_levels.back();
+
+  if (level.isArray) {
+    if (level.cursor >= level.entryCount) {
+      throw std::runtime_error("Array index out of range");
+    }
+
+    offset = m_entries[level.firstEntry + level.cursor++].offset;
+    return true;
+  }
+
+  for (size_t i = 0; i < level.entryCount; ++i) {
+    size_t index = (level.cursor + i) % level.entryCount;
+    const Entry& entry = m_entries[level.firstEntry + index];
+    if (entry.name == name) {
+      level.cursor = index + 1;
+      offset = entry.offset;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+size_t JsonInputTextSerializer::skipValue(size_t offset, size_t depth) const {
+  if (depth >= MAX_NESTING_DEPTH) {
+    throw std::runtime_error("Objects are nested too deep");
+  }
+
+  char c = charAt(offset);
+  if (c == '"') {
+    return skipString(offset);
+  }
+
+  if (c == '{' || c == '[') {
+    char close = c == '[' ? ']' : '}';
+    offset = skipSpace(offset + 1);
+    if (charAt(offset) == close) {
+      return offset + 1;
+    }
+
+    for (;;) {
+      if (close == '}') {
+        if (charAt(offset) != '"') {
+          throw std::runtime_error("Unable to parse");
+        }
+
+        offset = skipSpace(skipString(offset));
+        if (charAt(offset) != ':') {
+          throw std::runtime_error("Unable to parse");
+        }
+
+        offset = skipSpace(offset + 1);
+      }
+
+      offset = skipSpace(skipValue(offset, depth + 1));
+      c = charAt(offset++);
+      if (c == close) {
+        return offset;
+      }
+
+      if (c != ',') {
+        throw std::runtime_error("Unable to parse");
+      }
+
+      offset = skipSpace(offset);
+    }
+  }
+
+  const char* literal = c == 't' ? "true" : c == 'f' ? "false" : c == 'n' ? "null" : nullptr;
+  if (literal != nullptr) {
+    size_t size = strlen(literal);
+    if (size > m_size - offset || memcmp(m_data + offset, literal, size) != 0) {
+      throw std::runtime_error("Unable to parse");
+    }
+
+    return offset + size;
+  }
+
+  if (c == '-' || isDigit(c)) {
+    do {
+      ++offset;
+    } while (offset < m_size && isNumberChar(m_data[offset]));
+
+    return offset;
+  }
+
+  throw std::runtime_error("Unable to parse");
+}
+
+// 'offset' points at the opening quote, the result is past the closing one.
+size_t JsonInputTextSerializer::skipString(size_t offset) const {
+  ++offset;
+  for (;;) {
+    char c = charAt(offset);
+    if (c == '"') {
+      return offset + 1;
+    }
+
+    offset += c == '\\' ? 2 : 1;
+  }
+}
+
+size_t JsonInputTextSerializer::skipSpace(size_t offset) const {
+  while (offset < m_size && isSpace(m_data[offset])) {
+    ++offset;
+  }
+
+  return offset;
+}
+
+char JsonInputTextSerializer::charAt(size_t offset) const {
+  if (offset >= m_size) {
+    throw std::runtime_error("Unable to parse: unexpected end of text");
+  }
+
+  return m_data[offset];
+}
+
+template <typename T>
+bool JsonInputTextSerializer::readInteger(Common::StringView name, T& value) {
+  size_t offset;
+  if (!findValue(name, offset)) {
+    return false;
+  }
+
+  bool negative = m_data[offset] == '-';
+  if (negative) {
+    ++offset;
+  }
+
+  if (offset == m_size || !isDigit(m_data[offset])) {
+    throw std::runtime_error("Integer expected");
+  }
+
+  uint64_t v = 0;
+  while (offset < m_size && isDigit(m_data[offset])) {
+    v = v * 10 + (m_data[offset++] - '0');
+  }
+
+  if (offset < m_size && isNumberChar(m_data[offset])) {
+    throw std::runtime_error("Integer expected");
+  }
+
+  // negative values wrap, unsigned 64-bit fields are written as signed ones
+  value = static_cast<T>(negative ? 0 - v : v);
+  return true;
+}
+
+bool JsonInputTextSerializer::readString(Common::StringView name, const char*& data, size_t& size) {
+  size_t offset;
+  if (!findValue(name, offset)) {
+    return false;
+  }
+
+  if (m_data[offset] != '"') {
+    throw std::runtime_error("String expected");
+  }
+
+  data = m_data + offset + 1;
+  size = skipString(offset) - offset - 2;
+  return true;
+}
@@ -0,0 +1,86 @@
+// Copyright (c) 2011-2017 The Cryptonote developers
+// Copyright (c) 2017-2018 The Circle Foundation & Conceal Devs
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "ISerializer.h"
+
+namespace CryptoNote {
+
+// Deserializes straight from JSON text, without building a JsonValue tree.
+// Entering an object or an array indexes where its values start; a value is
+// decoded only when it is read. The root must be an object and is entered on
+// construction, like JsonInputValueSerializer. Strings are read verbatim,
+// escape sequences included, which is what JsonValue does as well.
+class JsonInputTextSerializer : public ISerializer {
+public:
+  // The text must outlive the serializer.
+  JsonInputTextSerializer(const char* data, size_t size);
+  JsonInputTextSerializer(const std::string& text);
+
+  virtual SerializerType type() const override;
+
+  virtual bool beginObject(Common::StringView name) override;
+  virtual void endObject() override;
+
+  virtual bool beginArray(size_t& size, Common::StringView name) override;
+  virtual void endArray() override;
+
+  virtual bool operator()(uint8_t& value, Common::StringView name) override;
+  virtual bool operator()(int16_t& value, Common::StringView name) override;
+  virtual bool operator()(uint16_t& value, Common::StringView name) override;
+  virtual bool operator()(int32_t& value, Common::StringView name) override;
+  virtual bool operator()(uint32_t& value, Common::StringView name) override;
+  virtual bool operator()(int64_t& value, Common::StringView name) override;
+  virtual bool operator()(uint64_t& value, Common::StringView name) override;
+  virtual bool operator()(double& value, Common::StringView name) override;
+  virtual bool operator()(bool& value, Common::StringView name) override;
+  virtual bool operator()(std::string& value, Common::StringView name) override;
+  virtual bool binary(void* value, size_t size, Common::StringView name) override;
+  virtual bool binary(std::string& value, Common::StringView name) override;
+
+  template<typename T>
+  bool operator()(T& value, Common::StringView name) {
+    return ISerializer::operator()(value, name);
+  }
+
+  // Gives the text of a value of any type, e.g. to keep a JSON-RPC id as is.
+  bool valueText(Common::StringView name, std::string& text);
+
+private:
+  struct Entry {
+    Common::StringView name; // empty for array items
+    size_t offset;
+  };
+
+  struct Level {
+    bool isArray;
+    size_t firstEntry;
+    size_t entryCount;
+    size_t cursor; // entry after the last one read, fields usually come in order
+  };
+
+  void enter(size_t offset, bool isArray);
+  bool findValue(Common::StringView name, size_t& offset);
+  size_t skipValue(size_t offset, size_t depth) const;
+  size_t skipString(size_t offset) const;
+  size_t skipSpace(size_t offset) const;
+  char charAt(size_t offset) const;
+
+  template <typename T>
+  bool readInteger(Common::StringView name, T& value);
+  bool readString(Common::StringView name, const char*& data, size_t& size);
+
+  const char* m_data;
+  size_t m_size;
+  std::vector<Entry> m_entries;
+  std::vector<Level> m_levels;
+};
+
+}
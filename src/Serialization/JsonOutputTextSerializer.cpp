@@ -0,0 +1,163 @@
+// Copyright (c) 2011-2017 The Cryptonote developers
+// Copyright (c) 2017-2018 The Circle Foundation & Conceal Devs
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "JsonOutputTextSerializer.h"
+
+#include <cassert>
+#include <cstdio>
+#include <stdexcept>
+
+#include "Common/StringTools.h"
+
+using namespace CryptoNote;
+
+JsonOutputTextSerializer::JsonOutputTextSerializer(std::string& text) : m_text(text) {
+}
+
+ISerializer::SerializerType JsonOutputTextSerializer::type() const {
+  return ISerializer::OUTPUT;
+}
+
+bool JsonOutputTextSerializer::beginObject(Common::StringView name) {
+  writeName(name);
+  m_text += '{';
+  m_levels.push_back({false, true});
+  return true;
+}
+
+void JsonOutputTextSerializer::endObject() {
+  assert(!m_levels.empty() && !m_levels.back().isArray);
+  m_levels.pop_back();
+  m_text += '}';
+}
+
+bool JsonOutputTextSerializer::beginArray(size_t& size, Common::StringView name) {
+  writeName(name);
+  m_text += '[';
+  m_levels.push_back({true, true});
+  return true;
+}
+
+void JsonOutputTextSerializer::endArray() {
+  assert(!m_levels.empty() && m_levels.back().isArray);
+  m_levels.pop_back();
+  m_text += ']';
+}
+
+// Unsigned values go through int64_t as JsonValue keeps integers signed.
+bool JsonOutputTextSerializer::operator()(uint8_t& value, Common::StringView name) {
+  writeInteger(static_cast<int64_t>(value), name);
+  return true;
+}
+
+bool JsonOutputTextSerializer::operator()(int16_t& value, Common::StringView name) {
+  writeInteger(static_cast<int64_t>(value), name);
+  return true;
+}
+
+bool JsonOutputTextSerializer::operator()(uint16_t& value, Common::StringView name) {
+  writeInteger(static_cast<int64_t>(value), name);
+  return true;
+}
+
+bool JsonOutputTextSerializer::operator()(int32_t& value, Common::StringView name) {
+  writeInteger(static_cast<int64_t>(value), name);
+  return true;
+}
+
+bool JsonOutputTextSerializer::operator()(uint32_t& value, Common::StringView name) {
+  writeInteger(static_cast<int64_t>(value), name);
+  return true;
+}
+
+bool JsonOutputTextSerializer::operator()(int64_t& value, Common::StringView name) {
+  writeInteger(value, name);
+  return true;
+}
+
+bool JsonOutputTextSerializer::operator()(uint64_t& value, Common::StringView name) {
+  writeInteger(static_cast<int64_t>(value), name);
+  return true;
+}
+
+bool JsonOutputTextSerializer::operator()(double& value, Common::StringView name) {
+  char buffer[512];
+  int size = snprintf(buffer, sizeof(buffer), "%.11f", value);
+  if (size < 0 || static_cast<size_t>(size) >= sizeof(buffer)) {
+    throw std::runtime_error("Unable to format a number");
+  }
+
+  // same trimming as JsonValue: drop trailing zeros but keep one digit after the point
+  while (size > 1 && buffer[size - 2] != '.' && buffer[size - 1] == '0') {
+    --size;
+  }
+
+  writeName(name);
+  m_text.append(buffer, size);
+  return true;
+}
+
+bool JsonOutputTextSerializer::operator()(bool& value, Common::StringView name) {
+  writeName(name);
+  m_text += value ? "true" : "false";
+  return true;
+}
+
+bool JsonOutputTextSerializer::operator()(std::string& value, Common::StringView name) {
+  writeName(name);
+  m_text += '"';
+  m_text += value;
+  m_text += '"';
+  return true;
+}
+
+bool JsonOutputTextSerializer::binary(void* value, size_t size, Common::StringView name) {
+  writeName(name);
+  m_text += '"';
+  Common::toHex(value, size, m_text);
+  m_text += '"';
+  return true;
+}
+
+bool JsonOutputTextSerializer::binary(std::string& value, Common::StringView name) {
+  return binary(const_cast<char*>(value.data()), value.size(), name);
+}
+
+void JsonOutputTextSerializer::writeName(Common::StringView name) {
+  if (m_levels.empty()) {
+    return;
+  }
+
+  Level& level = m_levels.back();
+  if (!level.empty) {
+    m_text += ',';
+  }
+
+  level.empty = false;
+  if (!level.isArray) {
+    m_text += '"';
+    m_text.append(name.getData(), name.getSize());
+    m_text += "\":";
+  }
+}
+
+void JsonOutputTextSerializer::writeInteger(int64_t value, Common::StringView name) {
+  char buffer[24];
+  char* end = buffer + sizeof(buffer);
+  char* begin = end;
+  uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+  do {
+    *--begin = static_cast<char>('0' + magnitude % 10);
+    magnitude /= 10;
+  } while (magnitude != 0);
+
+  if (value < 0) {
+    *--begin = '-';
+  }
+
+  writeName(name);
+  m_text.append(begin, end);
+}
@@ -0,0 +1,64 @@
+// Copyright (c) 2011-2017 The Cryptonote developers
+// Copyright (c) 2017-2018 The Circle Foundation & Conceal Devs
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "ISerializer.h"
+
+namespace CryptoNote {
+
+// Serializes straight to JSON text, without building a JsonValue tree. The
+// outermost value is written without a name, so s(value, "") turns a struct
+// into a JSON object. Values are formatted the way JsonValue formats them,
+// strings included, which are written verbatim.
+class JsonOutputTextSerializer : public ISerializer {
+public:
+  // Appends to 'text'.
+  JsonOutputTextSerializer(std::string& text);
+
+  virtual SerializerType type() const override;
+
+  virtual bool beginObject(Common::StringView name) override;
+  virtual void endObject() override;
+
+  virtual bool beginArray(size_t& size, Common::StringView name) override;
+  virtual void endArray() override;
+
+  virtual bool operator()(uint8_t& value, Common::StringView name) override;
+  virtual bool operator()(int16_t& value, Common::StringView name) override;
+  virtual bool operator()(uint16_t& value, Common::StringView name) override;
+  virtual bool operator()(int32_t& value, Common::StringView name) override;
+  virtual bool operator()(uint32_t& value, Common::StringView name) override;
+  virtual bool operator()(int64_t& value, Common::StringView name) override;
+  virtual bool operator()(uint64_t& value, Common::StringView name) override;
+  virtual bool operator()(double& value, Common::StringView name) override;
+  virtual bool operator()(bool& value, Common::StringView name) override;
+  virtual bool operator()(std::string& value, Common::StringView name) override;
+  virtual bool binary(void* value, size_t size, Common::StringView name) override;
+  virtual bool binary(std::string& value, Common::StringView name) override;
+
+  template<typename T>
+  bool operator()(T& value, Common::StringView name) {
+    return ISerializer::operator()(value, name);
+  }
+
+private:
+  struct Level {
+    bool isArray;
+    bool empty;
+  };
+
+  void writeName(Common::StringView name);
+  void writeInteger(int64_t value, Common::StringView name);
+
+  std::string& m_text;
+  std::vector<Level> m_levels;
+};
+
+}
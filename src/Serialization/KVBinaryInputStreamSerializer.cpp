@@ -10,7 +10,6 @@
 #include <cassert>
 #include <cstring>
 #include <stdexcept>
-#include <Common/StreamTools.h>
 #include "KVBinaryCommon.h"
 
 using namespace Common;
@@ -18,182 +17,390 @@ using namespace CryptoNote;
 
 namespace {
 
-template <typename T>
-T readPod(Common::IInputStream& s) {
-  T v;
-  read(s, &v, sizeof(T));
-  return v;
-}
+const size_t MAX_STRING_SIZE = 100 * 1024 * 1024;
+const size_t MAX_NESTING_DEPTH = 100;
 
-template <typename T, typename JsonT = T>
-JsonValue readPodJson(Common::IInputStream& s) {
-  JsonValue jv;
-  jv = static_cast<JsonT>(readPod<T>(s));
-  return jv;
+size_t fixedValueSize(uint8_t type) {
+  switch (type) {
+  case BIN_KV_SERIALIZE_TYPE_INT64:
+  case BIN_KV_SERIALIZE_TYPE_UINT64:
+  case BIN_KV_SERIALIZE_TYPE_DOUBLE:
+    return 8;
+  case BIN_KV_SERIALIZE_TYPE_INT32:
+  case BIN_KV_SERIALIZE_TYPE_UINT32:
+    return 4;
+  case BIN_KV_SERIALIZE_TYPE_INT16:
+  case BIN_KV_SERIALIZE_TYPE_UINT16:
+    return 2;
+  case BIN_KV_SERIALIZE_TYPE_INT8:
+  case BIN_KV_SERIALIZE_TYPE_UINT8:
+  case BIN_KV_SERIALIZE_TYPE_BOOL:
+    return 1;
+  default:
+    return 0;
+  }
 }
 
-template <typename T>
-JsonValue readIntegerJson(Common::IInputStream& s) {
-  return readPodJson<T, int64_t>(s);
 }
 
-size_t readVarint(Common::IInputStream& s) {
-  uint8_t b = read<uint8_t>(s);
-  uint8_t size_mask = b & PORTABLE_RAW_SIZE_MARK_MASK;
-  size_t bytesLeft = 0;
+KVBinaryInputStreamSerializer::KVBinaryInputStreamSerializer(const void* data, size_t size) :
+  m_data(static_cast<const uint8_t*>(data)), m_size(size) {
+  parseHeader();
+}
 
-  switch (size_mask){
-  case PORTABLE_RAW_SIZE_MARK_BYTE:
-    bytesLeft = 0;
-    break;
-  case PORTABLE_RAW_SIZE_MARK_WORD:
-    bytesLeft = 1;
-    break;
-  case PORTABLE_RAW_SIZE_MARK_DWORD:
-    bytesLeft = 3;
-    break;
-  case PORTABLE_RAW_SIZE_MARK_INT64:
-    bytesLeft = 7;
-    break;
+KVBinaryInputStreamSerializer::KVBinaryInputStreamSerializer(Common::IInputStream& strm) {
+  char chunk[4096];
+  size_t bytesRead;
+  while ((bytesRead = strm.readSome(chunk, sizeof(chunk))) != 0) {
+    m_buffer.append(chunk, bytesRead);
   }
 
-  size_t value = b;
+  m_data = reinterpret_cast<const uint8_t*>(m_buffer.data());
+  m_size = m_buffer.size();
+  parseHeader();
+}
 
-  for (size_t i = 1; i <= bytesLeft; ++i) {
-    size_t n = read<uint8_t>(s);
-    value |= n << (i * 8);
+ISerializer::SerializerType KVBinaryInputStreamSerializer::type() const {
+  return ISerializer::INPUT;
+}
+
+void KVBinaryInputStreamSerializer::parseHeader() {
+  auto hdr = readPod<KVBinaryStorageBlockHeader>(0);
+
+  if (
+    hdr.m_signature_a != PORTABLE_STORAGE_SIGNATUREA ||
+    hdr.m_signature_b != PORTABLE_STORAGE_SIGNATUREB) {
+    throw std::runtime_error("Invalid binary storage signature");
   }
 
-  value >>= 2;
-  return value;
+  if (hdr.m_ver != PORTABLE_STORAGE_FORMAT_VER) {
+    throw std::runtime_error("Unknown binary storage format version");
+  }
+
+  enterObject(sizeof(hdr));
 }
 
-std::string readString(Common::IInputStream& s) {
-  auto size = readVarint(s);
-  if (size > 100 * 1024 * 1024) {
-    throw std::runtime_error("string size is too big");
+bool KVBinaryInputStreamSerializer::beginObject(Common::StringView name) {
+  assert(!m_levels.empty());
+  Level& level = m_levels.back();
+
+  if (level.isArray) {
+    if (level.itemType != BIN_KV_SERIALIZE_TYPE_OBJECT) {
+      throw std::runtime_error("Object expected");
+    }
+
+    size_t offset = level.position;
+    level.position = skipValue(offset, BIN_KV_SERIALIZE_TYPE_OBJECT, 0);
+    enterObject(offset);
+    return true;
   }
 
-  std::string str;
-  str.resize(size);
-  if (size) {
-    read(s, &str[0], size);
+  uint8_t type;
+  size_t offset;
+  if (!findValue(name, type, offset)) {
+    return false;
+  }
+
+  if (type != BIN_KV_SERIALIZE_TYPE_OBJECT) {
+    throw std::runtime_error("Object expected");
   }
-  return str;
+
+  enterObject(offset);
+  return true;
 }
 
-JsonValue readStringJson(Common::IInputStream& s) {
-  return JsonValue(readString(s));
+void KVBinaryInputStreamSerializer::endObject() {
+  assert(!m_levels.empty() && !m_levels.back().isArray);
+  m_entries.resize(m_levels.back().firstEntry);
+  m_levels.pop_back();
 }
 
-void readName(Common::IInputStream& s, std::string& name) {
-  uint8_t len = readPod<uint8_t>(s);
-  if (len) {
-    name.resize(len);
-    read(s, &name[0], len);
+bool KVBinaryInputStreamSerializer::beginArray(size_t& size, Common::StringView name) {
+  uint8_t type;
+  size_t offset;
+  if (!findValue(name, type, offset)) {
+    size = 0;
+    return false;
+  }
+
+  if (!(type & BIN_KV_SERIALIZE_FLAG_ARRAY)) {
+    throw std::runtime_error("Array expected");
   }
+
+  Level level = {};
+  level.isArray = true;
+  level.itemType = type & ~BIN_KV_SERIALIZE_FLAG_ARRAY;
+  size = readVarint(offset);
+  level.position = offset;
+  m_levels.push_back(level);
+  return true;
 }
 
-JsonValue loadValue(Common::IInputStream& stream, uint8_t type);
-JsonValue loadSection(Common::IInputStream& stream);
-JsonValue loadEntry(Common::IInputStream& stream);
-JsonValue loadArray(Common::IInputStream& stream, uint8_t itemType);
+void KVBinaryInputStreamSerializer::endArray() {
+  assert(!m_levels.empty() && m_levels.back().isArray);
+  m_levels.pop_back();
+}
 
+bool KVBinaryInputStreamSerializer::operator()(uint8_t& value, Common::StringView name) {
+  return readNumber(name, value);
+}
 
-JsonValue loadSection(Common::IInputStream& stream) {
-  JsonValue sec(JsonValue::OBJECT);
-  size_t count = readVarint(stream);
-  std::string name;
+bool KVBinaryInputStreamSerializer::operator()(int16_t& value, Common::StringView name) {
+  return readNumber(name, value);
+}
 
-  while (count--) {
-    readName(stream, name);
-    sec.insert(name, loadEntry(stream));
-  }
+bool KVBinaryInputStreamSerializer::operator()(uint16_t& value, Common::StringView name) {
+  return readNumber(name, value);
+}
 
-  return sec;
+bool KVBinaryInputStreamSerializer::operator()(int32_t& value, Common::StringView name) {
+  return readNumber(name, value);
 }
 
-JsonValue loadValue(Common::IInputStream& stream, uint8_t type) {
-  switch (type) {
-  case BIN_KV_SERIALIZE_TYPE_INT64:  return readIntegerJson<int64_t>(stream);
-  case BIN_KV_SERIALIZE_TYPE_INT32:  return readIntegerJson<int32_t>(stream);
-  case BIN_KV_SERIALIZE_TYPE_INT16:  return readIntegerJson<int16_t>(stream);
-  case BIN_KV_SERIALIZE_TYPE_INT8:   return readIntegerJson<int8_t>(stream);
-  case BIN_KV_SERIALIZE_TYPE_UINT64: return readIntegerJson<uint64_t>(stream);
-  case BIN_KV_SERIALIZE_TYPE_UINT32: return readIntegerJson<uint32_t>(stream);
-  case BIN_KV_SERIALIZE_TYPE_UINT16: return readIntegerJson<uint16_t>(stream);
-  case BIN_KV_SERIALIZE_TYPE_UINT8:  return readIntegerJson<uint8_t>(stream);
-  case BIN_KV_SERIALIZE_TYPE_DOUBLE: return readPodJson<double>(stream);
-  case BIN_KV_SERIALIZE_TYPE_BOOL:   return JsonValue(read<uint8_t>(stream) != 0);
-  case BIN_KV_SERIALIZE_TYPE_STRING: return readStringJson(stream);
-  case BIN_KV_SERIALIZE_TYPE_OBJECT: return loadSection(stream);
-  case BIN_KV_SERIALIZE_TYPE_ARRAY:  return loadArray(stream, type);
-  default:
-    throw std::runtime_error("Unknown data type");
-    break;
+bool KVBinaryInputStreamSerializer::operator()(uint32_t& value, Common::StringView name) {
+  return readNumber(name, value);
+}
+
+bool KVBinaryInputStreamSerializer::operator()(int64_t& value, Common::StringView name) {
+  return readNumber(name, value);
+}
+
+bool KVBinaryInputStreamSerializer::operator()(uint64_t& value, Common::StringView name) {
+  return readNumber(name, value);
+}
+
+bool KVBinaryInputStreamSerializer::operator()(double& value, Common::StringView name) {
+  return readNumber(name, value);
+}
+
+bool KVBinaryInputStreamSerializer::operator()(bool& value, Common::StringView name) {
+  return readNumber(name, value);
+}
+
+bool KVBinaryInputStreamSerializer::operator()(std::string& value, Common::StringView name) {
+  const char* data;
+  size_t size;
+  if (!readString(name, data, size)) {
+    return false;
   }
+
+  value.assign(data, size);
+  return true;
 }
 
-JsonValue loadEntry(Common::IInputStream& stream) {
-  uint8_t type = readPod<uint8_t>(stream);
+bool KVBinaryInputStreamSerializer::binary(void* value, size_t size, Common::StringView name) {
+  const char* data;
+  size_t dataSize;
+  if (!readString(name, data, dataSize)) {
+    return false;
+  }
 
-  if (type & BIN_KV_SERIALIZE_FLAG_ARRAY) {
-    type &= ~BIN_KV_SERIALIZE_FLAG_ARRAY;
-    return loadArray(stream, type);
+  if (dataSize != size) {
+    throw std::runtime_error("Binary block size mismatch");
   }
 
-  return loadValue(stream, type);
+  memcpy(value, data, size);
+  return true;
+}
+
+bool KVBinaryInputStreamSerializer::binary(std::string& value, Common::StringView name) {
+  return (*this)(value, name); // load as string
 }
 
-JsonValue loadArray(Common::IInputStream& stream, uint8_t itemType) {
-  JsonValue arr(JsonValue::ARRAY);
-  size_t count = readVarint(stream);
+void KVBinaryInputStreamSerializer::enterObject(size_t offset) {
+  if (m_levels.size() >= MAX_NESTING_DEPTH) {
+    throw std::runtime_error("Objects are nested too deep");
+  }
 
-  while (count--) {
-    arr.pushBack(loadValue(stream, itemType));
+  Level level = {};
+  level.isArray = false;
+  level.firstEntry = m_entries.size();
+  level.entryCount = readVarint(offset);
+
+  for (size_t i = 0; i < level.entryCount; ++i) {
+    require(offset, 1);
+    uint8_t nameSize = m_data[offset++];
+    require(offset, nameSize + 1);
+    Entry entry;
+    entry.name = Common::StringView(reinterpret_cast<const char*>(m_data + offset), nameSize);
+    entry.type = m_data[offset + nameSize];
+    entry.offset = offset + nameSize + 1;
+    offset = skipValue(entry.offset, entry.type, m_levels.size());
+    m_entries.push_back(entry);
   }
 
-  return arr;
+  m_levels.push_back(level);
 }
 
+bool KVBinaryInputStreamSerializer::findValue(Common::StringView name, uint8_t& type, size_t& offset) {
+  assert(!m_levels.empty());
+  Level& level = m_levels.back();
 
-JsonValue parseBinary(Common::IInputStream& stream) {
-  auto hdr = readPod<KVBinaryStorageBlockHeader>(stream);
+  if (level.isArray) {
+    type = level.itemType;
+    offset = level.position;
+    level.position = skipValue(offset, type, 0);
+    return true;
+  }
 
-  if (
-    hdr.m_signature_a != PORTABLE_STORAGE_SIGNATUREA ||
-    hdr.m_signature_b != PORTABLE_STORAGE_SIGNATUREB) {
-    throw std::runtime_error("Invalid binary storage signature");
+  for (size_t i = 0; i < level.entryCount; ++i) {
+    size_t index = (level.cursor + i) % level.entryCount;
+    const Entry& entry = m_entries[level.firstEntry + index];
+    if (entry.name == name) {
+      level.cursor = index + 1;
+      type = entry.type;
+      offset = entry.offset;
+      return true;
+    }
   }
 
-  if (hdr.m_ver != PORTABLE_STORAGE_FORMAT_VER) {
-    throw std::runtime_error("Unknown binary storage format version");
+  return false;
+}
+
+size_t KVBinaryInputStreamSerializer::skipValue(size_t offset, uint8_t type, size_t depth) const {
+  if (depth >= MAX_NESTING_DEPTH) {
+    throw std::runtime_error("Objects are nested too deep");
   }
 
-  return loadSection(stream);
+  if (type & BIN_KV_SERIALIZE_FLAG_ARRAY) {
+    uint8_t itemType = type & ~BIN_KV_SERIALIZE_FLAG_ARRAY;
+    size_t count = readVarint(offset);
+    size_t itemSize = fixedValueSize(itemType);
+    if (itemSize != 0) {
+      if (count > m_size / itemSize) {
+        throw std::runtime_error("Array is too big");
+      }
+
+      require(offset, count * itemSize);
+      return offset + count * itemSize;
+    }
+
+    while (count--) {
+      offset = skipValue(offset, itemType, depth + 1);
+    }
+
+    return offset;
+  }
+
+  size_t size = fixedValueSize(type);
+  if (size != 0) {
+    require(offset, size);
+    return offset + size;
+  }
+
+  switch (type) {
+  case BIN_KV_SERIALIZE_TYPE_STRING: {
+    size_t stringSize = readVarint(offset);
+    if (stringSize > MAX_STRING_SIZE) {
+      throw std::runtime_error("string size is too big");
+    }
+
+    require(offset, stringSize);
+    return offset + stringSize;
+  }
+  case BIN_KV_SERIALIZE_TYPE_OBJECT: {
+    size_t count = readVarint(offset);
+    while (count--) {
+      require(offset, 1);
+      offset += 1 + m_data[offset];
+      require(offset, 1);
+      uint8_t entryType = m_data[offset++];
+      offset = skipValue(offset, entryType, depth + 1);
+    }
+
+    return offset;
+  }
+  default:
+    throw std::runtime_error("Unknown data type");
+  }
 }
 
+size_t KVBinaryInputStreamSerializer::readVarint(size_t& offset) const {
+  require(offset, 1);
+  uint8_t b = m_data[offset];
+  uint8_t size_mask = b & PORTABLE_RAW_SIZE_MARK_MASK;
+  size_t bytesLeft = 0;
+
+  switch (size_mask){
+  case PORTABLE_RAW_SIZE_MARK_BYTE:
+    bytesLeft = 0;
+    break;
+  case PORTABLE_RAW_SIZE_MARK_WORD:
+    bytesLeft = 1;
+    break;
+  case PORTABLE_RAW_SIZE_MARK_DWORD:
+    bytesLeft = 3;
+    break;
+  case PORTABLE_RAW_SIZE_MARK_INT64:
+    bytesLeft = 7;
+    break;
+  }
+
+  require(offset, bytesLeft + 1);
+  size_t value = b;
+
+  for (size_t i = 1; i <= bytesLeft; ++i) {
+    size_t n = m_data[offset + i];
+    value |= n << (i * 8);
+  }
+
+  offset += bytesLeft + 1;
+  value >>= 2;
+  return value;
 }
 
-KVBinaryInputStreamSerializer::KVBinaryInputStreamSerializer(Common::IInputStream& strm) : JsonInputValueSerializer(parseBinary(strm)) {
+void KVBinaryInputStreamSerializer::require(size_t offset, size_t size) const {
+  if (offset > m_size || size > m_size - offset) {
+    throw std::runtime_error("Unexpected end of binary storage");
+  }
 }
 
-bool KVBinaryInputStreamSerializer::binary(void* value, size_t size, Common::StringView name) {
-  std::string str;
+template <typename T>
+T KVBinaryInputStreamSerializer::readPod(size_t offset) const {
+  require(offset, sizeof(T));
+  T v;
+  memcpy(&v, m_data + offset, sizeof(T));
+  return v;
+}
 
-  if (!(*this)(str, name)) {
+template <typename T>
+bool KVBinaryInputStreamSerializer::readNumber(Common::StringView name, T& value) {
+  uint8_t type;
+  size_t offset;
+  if (!findValue(name, type, offset)) {
     return false;
   }
 
-  if (str.size() != size) {
-    throw std::runtime_error("Binary block size mismatch");
+  switch (type) {
+  case BIN_KV_SERIALIZE_TYPE_INT64:  value = static_cast<T>(readPod<int64_t>(offset)); break;
+  case BIN_KV_SERIALIZE_TYPE_INT32:  value = static_cast<T>(readPod<int32_t>(offset)); break;
+  case BIN_KV_SERIALIZE_TYPE_INT16:  value = static_cast<T>(readPod<int16_t>(offset)); break;
+  case BIN_KV_SERIALIZE_TYPE_INT8:   value = static_cast<T>(readPod<int8_t>(offset)); break;
+  case BIN_KV_SERIALIZE_TYPE_UINT64: value = static_cast<T>(readPod<uint64_t>(offset)); break;
+  case BIN_KV_SERIALIZE_TYPE_UINT32: value = static_cast<T>(readPod<uint32_t>(offset)); break;
+  case BIN_KV_SERIALIZE_TYPE_UINT16: value = static_cast<T>(readPod<uint16_t>(offset)); break;
+  case BIN_KV_SERIALIZE_TYPE_UINT8:  value = static_cast<T>(readPod<uint8_t>(offset)); break;
+  case BIN_KV_SERIALIZE_TYPE_DOUBLE: value = static_cast<T>(readPod<double>(offset)); break;
+  case BIN_KV_SERIALIZE_TYPE_BOOL:   value = static_cast<T>(readPod<uint8_t>(offset) != 0); break;
+  default:
+    throw std::runtime_error("Number expected");
   }
 
-  memcpy(value, str.data(), size);
   return true;
 }
 
-bool KVBinaryInputStreamSerializer::binary(std::string& value, Common::StringView name) {
-  return (*this)(value, name); // load as string
-}
+bool KVBinaryInputStreamSerializer::readString(Common::StringView name, const char*& data, size_t& size) {
+  uint8_t type;
+  size_t offset;
+  if (!findValue(name, type, offset)) {
+    return false;
+  }
 
+  if (type != BIN_KV_SERIALIZE_TYPE_STRING) {
+    throw std::runtime_error("String expected");
+  }
+
+  size = readVarint(offset);
+  data = reinterpret_cast<const char*>(m_data + offset);
+  return true;
+}
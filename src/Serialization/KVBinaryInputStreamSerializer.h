@@ -6,18 +6,86 @@
 
 #pragma once
 
+#include <string>
+#include <vector>
+
 #include <Common/IInputStream.h>
 #include "ISerializer.h"
-#include "JsonInputValueSerializer.h"
 
 namespace CryptoNote {
 
-class KVBinaryInputStreamSerializer : public JsonInputValueSerializer {
+// Reads values straight out of the serialized buffer. Entering an object
+// indexes its entries (name, type and position) without decoding them, so
+// fields may come in any order and unknown ones are skipped. Strings and
+// blobs are copied once, from the buffer into the target.
+class KVBinaryInputStreamSerializer : public ISerializer {
 public:
+  // The buffer must outlive the serializer.
+  KVBinaryInputStreamSerializer(const void* data, size_t size);
+  // Reads the stream to its end first.
   KVBinaryInputStreamSerializer(Common::IInputStream& strm);
 
+  virtual SerializerType type() const override;
+
+  virtual bool beginObject(Common::StringView name) override;
+  virtual void endObject() override;
+
+  virtual bool beginArray(size_t& size, Common::StringView name) override;
+  virtual void endArray() override;
+
+  virtual bool operator()(uint8_t& value, Common::StringView name) override;
+  virtual bool operator()(int16_t& value, Common::StringView name) override;
+  virtual bool operator()(uint16_t& value, Common::StringView name) override;
+  virtual bool operator()(int32_t& value, Common::StringView name) override;
+  virtual bool operator()(uint32_t& value, Common::StringView name) override;
+  virtual bool operator()(int64_t& value, Common::StringView name) override;
+  virtual bool operator()(uint64_t& value, Common::StringView name) override;
+  virtual bool operator()(double& value, Common::StringView name) override;
+  virtual bool operator()(bool& value, Common::StringView name) override;
+  virtual bool operator()(std::string& value, Common::StringView name) override;
   virtual bool binary(void* value, size_t size, Common::StringView name) override;
   virtual bool binary(std::string& value, Common::StringView name) override;
+
+  template<typename T>
+  bool operator()(T& value, Common::StringView name) {
+    return ISerializer::operator()(value, name);
+  }
+
+private:
+  struct Entry {
+    Common::StringView name;
+    uint8_t type;
+    size_t offset; // of the value, past the type byte
+  };
+
+  struct Level {
+    bool isArray;
+    uint8_t itemType;   // arrays only
+    size_t position;    // arrays: offset of the next item
+    size_t firstEntry;  // objects: index of the first entry in m_entries
+    size_t entryCount;
+    size_t cursor;      // objects: entry after the last one read, fields usually come in order
+  };
+
+  void parseHeader();
+  void enterObject(size_t offset);
+  bool findValue(Common::StringView name, uint8_t& type, size_t& offset);
+  size_t skipValue(size_t offset, uint8_t type, size_t depth) const;
+  size_t readVarint(size_t& offset) const;
+  void require(size_t offset, size_t size) const;
+
+  template <typename T>
+  T readPod(size_t offset) const;
+
+  template <typename T>
+  bool readNumber(Common::StringView name, T& value);
+  bool readString(Common::StringView name, const char*& data, size_t& size);
+
+  std::string m_buffer; // owned copy when reading from a stream
+  const uint8_t* m_data;
+  size_t m_size;
+  std::vector<Entry> m_entries;
+  std::vector<Level> m_levels;
 };
 
 }
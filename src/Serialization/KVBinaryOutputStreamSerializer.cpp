@@ -8,6 +8,7 @@
 #include "KVBinaryCommon.h"
 
 #include <cassert>
+#include <limits>
 #include <stdexcept>
 #include <Common/StreamTools.h>
 
@@ -59,11 +60,11 @@ size_t writeArraySize(IOutputStream& s, size_t val) {
 namespace CryptoNote {
 
 KVBinaryOutputStreamSerializer::KVBinaryOutputStreamSerializer() {
-  beginObject(std::string());
+  // the root entry count is written by dump
+  m_stack.push_back(Level(std::string(), State::Object, 0, 0));
 }
 
 void KVBinaryOutputStreamSerializer::dump(IOutputStream& target) {
-  assert(m_objectsStack.size() == 1);
   assert(m_stack.size() == 1);
 
   KVBinaryStorageBlockHeader hdr;
@@ -81,33 +82,32 @@ ISerializer::SerializerType KVBinaryOutputStreamSerializer::type() const {
 }
 
 bool KVBinaryOutputStreamSerializer::beginObject(Common::StringView name) {
-  checkArrayPreamble(BIN_KV_SERIALIZE_TYPE_OBJECT);
- 
-  m_stack.push_back(Level(name));
-  m_objectsStack.push_back(MemoryStream());
+  writeElementPrefix(BIN_KV_SERIALIZE_TYPE_OBJECT, name);
+
+  // a dword varint fits any count, so the entries can follow before the count is known
+  size_t countOffset = stream().size();
+  packVarint<uint32_t>(stream(), PORTABLE_RAW_SIZE_MARK_DWORD, 0);
+  m_stack.push_back(Level(name, State::Object, 0, countOffset));
 
   return true;
 }
 
 void KVBinaryOutputStreamSerializer::endObject() {
-  assert(m_objectsStack.size());
+  assert(m_stack.size() > 1);
 
   auto level = std::move(m_stack.back());
   m_stack.pop_back();
 
-  auto objStream = std::move(m_objectsStack.back());
-  m_objectsStack.pop_back();
-
-  auto& out = stream();
-
-  writeElementPrefix(BIN_KV_SERIALIZE_TYPE_OBJECT, level.name);
+  if (level.count > 1073741823) {
+    throw std::runtime_error("Too many entries in an object");
+  }
 
-  writeArraySize(out, level.count);
-  write(out, objStream.data(), objStream.size());
+  uint32_t count = static_cast<uint32_t>(level.count << 2) | PORTABLE_RAW_SIZE_MARK_DWORD;
+  stream().overwrite(level.countOffset, &count, sizeof(count));
 }
 
 bool KVBinaryOutputStreamSerializer::beginArray(size_t& size, Common::StringView name) {
-  m_stack.push_back(Level(name, size));
+  m_stack.push_back(Level(name, State::ArrayPrefix, size, 0));
   return true;
 }
 
@@ -232,8 +232,7 @@ void KVBinaryOutputStreamSerializer::checkArrayPreamble(uint8_t type) {
 
 
 MemoryStream& KVBinaryOutputStreamSerializer::stream() {
-  assert(m_objectsStack.size());
-  return m_objectsStack.back();
+  return m_stream;
 }
 
 }
@@ -65,22 +65,22 @@ private:
     State state;
     std::string name;
     size_t count;
+    size_t countOffset; // objects: where the entry count goes once it is known
 
-    Level(Common::StringView nm) :
-      name(nm), state(State::Object), count(0) {}
-
-    Level(Common::StringView nm, size_t arraySize) :
-      name(nm), state(State::ArrayPrefix), count(arraySize) {}
+    Level(Common::StringView nm, State st, size_t cnt, size_t offset) :
+      state(st), name(nm), count(cnt), countOffset(offset) {}
 
     Level(Level&& rv) {
       state = rv.state;
       name = std::move(rv.name);
       count = rv.count;
+      countOffset = rv.countOffset;
     }
 
   };
 
-  std::vector<MemoryStream> m_objectsStack;
+  // objects are written in place, their entry count is patched in on endObject
+  MemoryStream m_stream;
   std::vector<Level> m_stack;
 };
 
@@ -7,6 +7,7 @@
 #pragma once
 
 #include <algorithm>
+#include <cassert>
 #include <cstdint>
 #include <cstring> // memcpy
 #include <vector>
@@ -34,6 +35,12 @@ public:
     return size;
   }
 
+  // Replaces bytes written before, e.g. a size that was not known yet.
+  void overwrite(size_t offset, const void* data, size_t size) {
+    assert(offset + size <= m_writePos);
+    memcpy(&m_buffer[offset], data, size);
+  }
+
   size_t size() {
     return m_buffer.size();
   }
@@ -11,7 +11,9 @@
 #include <Common/MemoryInputStream.h>
 #include <Common/StringOutputStream.h>
 #include "JsonInputStreamSerializer.h"
+#include "JsonInputTextSerializer.h"
 #include "JsonOutputStreamSerializer.h"
+#include "JsonOutputTextSerializer.h"
 #include "KVBinaryInputStreamSerializer.h"
 #include "KVBinaryOutputStreamSerializer.h"
 
@@ -80,7 +82,10 @@ void loadFromJsonValue(std::list<T>& v, const Common::JsonValue& js) {
 
 template <typename T>
 std::string storeToJson(const T& v) {
-  return storeToJsonValue(v).toString();
+  std::string json;
+  JsonOutputTextSerializer s(json);
+  s(const_cast<T&>(v), "");
+  return json;
 }
 
 template <typename T>
@@ -89,8 +94,8 @@ bool loadFromJson(T& v, const std::string& buf) {
     if (buf.empty()) {
       return true;
     }
-    auto js = Common::JsonValue::fromString(buf);
-    loadFromJsonValue(v, js);
+    JsonInputTextSerializer s(buf);
+    serialize(v, s);
   } catch (std::exception&) {
     return false;
   }
@@ -111,8 +116,7 @@ std::string storeToBinaryKeyValue(const T& v) {
 template <typename T>
 bool loadFromBinaryKeyValue(T& v, const std::string& buf) {
   try {
-    Common::MemoryInputStream stream(buf.data(), buf.size());
-    KVBinaryInputStreamSerializer s(stream);
+    KVBinaryInputStreamSerializer s(buf.data(), buf.size());
     serialize(v, s);
     return true;
   } catch (std::exception&) {
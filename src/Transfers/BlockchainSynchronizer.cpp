@@ -383,10 +383,12 @@ void BlockchainSynchronizer::processBlocks(GetBlocksResponse& response) {
     if (block.hasBlock) {
       completeBlock.block = std::move(block.block);
       completeBlock.transactions.push_back(createTransactionPrefix(completeBlock.block->baseTransaction));
+      completeBlock.globalIndexes.push_back(std::move(block.baseTransactionGlobalIndexes));
 
       try {
-        for (const auto& txShortInfo : block.txsShortInfo) {
+        for (auto& txShortInfo : block.txsShortInfo) {
           completeBlock.transactions.push_back(createTransactionPrefix(txShortInfo.txPrefix, reinterpret_cast<const Hash&>(txShortInfo.txId)));
+          completeBlock.globalIndexes.push_back(std::move(txShortInfo.globalIndexes));
         }
       } catch (std::exception&) {
         setFutureStateIf(State::idle, [this] { return m_futureState != State::stopped; });
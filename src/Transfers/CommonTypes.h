@@ -27,6 +27,8 @@ struct CompleteBlock {
   boost::optional<CryptoNote::Block> block;
   // first transaction is always coinbase
   std::list<std::shared_ptr<ITransactionReader>> transactions;
+  // output global indexes of the transactions in the same order, empty if unknown
+  std::vector<std::vector<uint32_t>> globalIndexes;
 };
 
 }
@@ -193,6 +193,7 @@ bool TransfersConsumer::onNewBlocks(const CompleteBlock* blocks, uint32_t startH
   struct Tx {
     TransactionBlockInfo blockInfo;
     const ITransactionReader* tx;
+    const std::vector<uint32_t>* globalIndexes;
   };
 
   struct PreprocessedTx : Tx, PreprocessInfo {};
@@ -234,7 +235,8 @@ bool TransfersConsumer::onNewBlocks(const CompleteBlock* blocks, uint32_t startH
           continue;
         }
 
-        Tx item = { blockInfo, tx.get() };
+        const auto& globalIndexes = blocks[i].globalIndexes;
+        Tx item = { blockInfo, tx.get(), blockInfo.transactionIndex < globalIndexes.size() ? &globalIndexes[blockInfo.transactionIndex] : nullptr };
         inputQueue.push(item);
         ++blockInfo.transactionIndex;
       }
@@ -250,7 +252,7 @@ bool TransfersConsumer::onNewBlocks(const CompleteBlock* blocks, uint32_t startH
       PreprocessedTx output;
       static_cast<Tx&>(output) = item;
 
-      ec = preprocessOutputs(item.blockInfo, *item.tx, output);
+      ec = preprocessOutputs(item.blockInfo, *item.tx, item.globalIndexes, output);
       if (ec) {
         stopProcessing = true;
         break;
@@ -468,7 +470,8 @@ std::error_code createTransfers(
   return std::error_code();
 }
 
-std::error_code TransfersConsumer::preprocessOutputs(const TransactionBlockInfo& blockInfo, const ITransactionReader& tx, PreprocessInfo& info) {
+std::error_code TransfersConsumer::preprocessOutputs(const TransactionBlockInfo& blockInfo, const ITransactionReader& tx,
+  const std::vector<uint32_t>* globalIndexes, PreprocessInfo& info) {
   std::unordered_map<PublicKey, std::vector<uint32_t>> outputs;
    try {
     findMyOutputs(tx, m_viewSecret, m_spendKeys, outputs);
@@ -485,9 +488,14 @@ std::error_code TransfersConsumer::preprocessOutputs(const TransactionBlockInfo&
   std::error_code errorCode;
   auto txHash = tx.getTransactionHash();
   if (blockInfo.height != WALLET_UNCONFIRMED_TRANSACTION_HEIGHT) {
-    errorCode = getGlobalIndices(reinterpret_cast<const Hash&>(txHash), info.globalIdxs);
-    if (errorCode) {
-      return errorCode;
+    if (globalIndexes != nullptr && globalIndexes->size() == tx.getOutputCount()) {
+      info.globalIdxs = *globalIndexes;
+    } else {
+      // the node did not send the indexes along with the block
+      errorCode = getGlobalIndices(reinterpret_cast<const Hash&>(txHash), info.globalIdxs);
+      if (errorCode) {
+        return errorCode;
+      }
     }
   }
 
@@ -514,7 +522,7 @@ std::error_code TransfersConsumer::preprocessOutputs(const TransactionBlockInfo&
 
 std::error_code TransfersConsumer::processTransaction(const TransactionBlockInfo& blockInfo, const ITransactionReader& tx) {
   PreprocessInfo info;
-  auto ec = preprocessOutputs(blockInfo, tx, info);
+  auto ec = preprocessOutputs(blockInfo, tx, nullptr, info);
   if (ec) {
     return ec;
   }
@@ -118,4 +118,5 @@ void sc_mulsub(unsigned char *, const unsigned char *, const unsigned char *, co
 int sc_check(const unsigned char *);
 int sc_isnonzero(const unsigned char *); /* Doesn't normalize */
 
-int ge_check_subgroup_precomp_vartime(const ge_dsmp);
\ No newline at end of file
+int ge_check_subgroup_precomp_vartime(const ge_dsmp);
+void ge_tobytes_batch(unsigned char *, const ge_p2 *, fe *, size_t);
\ No newline at end of file
@@ -12,6 +12,8 @@
 #include <cstring>
 #include <memory>
 #include <mutex>
+#include <unordered_map>
+#include <vector>
 
 #include "Common/Varint.h"
 #include "crypto.h"
@@ -590,4 +592,91 @@ void crypto_ops::generate_tx_proof(const Hash &prefix_hash, const PublicKey &R,
     sc_sub(reinterpret_cast<unsigned char*>(&h), reinterpret_cast<unsigned char*>(&h), reinterpret_cast<unsigned char*>(&sum));
     return sc_isnonzero(reinterpret_cast<unsigned char*>(&h)) == 0;
   }
+
+  void crypto_ops::check_ring_signatures(const RingSignatureBatchItem *items, size_t count, bool *results) {
+    struct RingPoint {
+      bool valid;
+      ge_p3 point;
+      ge_p3 hashed;
+    };
+
+    // decompressed ring members and their hashes to the curve, shared by all items
+    std::unordered_map<PublicKey, RingPoint> ringPoints;
+    std::vector<ge_p2> commitments;
+    std::vector<size_t> firstCommitment(count);
+    for (size_t k = 0; k < count; ++k) {
+      const RingSignatureBatchItem &item = items[k];
+      ge_p3 image_unp;
+      ge_dsmp image_pre;
+      results[k] = false;
+      firstCommitment[k] = commitments.size();
+      if (ge_frombytes_vartime(&image_unp, reinterpret_cast<const unsigned char*>(item.image)) != 0) {
+        continue;
+      }
+      ge_dsm_precomp(image_pre, &image_unp);
+      if (ge_check_subgroup_precomp_vartime(image_pre) != 0) {
+        continue;
+      }
+
+      size_t i;
+      for (i = 0; i < item.pubs_count; i++) {
+        const unsigned char *c = reinterpret_cast<const unsigned char*>(&item.sig[i]);
+        const unsigned char *r = c + 32;
+        if (sc_check(c) != 0 || sc_check(r) != 0) {
+          break;
+        }
+
+        auto inserted = ringPoints.emplace(*item.pubs[i], RingPoint());
+        RingPoint &ringPoint = inserted.first->second;
+        if (inserted.second) {
+          ringPoint.valid = ge_frombytes_vartime(&ringPoint.point, reinterpret_cast<const unsigned char*>(item.pubs[i])) == 0;
+          if (ringPoint.valid) {
+            hash_to_ec(*item.pubs[i], ringPoint.hashed);
+          }
+        }
+        if (!ringPoint.valid) {
+          break;
+        }
+
+        ge_p2 a, b;
+        ge_double_scalarmult_base_vartime(&a, c, &ringPoint.point, r);
+        ge_double_scalarmult_precomp_vartime(&b, r, &ringPoint.hashed, c, image_pre);
+        commitments.push_back(a);
+        commitments.push_back(b);
+      }
+
+      if (i != item.pubs_count) {
+        commitments.resize(firstCommitment[k]);
+        continue;
+      }
+
+      results[k] = true;
+    }
+
+    std::vector<EllipticCurvePoint> encoded(commitments.size());
+    std::vector<fe> scratch(commitments.size());
+    ge_tobytes_batch(reinterpret_cast<unsigned char*>(encoded.data()), commitments.data(), scratch.data(), commitments.size());
+
+    std::vector<uint8_t> bufData;
+    for (size_t k = 0; k < count; ++k) {
+      if (!results[k]) {
+        continue;
+      }
+
+      const RingSignatureBatchItem &item = items[k];
+      EllipticCurveScalar sum, h;
+      bufData.resize(rs_comm_size(item.pubs_count));
+      rs_comm *const buf = reinterpret_cast<rs_comm *>(bufData.data());
+      sc_0(reinterpret_cast<unsigned char*>(&sum));
+      buf->h = *item.prefix_hash;
+      for (size_t i = 0; i < item.pubs_count; i++) {
+        buf->ab[i].a = encoded[firstCommitment[k] + 2 * i];
+        buf->ab[i].b = encoded[firstCommitment[k] + 2 * i + 1];
+        sc_add(reinterpret_cast<unsigned char*>(&sum), reinterpret_cast<unsigned char*>(&sum), reinterpret_cast<const unsigned char*>(&item.sig[i]));
+      }
+      hash_to_scalar(buf, rs_comm_size(item.pubs_count), h);
+      sc_sub(reinterpret_cast<unsigned char*>(&h), reinterpret_cast<unsigned char*>(&h), reinterpret_cast<unsigned char*>(&sum));
+      results[k] = sc_isnonzero(reinterpret_cast<unsigned char*>(&h)) == 0;
+    }
+  }
 }
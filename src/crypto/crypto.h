@@ -33,6 +33,15 @@ struct EllipticCurveScalar {
   uint8_t data[32];
 };
 
+// One ring signature of a batch passed to check_ring_signatures.
+struct RingSignatureBatchItem {
+  const Hash *prefix_hash;
+  const KeyImage *image;
+  const PublicKey *const *pubs;
+  size_t pubs_count;
+  const Signature *sig;
+};
+
   class crypto_ops {
     crypto_ops();
     crypto_ops(const crypto_ops &);
@@ -92,6 +101,9 @@ struct EllipticCurveScalar {
 
     friend bool check_ring_signature(const Hash &, const KeyImage &,
       const PublicKey *const *, size_t, const Signature *);
+
+    static void check_ring_signatures(const RingSignatureBatchItem *, size_t, bool *);
+    friend void check_ring_signatures(const RingSignatureBatchItem *, size_t, bool *);
   };
 
   /* Generate a value filled with random bytes.
@@ -255,6 +267,16 @@ struct EllipticCurveScalar {
     return crypto_ops::check_ring_signature(prefix_hash, image, pubs, pubs_count, sig);
   }
 
+  /* Checks several ring signatures at once, e.g. all inputs of a block. Ring
+   * members shared between the signatures are decompressed and hashed to the
+   * curve once, and the commitments of all rings are encoded with a single
+   * field inversion. results[i] is set to what check_ring_signature would
+   * return for items[i].
+   */
+  inline void check_ring_signatures(const RingSignatureBatchItem *items, size_t count, bool *results) {
+    crypto_ops::check_ring_signatures(items, count, results);
+  }
+
   /* Variants with vector<const PublicKey *> parameters.
    */
   inline void generate_ring_signature(const Hash &prefix_hash, const KeyImage &image,
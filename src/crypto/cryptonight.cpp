@@ -3,6 +3,8 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <assert.h>
+
 #include "cryptonight.hpp"
 
 namespace Crypto
@@ -40,4 +42,48 @@ void cn_cache_slow_hash_v0(cn_context &context, const void *data, size_t length,
     cryptonight_hash<true, CRYPTONIGHT_CACHE_HASH>(data, length, reinterpret_cast<char *>(&hash), context);
 }
 
+template<bool SOFT_AES, cryptonight_algo ALGO>
+void cryptonight_hash_lanes(cn_context &context, const void *const *data, const size_t *length, Hash *hashes, size_t count)
+{
+  void* outputs[CN_MAX_LANES];
+  for(size_t i = 0; i < count; i++)
+    outputs[i] = &hashes[i];
+
+  switch(count)
+  {
+  case 1:
+    cryptonight_hash<SOFT_AES, ALGO>(data[0], length[0], outputs[0], context);
+    break;
+  case 2:
+    cryptonight_hash_multi<SOFT_AES, ALGO, 2>(data, length, outputs, context);
+    break;
+  case 3:
+    cryptonight_hash_multi<SOFT_AES, ALGO, 3>(data, length, outputs, context);
+    break;
+  case 4:
+    cryptonight_hash_multi<SOFT_AES, ALGO, 4>(data, length, outputs, context);
+    break;
+  default:
+    break;
+  }
+}
+
+void cn_slow_hash_multi(cn_context &context, const void *const *data, const size_t *length, Hash *hashes, size_t count)
+{
+  assert(count <= context.lanes() && count <= CN_MAX_LANES);
+  if(hw_check_aes())
+    cryptonight_hash_lanes<false, CRYPTONIGHT>(context, data, length, hashes, count);
+  else
+    cryptonight_hash_lanes<true, CRYPTONIGHT>(context, data, length, hashes, count);
+}
+
+void cn_cache_slow_hash_v0_multi(cn_context &context, const void *const *data, const size_t *length, Hash *hashes, size_t count)
+{
+  assert(count <= context.lanes() && count <= CN_MAX_LANES);
+  if(hw_check_aes())
+    cryptonight_hash_lanes<false, CRYPTONIGHT_CACHE_HASH>(context, data, length, hashes, count);
+  else
+    cryptonight_hash_lanes<true, CRYPTONIGHT_CACHE_HASH>(context, data, length, hashes, count);
+}
+
 }
\ No newline at end of file
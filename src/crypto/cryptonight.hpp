@@ -350,4 +350,146 @@ void cryptonight_hash(const void* input, size_t len, void* output, cn_context& c
 	}
 }
 
+// The per-lane steps must be unrolled for the lanes to overlap.
+#if defined(__clang__)
+#define CN_UNROLL_LANES _Pragma("unroll")
+#elif defined(__GNUC__)
+#define CN_UNROLL_LANES _Pragma("GCC unroll 4")
+#else
+#define CN_UNROLL_LANES
+#endif
+
+// Computes N hashes at once, lane n using scratchpad n of the context. The
+// main loops of the lanes are interleaved so the scratchpad accesses of one
+// lane overlap with the computation of the others.
+template<bool SOFT_AES, cryptonight_algo ALGO, size_t N>
+void cryptonight_hash_multi(const void* const* input, const size_t* len, void* const* output, cn_context& ctx)
+{
+	constexpr size_t MEMORY = cn_select_memory<ALGO>();
+	constexpr uint32_t MASK = cn_select_mask<ALGO>();
+	constexpr uint32_t ITER = cn_select_iter<ALGO>();
+	constexpr bool MONERO_TWEAK = ALGO == CRYPTONIGHT_FAST_V8;
+	constexpr bool CONC_VARIANT = ALGO == CRYPTONIGHT_CONCEAL;
+	constexpr bool CACHE_VARIANT = ALGO == CRYPTONIGHT_CACHE_HASH;
+
+	uint8_t* l[N];
+	uint8_t* hs[N];
+	uint64_t al[N], ah[N], idx[N], mc[N];
+	__m128i bx[N], cx[N];
+	__m128 conc_var[N];
+
+	for(size_t n = 0; n < N; n++)
+	{
+		if(MONERO_TWEAK && len[n] < 43)
+		{
+			for(size_t k = 0; k < N; k++)
+				cryptonight_hash<SOFT_AES, ALGO>(input[k], len[k], output[k], ctx);
+			return;
+		}
+
+		l[n] = ctx.lane_long_state(n);
+		hs[n] = ctx.lane_hash_state(n);
+		keccak((const uint8_t *)input[n], static_cast<uint8_t>(len[n]), hs[n], 200);
+
+		if(MONERO_TWEAK)
+		{
+			mc[n]  =  *reinterpret_cast<const uint64_t*>(reinterpret_cast<const uint8_t*>(input[n]) + 35);
+			mc[n] ^=  *(reinterpret_cast<const uint64_t*>(hs[n]) + 24);
+		}
+
+		cn_explode_scratchpad<SOFT_AES, MEMORY,ALGO>((__m128i*)hs[n], (__m128i*)l[n]);
+
+		uint64_t* h = (uint64_t*)hs[n];
+		al[n] = h[0] ^ h[4];
+		ah[n] = h[1] ^ h[5];
+		bx[n] = _mm_set_epi64x(h[3] ^ h[7], h[2] ^ h[6]);
+		conc_var[n] = _mm_setzero_ps();
+		idx[n] = h[0] ^ h[4];
+	}
+
+	for(size_t i = 0; i < ITER; i++)
+	{
+		CN_UNROLL_LANES
+		for(size_t n = 0; n < N; n++)
+		{
+			cx[n] = _mm_load_si128((__m128i *)&l[n][idx[n] & MASK]);
+
+			if(CONC_VARIANT || CACHE_VARIANT)
+			{
+				__m128 r = _mm_cvtepi32_ps(cx[n]);
+				__m128 c_old = conc_var[n];
+				r = _mm_add_ps(r, conc_var[n]);
+				r = _mm_mul_ps(r, _mm_mul_ps(r, r));
+				r = _mm_and_ps(_mm_set1_ps_epi32(0x807FFFFF), r);
+				r = _mm_or_ps(_mm_set1_ps_epi32(0x40000000), r);
+				conc_var[n] = _mm_add_ps(conc_var[n], r);
+
+				c_old = _mm_and_ps(_mm_set1_ps_epi32(0x807FFFFF), c_old);
+				c_old = _mm_or_ps(_mm_set1_ps_epi32(0x40000000), c_old);
+				__m128 nc = _mm_mul_ps(c_old, _mm_set1_ps(536870880.0f));
+				cx[n] = _mm_xor_si128(cx[n], _mm_cvttps_epi32(nc));
+			}
+
+			if(SOFT_AES)
+				cx[n] = soft_aesenc(cx[n], _mm_set_epi64x(ah[n], al[n]));
+			else
+				cx[n] = _mm_aesenc_si128(cx[n], _mm_set_epi64x(ah[n], al[n]));
+
+			if(MONERO_TWEAK)
+				cryptonight_monero_tweak((uint64_t*)&l[n][idx[n] & MASK], _mm_xor_si128(bx[n], cx[n]));
+			else
+				_mm_store_si128((__m128i *)&l[n][idx[n] & MASK], _mm_xor_si128(bx[n], cx[n]));
+
+			idx[n] = _mm_cvtsi128_si64(cx[n]);
+			bx[n] = cx[n];
+		}
+
+		CN_UNROLL_LANES
+		for(size_t n = 0; n < N; n++)
+		{
+			uint64_t hi, lo, cl, ch;
+			cl = ((uint64_t*)&l[n][idx[n] & MASK])[0];
+			ch = ((uint64_t*)&l[n][idx[n] & MASK])[1];
+
+			lo = _umul128(idx[n], cl, &hi);
+			al[n] += hi;
+			ah[n] += lo;
+
+			((uint64_t*)&l[n][idx[n] & MASK])[0] = al[n];
+
+			if(MONERO_TWEAK)
+				((uint64_t*)&l[n][idx[n] & MASK])[1] = ah[n] ^ mc[n];
+			else
+				((uint64_t*)&l[n][idx[n] & MASK])[1] = ah[n];
+
+			ah[n] ^= ch;
+			al[n] ^= cl;
+			idx[n] = al[n];
+		}
+	}
+
+	for(size_t n = 0; n < N; n++)
+	{
+		cn_implode_scratchpad<SOFT_AES, MEMORY,ALGO>((__m128i*)l[n], (__m128i*)hs[n]);
+
+		keccakf((uint64_t*)hs[n], 24);
+
+		switch(hs[n][0] & 3)
+		{
+		case 0:
+			blake256_hash(hs[n], (uint8_t*)output[n]);
+			break;
+		case 1:
+			groestl_hash(hs[n], (uint8_t*)output[n]);
+			break;
+		case 2:
+			jh_hash(hs[n], (uint8_t*)output[n]);
+			break;
+		case 3:
+			skein_hash(hs[n], (uint8_t*)output[n]);
+			break;
+		}
+	}
+}
+
 }
\ No newline at end of file
@@ -22,6 +22,14 @@
 #define CN_FAST_SCRATCHPAD              2097152
 #define CN_FAST_ITERATIONS              524288
 
+/* Hashes computed at once by the multi-lane functions. Every lane needs its
+ * own scratchpad, so the miners and the proof of work checks while syncing
+ * default to one lane; the miners can be given more at run time. */
+#define CN_MAX_LANES                    4
+#ifndef CN_MINER_LANES
+#define CN_MINER_LANES                  1
+#endif
+
 namespace Crypto {
 
   extern "C" {
@@ -45,10 +53,12 @@ namespace Crypto {
   class cn_context {
   public:
 
-    cn_context()
+    // A context with several lanes can compute that many hashes at once,
+    // each lane has its own scratchpad.
+    explicit cn_context(size_t lanes = 1) : lane_count(lanes)
     {
-        long_state = (uint8_t*)boost::alignment::aligned_alloc(4096, CN_PAGE_SIZE);
-        hash_state = (uint8_t*)boost::alignment::aligned_alloc(4096, 4096);
+        long_state = (uint8_t*)boost::alignment::aligned_alloc(4096, CN_PAGE_SIZE * lanes);
+        hash_state = (uint8_t*)boost::alignment::aligned_alloc(4096, 4096 * lanes);
     }
 
     ~cn_context()
@@ -62,8 +72,15 @@ namespace Crypto {
     cn_context(const cn_context &) = delete;
     void operator=(const cn_context &) = delete;
 
+    size_t lanes() const { return lane_count; }
+    uint8_t* lane_long_state(size_t lane) { return long_state + CN_PAGE_SIZE * lane; }
+    uint8_t* lane_hash_state(size_t lane) { return hash_state + 4096 * lane; }
+
      uint8_t* long_state = nullptr;
      uint8_t* hash_state = nullptr;
+
+  private:
+    size_t lane_count;
   };
 
   void cn_slow_hash(cn_context &context, const void *data, size_t length, Hash &hash);
@@ -71,6 +88,10 @@ namespace Crypto {
   void cn_conceal_slow_hash_v0(cn_context &context, const void *data, size_t length, Hash &hash);
   void cn_cache_slow_hash_v0(cn_context &context, const void *data, size_t length, Hash &hash); 
 
+  /* Compute count hashes at once, count may not exceed the lanes of the context. */
+  void cn_slow_hash_multi(cn_context &context, const void *const *data, const size_t *length, Hash *hashes, size_t count);
+  void cn_cache_slow_hash_v0_multi(cn_context &context, const void *const *data, const size_t *length, Hash *hashes, size_t count);
+
   inline void tree_hash(const Hash *hashes, size_t count, Hash &root_hash) {
     tree_hash(reinterpret_cast<const char (*)[HASH_SIZE]>(hashes), count, reinterpret_cast<char *>(&root_hash));
   }
@@ -0,0 +1,265 @@
+// Copyright (c) 2011-2017 The Cryptonote developers
+// Copyright (c) 2017-2018 The Circle Foundation & Conceal Devs
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "CryptoNoteProtocol/BlockSyncScheduler.h"
+
+#include <thread>
+
+#include <gtest/gtest.h>
+
+using namespace CryptoNote;
+
+namespace {
+
+typedef BlockSyncScheduler<int> Scheduler;
+
+const size_t SPAN_SIZE = 2;
+const Scheduler::Clock::duration SPAN_TIMEOUT = std::chrono::seconds(60);
+
+Crypto::Hash makeId(uint8_t number) {
+  Crypto::Hash id = {};
+  id.data[0] = number;
+  return id;
+}
+
+Scheduler::PeerId makePeer(uint8_t number) {
+  Scheduler::PeerId peer = {};
+  peer.data[0] = number;
+  return peer;
+}
+
+// ids 0..lastNumber, block 0 is the one the node already has
+std::vector<Crypto::Hash> makeChain(uint8_t lastNumber) {
+  std::vector<Crypto::Hash> chain;
+  for (uint8_t number = 0; number <= lastNumber; ++number) {
+    chain.push_back(makeId(number));
+  }
+
+  return chain;
+}
+
+std::vector<Crypto::Hash> makeIds(std::initializer_list<uint8_t> numbers) {
+  std::vector<Crypto::Hash> ids;
+  for (uint8_t number : numbers) {
+    ids.push_back(makeId(number));
+  }
+
+  return ids;
+}
+
+std::vector<int> makeBlocks(const std::vector<Crypto::Hash>& ids) {
+  std::vector<int> blocks;
+  for (const Crypto::Hash& id : ids) {
+    blocks.push_back(id.data[0]);
+  }
+
+  return blocks;
+}
+
+class BlockSyncSchedulerTest : public ::testing::Test {
+public:
+  BlockSyncSchedulerTest() : scheduler(SPAN_SIZE, SPAN_TIMEOUT), peerA(makePeer(1)), peerB(makePeer(2)) {
+  }
+
+  void addChain(const Scheduler::PeerId& peer, uint8_t lastNumber) {
+    Crypto::Hash knownId = makeId(0);
+    scheduler.addBlocks(peer, makeChain(lastNumber), [&knownId](const Crypto::Hash& id) { return id == knownId; });
+  }
+
+  bool deliver(const Scheduler::PeerId& peer, const std::vector<Crypto::Hash>& ids) {
+    return scheduler.deliver(peer, ids, makeBlocks(ids));
+  }
+
+  Scheduler scheduler;
+  Scheduler::PeerId peerA;
+  Scheduler::PeerId peerB;
+};
+
+}
+
+TEST_F(BlockSyncSchedulerTest, assignsSpansInChainOrder) {
+  addChain(peerA, 4);
+
+  std::vector<Crypto::Hash> ids;
+  ASSERT_TRUE(scheduler.assign(peerA, ids));
+  ASSERT_EQ(makeIds({1, 2}), ids);
+  ASSERT_TRUE(scheduler.assign(peerA, ids));
+  ASSERT_EQ(makeIds({3, 4}), ids);
+  ASSERT_FALSE(scheduler.assign(peerA, ids));
+}
+
+TEST_F(BlockSyncSchedulerTest, skipsKnownAndAlreadyScheduledBlocks) {
+  addChain(peerA, 4);
+  addChain(peerA, 4);
+
+  std::vector<Crypto::Hash> ids;
+  ASSERT_TRUE(scheduler.assign(peerA, ids));
+  ASSERT_TRUE(scheduler.assign(peerA, ids));
+  ASSERT_FALSE(scheduler.assign(peerA, ids));
+}
+
+TEST_F(BlockSyncSchedulerTest, popReadyWaitsForPrecedingSpan) {
+  addChain(peerA, 4);
+  addChain(peerB, 4);
+
+  std::vector<Crypto::Hash> first;
+  std::vector<Crypto::Hash> second;
+  ASSERT_TRUE(scheduler.assign(peerA, first));
+  ASSERT_TRUE(scheduler.assign(peerB, second));
+  ASSERT_TRUE(deliver(peerB, second));
+
+  std::vector<int> blocks;
+  std::vector<Crypto::Hash> ids;
+  Scheduler::PeerId peer;
+  ASSERT_FALSE(scheduler.popReady(blocks, ids, peer));
+
+  ASSERT_TRUE(deliver(peerA, first));
+  ASSERT_TRUE(scheduler.popReady(blocks, ids, peer));
+  ASSERT_EQ(first, ids);
+  ASSERT_EQ(std::vector<int>({1, 2}), blocks);
+  ASSERT_EQ(peerA, peer);
+
+  ASSERT_TRUE(scheduler.popReady(blocks, ids, peer));
+  ASSERT_EQ(second, ids);
+  ASSERT_EQ(peerB, peer);
+  ASSERT_TRUE(scheduler.empty());
+}
+
+TEST_F(BlockSyncSchedulerTest, deliverPutsBlocksInSpanOrder) {
+  addChain(peerA, 2);
+
+  std::vector<Crypto::Hash> ids;
+  ASSERT_TRUE(scheduler.assign(peerA, ids));
+  ASSERT_TRUE(deliver(peerA, makeIds({2, 1})));
+
+  std::vector<int> blocks;
+  Scheduler::PeerId peer;
+  ASSERT_TRUE(scheduler.popReady(blocks, ids, peer));
+  ASSERT_EQ(std::vector<int>({1, 2}), blocks);
+}
+
+TEST_F(BlockSyncSchedulerTest, wrongDeliveryMakesSpanAvailableAgain) {
+  addChain(peerA, 2);
+
+  std::vector<Crypto::Hash> ids;
+  ASSERT_TRUE(scheduler.assign(peerA, ids));
+  ASSERT_FALSE(deliver(peerA, makeIds({1, 3})));
+  ASSERT_FALSE(deliver(peerA, makeIds({1, 2})));
+
+  ASSERT_TRUE(scheduler.assign(peerA, ids));
+  ASSERT_EQ(makeIds({1, 2}), ids);
+  ASSERT_TRUE(deliver(peerA, ids));
+}
+
+TEST_F(BlockSyncSchedulerTest, assignsOnlySpansThePeerHas) {
+  addChain(peerA, 2);
+  addChain(peerB, 4);
+
+  std::vector<Crypto::Hash> ids;
+  ASSERT_TRUE(scheduler.assign(peerA, ids));
+  ASSERT_EQ(makeIds({1, 2}), ids);
+  ASSERT_FALSE(scheduler.assign(peerA, ids));
+
+  ASSERT_TRUE(scheduler.assign(peerB, ids));
+  ASSERT_EQ(makeIds({3, 4}), ids);
+  ASSERT_TRUE(scheduler.hasPendingBlocks(peerA));
+  ASSERT_FALSE(scheduler.hasPendingBlocks(makePeer(3)));
+}
+
+TEST_F(BlockSyncSchedulerTest, timedOutSpanGoesToAnotherPeer) {
+  Scheduler shortTimeout(SPAN_SIZE, std::chrono::milliseconds(1));
+  Crypto::Hash knownId = makeId(0);
+  auto isKnown = [&knownId](const Crypto::Hash& id) { return id == knownId; };
+  shortTimeout.addBlocks(peerA, makeChain(2), isKnown);
+  shortTimeout.addBlocks(peerB, makeChain(2), isKnown);
+
+  std::vector<Crypto::Hash> ids;
+  ASSERT_TRUE(shortTimeout.assign(peerA, ids));
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  ASSERT_TRUE(shortTimeout.assign(peerB, ids));
+  ASSERT_EQ(makeIds({1, 2}), ids);
+
+  ASSERT_TRUE(shortTimeout.deliver(peerB, ids, makeBlocks(ids)));
+  ASSERT_FALSE(shortTimeout.deliver(peerA, ids, makeBlocks(ids)));
+}
+
+TEST_F(BlockSyncSchedulerTest, spanInProgressIsNotAssignedTwice) {
+  addChain(peerA, 2);
+  addChain(peerB, 2);
+
+  std::vector<Crypto::Hash> ids;
+  ASSERT_TRUE(scheduler.assign(peerA, ids));
+  ASSERT_FALSE(scheduler.assign(peerB, ids));
+}
+
+TEST_F(BlockSyncSchedulerTest, releaseHandsSpansToOtherPeers) {
+  addChain(peerA, 2);
+  addChain(peerB, 2);
+
+  std::vector<Crypto::Hash> ids;
+  ASSERT_TRUE(scheduler.assign(peerA, ids));
+  scheduler.release(peerA);
+
+  ASSERT_TRUE(scheduler.assign(peerB, ids));
+  ASSERT_EQ(makeIds({1, 2}), ids);
+  ASSERT_FALSE(scheduler.deliver(peerA, ids, makeBlocks(ids)));
+}
+
+TEST_F(BlockSyncSchedulerTest, releaseDropsSpansNobodyElseHas) {
+  addChain(peerA, 4);
+
+  std::vector<Crypto::Hash> ids;
+  ASSERT_TRUE(scheduler.assign(peerA, ids));
+  scheduler.release(peerA);
+
+  ASSERT_TRUE(scheduler.empty());
+  ASSERT_FALSE(scheduler.hasPendingBlocks(peerA));
+}
+
+TEST_F(BlockSyncSchedulerTest, notAvailableStopsAssigningTheSpanToThePeer) {
+  addChain(peerA, 4);
+  addChain(peerB, 4);
+
+  scheduler.notAvailable(peerA, makeIds({3}));
+
+  std::vector<Crypto::Hash> ids;
+  ASSERT_TRUE(scheduler.assign(peerA, ids));
+  ASSERT_EQ(makeIds({1, 2}), ids);
+  ASSERT_FALSE(scheduler.assign(peerA, ids));
+
+  ASSERT_TRUE(scheduler.assign(peerB, ids));
+  ASSERT_EQ(makeIds({3, 4}), ids);
+}
+
+TEST_F(BlockSyncSchedulerTest, notAvailableDropsSpansAndTheirDescendants) {
+  addChain(peerA, 6);
+
+  scheduler.notAvailable(peerA, makeIds({3}));
+
+  std::vector<Crypto::Hash> ids;
+  ASSERT_TRUE(scheduler.assign(peerA, ids));
+  ASSERT_EQ(makeIds({1, 2}), ids);
+  ASSERT_FALSE(scheduler.assign(peerA, ids));
+}
+
+TEST_F(BlockSyncSchedulerTest, rejectDropsDescendantSpans) {
+  addChain(peerA, 6);
+
+  std::vector<std::vector<Crypto::Hash>> spans(3);
+  for (auto& span : spans) {
+    ASSERT_TRUE(scheduler.assign(peerA, span));
+    ASSERT_TRUE(deliver(peerA, span));
+  }
+
+  std::vector<int> blocks;
+  std::vector<Crypto::Hash> ids;
+  Scheduler::PeerId peer;
+  ASSERT_TRUE(scheduler.popReady(blocks, ids, peer));
+  scheduler.reject(ids);
+
+  ASSERT_TRUE(scheduler.empty());
+  ASSERT_FALSE(scheduler.popReady(blocks, ids, peer));
+}
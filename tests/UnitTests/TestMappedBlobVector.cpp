@@ -0,0 +1,197 @@
+// Copyright (c) 2011-2017 The Cryptonote developers
+// Copyright (c) 2017-2018 The Circle Foundation & Conceal Devs
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "CryptoNoteCore/MappedBlobVector.h"
+
+#include <boost/filesystem.hpp>
+#include <gtest/gtest.h>
+
+#include "Common/StringOutputStream.h"
+
+using namespace CryptoNote;
+
+namespace {
+
+const uint64_t ITEM_COUNT = 100;
+// smaller than the item count, so reads go through evictions
+const size_t POOL_SIZE = 16;
+
+struct Item {
+  uint64_t number;
+  std::string text;
+
+  bool operator==(const Item& other) const {
+    return number == other.number && text == other.text;
+  }
+};
+
+void serialize(Item& item, ISerializer& s) {
+  s(item.number, "number");
+  s(item.text, "text");
+}
+
+Item makeItem(uint64_t number) {
+  return Item{number, std::string(static_cast<size_t>(number % 7) * 10, static_cast<char>('a' + number % 26))};
+}
+
+std::string toBlob(const Item& item) {
+  std::string blob;
+  Common::StringOutputStream stream(blob);
+  BinaryOutputStreamSerializer s(stream);
+  serialize(const_cast<Item&>(item), s);
+  return blob;
+}
+
+class MappedBlobVectorTest : public ::testing::Test {
+public:
+  MappedBlobVectorTest() :
+    directory(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("mappedblobvector-%%%%-%%%%")),
+    itemsPath((directory / "items.dat").string()),
+    indexesPath((directory / "indexes.dat").string()) {
+    boost::filesystem::create_directories(directory);
+  }
+
+  ~MappedBlobVectorTest() {
+    boost::system::error_code ignore;
+    boost::filesystem::remove_all(directory, ignore);
+  }
+
+  void open(MappedBlobVector<Item>& items) {
+    ASSERT_TRUE(items.open(itemsPath, indexesPath, POOL_SIZE));
+  }
+
+  void fill(MappedBlobVector<Item>& items, uint64_t count) {
+    for (uint64_t i = 0; i < count; ++i) {
+      items.push_back(makeItem(i));
+    }
+  }
+
+  void expectItems(MappedBlobVector<Item>& items, uint64_t count) {
+    ASSERT_EQ(count, items.size());
+    for (uint64_t i = 0; i < count; ++i) {
+      ASSERT_EQ(makeItem(i), items[i]);
+    }
+  }
+
+  boost::filesystem::path directory;
+  std::string itemsPath;
+  std::string indexesPath;
+};
+
+}
+
+TEST_F(MappedBlobVectorTest, readsPushedItems) {
+  MappedBlobVector<Item> items;
+  open(items);
+  ASSERT_TRUE(items.empty());
+
+  fill(items, ITEM_COUNT);
+  expectItems(items, ITEM_COUNT);
+  ASSERT_EQ(makeItem(0), items.front());
+  ASSERT_EQ(makeItem(ITEM_COUNT - 1), items.back());
+
+  uint64_t number = 0;
+  for (const Item& item : items) {
+    ASSERT_EQ(makeItem(number++), item);
+  }
+
+  ASSERT_EQ(ITEM_COUNT, number);
+}
+
+TEST_F(MappedBlobVectorTest, blobIsTheSerializedItem) {
+  MappedBlobVector<Item> items;
+  open(items);
+  fill(items, ITEM_COUNT);
+
+  for (uint64_t i = 0; i < ITEM_COUNT; ++i) {
+    Common::ArrayView<uint8_t> blob = items.getBlob(i);
+    ASSERT_EQ(toBlob(makeItem(i)), std::string(reinterpret_cast<const char*>(blob.getData()), blob.getSize()));
+  }
+}
+
+TEST_F(MappedBlobVectorTest, reopenKeepsItems) {
+  {
+    MappedBlobVector<Item> items;
+    open(items);
+    fill(items, ITEM_COUNT);
+  }
+
+  MappedBlobVector<Item> items;
+  open(items);
+  expectItems(items, ITEM_COUNT);
+
+  items.push_back(makeItem(ITEM_COUNT));
+  expectItems(items, ITEM_COUNT + 1);
+}
+
+TEST_F(MappedBlobVectorTest, popBackRemovesLastItem) {
+  {
+    MappedBlobVector<Item> items;
+    open(items);
+    fill(items, ITEM_COUNT);
+    items.pop_back();
+    items.pop_back();
+    expectItems(items, ITEM_COUNT - 2);
+
+    items.push_back(makeItem(ITEM_COUNT - 2));
+    expectItems(items, ITEM_COUNT - 1);
+  }
+
+  MappedBlobVector<Item> items;
+  open(items);
+  expectItems(items, ITEM_COUNT - 1);
+}
+
+TEST_F(MappedBlobVectorTest, clearRemovesAllItems) {
+  MappedBlobVector<Item> items;
+  open(items);
+  fill(items, ITEM_COUNT);
+  items.clear();
+  ASSERT_TRUE(items.empty());
+
+  fill(items, 3);
+  expectItems(items, 3);
+}
+
+TEST_F(MappedBlobVectorTest, missingOffsetsAreRebuilt) {
+  {
+    MappedBlobVector<Item> items;
+    open(items);
+    fill(items, ITEM_COUNT);
+  }
+
+  ASSERT_TRUE(boost::filesystem::remove(indexesPath + ".offsets"));
+
+  MappedBlobVector<Item> items;
+  open(items);
+  expectItems(items, ITEM_COUNT);
+}
+
+TEST_F(MappedBlobVectorTest, staleOffsetsAreRebuilt) {
+  {
+    MappedBlobVector<Item> items;
+    open(items);
+    fill(items, ITEM_COUNT);
+  }
+
+  std::string offsetsPath = indexesPath + ".offsets";
+  boost::filesystem::copy_file(offsetsPath, offsetsPath + ".old");
+  {
+    MappedBlobVector<Item> items;
+    open(items);
+    items.pop_back();
+    items.push_back(Item{ITEM_COUNT - 1, std::string(1000, 'z')});
+  }
+
+  // offsets of a shorter last item with the right item count
+  boost::filesystem::remove(offsetsPath);
+  boost::filesystem::rename(offsetsPath + ".old", offsetsPath);
+
+  MappedBlobVector<Item> items;
+  open(items);
+  ASSERT_EQ(ITEM_COUNT, items.size());
+  ASSERT_EQ(std::string(1000, 'z'), items.back().text);
+}
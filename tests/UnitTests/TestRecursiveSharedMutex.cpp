@@ -0,0 +1,141 @@
+// Copyright (c) 2011-2017 The Cryptonote developers
+// Copyright (c) 2017-2018 The Circle Foundation & Conceal Devs
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "Common/RecursiveSharedMutex.h"
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+using namespace Tools;
+
+namespace {
+
+// long enough for another thread to block on the mutex
+const std::chrono::milliseconds BLOCK_WAIT(50);
+
+}
+
+TEST(RecursiveSharedMutex, exclusiveLockIsRecursive) {
+  RecursiveSharedMutex mutex;
+  mutex.lock();
+  mutex.lock();
+  mutex.unlock();
+
+  std::atomic<bool> locked(false);
+  std::thread writer([&] {
+    mutex.lock();
+    locked = true;
+    mutex.unlock();
+  });
+
+  std::this_thread::sleep_for(BLOCK_WAIT);
+  ASSERT_FALSE(locked);
+
+  mutex.unlock();
+  writer.join();
+  ASSERT_TRUE(locked);
+}
+
+TEST(RecursiveSharedMutex, exclusiveOwnerMayTakeSharedLock) {
+  RecursiveSharedMutex mutex;
+  mutex.lock();
+  mutex.lock_shared();
+  mutex.unlock_shared();
+
+  std::atomic<bool> locked(false);
+  std::thread reader([&] {
+    SharedLockGuard lock(mutex);
+    locked = true;
+  });
+
+  std::this_thread::sleep_for(BLOCK_WAIT);
+  ASSERT_FALSE(locked);
+
+  mutex.unlock();
+  reader.join();
+  ASSERT_TRUE(locked);
+}
+
+TEST(RecursiveSharedMutex, readersShareTheLock) {
+  RecursiveSharedMutex mutex;
+  SharedLockGuard lock(mutex);
+
+  std::atomic<bool> locked(false);
+  std::thread reader([&] {
+    SharedLockGuard readerLock(mutex);
+    locked = true;
+  });
+
+  reader.join();
+  ASSERT_TRUE(locked);
+}
+
+TEST(RecursiveSharedMutex, sharedLockIsRecursiveWhileWriterWaits) {
+  RecursiveSharedMutex mutex;
+  mutex.lock_shared();
+
+  std::atomic<bool> locked(false);
+  std::thread writer([&] {
+    mutex.lock();
+    locked = true;
+    mutex.unlock();
+  });
+
+  std::this_thread::sleep_for(BLOCK_WAIT);
+  mutex.lock_shared();
+  ASSERT_FALSE(locked);
+
+  mutex.unlock_shared();
+  std::this_thread::sleep_for(BLOCK_WAIT);
+  ASSERT_FALSE(locked);
+
+  mutex.unlock_shared();
+  writer.join();
+  ASSERT_TRUE(locked);
+}
+
+TEST(RecursiveSharedMutex, waitingWriterGoesBeforeNewReaders) {
+  RecursiveSharedMutex mutex;
+  mutex.lock_shared();
+
+  std::atomic<int> order(0);
+  std::atomic<int> writerOrder(0);
+  std::atomic<int> readerOrder(0);
+  std::thread writer([&] {
+    mutex.lock();
+    writerOrder = ++order;
+    mutex.unlock();
+  });
+
+  std::this_thread::sleep_for(BLOCK_WAIT);
+  std::thread reader([&] {
+    SharedLockGuard lock(mutex);
+    readerOrder = ++order;
+  });
+
+  std::this_thread::sleep_for(BLOCK_WAIT);
+  ASSERT_EQ(0, order);
+
+  mutex.unlock_shared();
+  writer.join();
+  reader.join();
+  ASSERT_EQ(1, writerOrder);
+  ASSERT_EQ(2, readerOrder);
+}
+
+TEST(RecursiveSharedMutex, sharedLockCannotBeUpgraded) {
+  RecursiveSharedMutex mutex;
+  SharedLockGuard lock(mutex);
+#ifdef NDEBUG
+  ASSERT_THROW(mutex.lock(), std::logic_error);
+#else
+  ASSERT_DEATH(mutex.lock(), "cannot be upgraded");
+#endif
+}
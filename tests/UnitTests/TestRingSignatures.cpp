@@ -0,0 +1,132 @@
+// Copyright (c) 2011-2017 The Cryptonote developers
+// Copyright (c) 2017-2018 The Circle Foundation & Conceal Devs
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/crypto.h"
+#include "crypto/hash.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace Crypto;
+
+namespace {
+
+const size_t KEY_COUNT = 8;
+
+struct SignedRing {
+  Hash prefixHash;
+  KeyImage image;
+  std::vector<const PublicKey*> pubs;
+  std::vector<Signature> signatures;
+};
+
+class RingSignaturesTest : public ::testing::Test {
+public:
+  RingSignaturesTest() : publicKeys(KEY_COUNT), secretKeys(KEY_COUNT) {
+    for (size_t i = 0; i < KEY_COUNT; ++i) {
+      generate_keys(publicKeys[i], secretKeys[i]);
+    }
+  }
+
+  // Signs with the key at 'members[realIndex]', the other members are decoys.
+  SignedRing sign(const std::string& message, const std::vector<size_t>& members, size_t realIndex) {
+    SignedRing ring;
+    cn_fast_hash(message.data(), message.size(), ring.prefixHash);
+    size_t realKey = members[realIndex];
+    generate_key_image(publicKeys[realKey], secretKeys[realKey], ring.image);
+    for (size_t member : members) {
+      ring.pubs.push_back(&publicKeys[member]);
+    }
+
+    ring.signatures.resize(members.size());
+    generate_ring_signature(ring.prefixHash, ring.image, ring.pubs.data(), ring.pubs.size(), secretKeys[realKey], realIndex,
+      ring.signatures.data());
+    return ring;
+  }
+
+  // Checks the rings in one batch and one by one, the results must agree.
+  std::vector<bool> checkBoth(const std::vector<SignedRing>& rings) {
+    std::vector<RingSignatureBatchItem> items;
+    for (const SignedRing& ring : rings) {
+      items.push_back(RingSignatureBatchItem{&ring.prefixHash, &ring.image, ring.pubs.data(), ring.pubs.size(), ring.signatures.data()});
+    }
+
+    std::unique_ptr<bool[]> batchResults(new bool[rings.size() + 1]);
+    check_ring_signatures(items.data(), items.size(), batchResults.get());
+
+    std::vector<bool> results;
+    for (size_t i = 0; i < rings.size(); ++i) {
+      bool single = check_ring_signature(rings[i].prefixHash, rings[i].image, rings[i].pubs.data(), rings[i].pubs.size(),
+        rings[i].signatures.data());
+      EXPECT_EQ(single, batchResults[i]) << "ring " << i;
+      results.push_back(single);
+    }
+
+    return results;
+  }
+
+  std::vector<PublicKey> publicKeys;
+  std::vector<SecretKey> secretKeys;
+};
+
+}
+
+TEST_F(RingSignaturesTest, validSignaturesPass) {
+  std::vector<SignedRing> rings;
+  rings.push_back(sign("first", {0, 1, 2}, 0));
+  rings.push_back(sign("second", {3}, 0));
+  rings.push_back(sign("third", {4, 5, 6, 7}, 3));
+
+  ASSERT_EQ(std::vector<bool>({true, true, true}), checkBoth(rings));
+}
+
+TEST_F(RingSignaturesTest, sharedRingMembersPass) {
+  std::vector<SignedRing> rings;
+  rings.push_back(sign("first", {0, 1, 2}, 1));
+  rings.push_back(sign("second", {1, 2, 3}, 2));
+  rings.push_back(sign("third", {2, 1, 0}, 0));
+
+  ASSERT_EQ(std::vector<bool>({true, true, true}), checkBoth(rings));
+}
+
+TEST_F(RingSignaturesTest, invalidSignaturesFailWithoutAffectingOthers) {
+  std::vector<SignedRing> rings;
+  rings.push_back(sign("valid", {0, 1, 2}, 0));
+
+  rings.push_back(sign("tampered signature", {1, 2, 3}, 1));
+  rings.back().signatures[1].data[5] ^= 1;
+
+  rings.push_back(sign("wrong prefix", {2, 3, 4}, 2));
+  cn_fast_hash("other", 5, rings.back().prefixHash);
+
+  rings.push_back(sign("wrong image", {3, 4, 5}, 0));
+  generate_key_image(publicKeys[6], secretKeys[6], rings.back().image);
+
+  rings.push_back(sign("swapped member", {4, 5, 6}, 1));
+  rings.back().pubs[0] = &publicKeys[7];
+
+  rings.push_back(sign("also valid", {5, 6, 7}, 2));
+
+  ASSERT_EQ(std::vector<bool>({true, false, false, false, false, true}), checkBoth(rings));
+}
+
+TEST_F(RingSignaturesTest, invalidPointFails) {
+  std::vector<SignedRing> rings;
+  rings.push_back(sign("valid", {0, 1}, 0));
+  rings.push_back(sign("bad image", {2, 3}, 1));
+  for (auto& byte : rings.back().image.data) {
+    byte = 0xff;
+  }
+
+  ASSERT_EQ(std::vector<bool>({true, false}), checkBoth(rings));
+}
+
+TEST_F(RingSignaturesTest, emptyBatch) {
+  ASSERT_TRUE(checkBoth(std::vector<SignedRing>()).empty());
+}
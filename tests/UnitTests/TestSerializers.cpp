@@ -0,0 +1,173 @@
+// Copyright (c) 2011-2017 The Cryptonote developers
+// Copyright (c) 2017-2018 The Circle Foundation & Conceal Devs
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "Serialization/SerializationTools.h"
+#include "Serialization/SerializationOverloads.h"
+#include "CryptoNoteCore/CryptoNoteSerialization.h"
+
+#include <limits>
+
+#include <gtest/gtest.h>
+
+using namespace CryptoNote;
+
+namespace {
+
+struct Inner {
+  uint64_t number;
+  std::string text;
+
+  bool operator==(const Inner& other) const {
+    return number == other.number && text == other.text;
+  }
+
+  void serialize(ISerializer& s) {
+    KV_MEMBER(number)
+    KV_MEMBER(text)
+  }
+};
+
+struct Outer {
+  uint64_t big;
+  int64_t negative;
+  uint32_t small;
+  bool flag;
+  double ratio;
+  std::string text;
+  std::vector<uint32_t> numbers;
+  std::vector<Inner> inners;
+  Inner inner;
+  Crypto::Hash hash;
+  std::string blob;
+
+  bool operator==(const Outer& other) const {
+    return big == other.big && negative == other.negative && small == other.small && flag == other.flag &&
+      ratio == other.ratio && text == other.text && numbers == other.numbers && inners == other.inners &&
+      inner == other.inner && hash == other.hash && blob == other.blob;
+  }
+
+  void serialize(ISerializer& s) {
+    KV_MEMBER(big)
+    KV_MEMBER(negative)
+    KV_MEMBER(small)
+    KV_MEMBER(flag)
+    KV_MEMBER(ratio)
+    KV_MEMBER(text)
+    KV_MEMBER(numbers)
+    KV_MEMBER(inners)
+    KV_MEMBER(inner)
+    KV_MEMBER(hash)
+    s.binary(blob, "blob");
+  }
+};
+
+struct Partial {
+  uint64_t big = 0;
+  std::string text;
+  uint32_t missing = 7;
+
+  void serialize(ISerializer& s) {
+    KV_MEMBER(big)
+    KV_MEMBER(text)
+    KV_MEMBER(missing)
+  }
+};
+
+Outer makeOuter() {
+  Outer outer;
+  outer.big = std::numeric_limits<uint64_t>::max();
+  outer.negative = -1234567890123;
+  outer.small = 42;
+  outer.flag = true;
+  outer.ratio = 0.5;
+  // strings are kept verbatim, escape sequences included
+  outer.text = "line\\nbreak \\\"quoted\\\" \\u00e9";
+  outer.numbers = {0, 1, std::numeric_limits<uint32_t>::max()};
+  outer.inners = {Inner{1, "one"}, Inner{2, ""}, Inner{3, "three"}};
+  outer.inner = Inner{4, "four"};
+  for (size_t i = 0; i < sizeof(outer.hash.data); ++i) {
+    outer.hash.data[i] = static_cast<uint8_t>(i * 7);
+  }
+
+  outer.blob = std::string("\0\x01\xff binary", 10);
+  return outer;
+}
+
+}
+
+TEST(JsonTextSerializers, roundTrip) {
+  Outer outer = makeOuter();
+  std::string json = storeToJson(outer);
+
+  Outer loaded;
+  ASSERT_TRUE(loadFromJson(loaded, json));
+  ASSERT_EQ(outer, loaded);
+}
+
+TEST(JsonTextSerializers, matchJsonValueSerializers) {
+  Outer outer = makeOuter();
+  std::string json = storeToJson(outer);
+  // JsonValue keeps object members sorted by name
+  ASSERT_EQ(storeToJsonValue(outer).toString(), Common::JsonValue::fromString(json).toString());
+
+  // JsonInputValueSerializer reads every number as an integer, leave the double out
+  Common::JsonValue value = Common::JsonValue::fromString(json);
+  ASSERT_EQ(1, value.erase("ratio"));
+  Outer loaded;
+  loaded.ratio = outer.ratio;
+  loadFromJsonValue(loaded, value);
+  ASSERT_EQ(outer, loaded);
+}
+
+TEST(JsonTextSerializers, readsTextWithWhiteSpace) {
+  Inner inner;
+  ASSERT_TRUE(loadFromJson(inner, " {\n  \"text\" : \"spaced\" ,\n  \"number\" : 12\n}\n"));
+  ASSERT_EQ(Inner({12, "spaced"}), inner);
+}
+
+TEST(JsonTextSerializers, skipsUnknownAndKeepsMissingFields) {
+  Partial partial;
+  ASSERT_TRUE(loadFromJson(partial, "{\"unknown\":{\"a\":[1,{\"b\":\"}\"}]},\"text\":\"value\",\"big\":5}"));
+  ASSERT_EQ(5, partial.big);
+  ASSERT_EQ("value", partial.text);
+  ASSERT_EQ(7, partial.missing);
+}
+
+TEST(JsonTextSerializers, rejectsMalformedText) {
+  Inner inner;
+  ASSERT_FALSE(loadFromJson(inner, "{\"number\":12,\"text\":\"unterminated}"));
+  ASSERT_FALSE(loadFromJson(inner, "[1, 2]"));
+  ASSERT_FALSE(loadFromJson(inner, "{\"number\":\"text\"}"));
+}
+
+TEST(KVBinarySerializers, roundTrip) {
+  Outer outer = makeOuter();
+  std::string buffer = storeToBinaryKeyValue(outer);
+
+  Outer loaded;
+  ASSERT_TRUE(loadFromBinaryKeyValue(loaded, buffer));
+  ASSERT_EQ(outer, loaded);
+}
+
+TEST(KVBinarySerializers, keepsMissingFields) {
+  Inner inner{9, "nine"};
+  std::string buffer = storeToBinaryKeyValue(inner);
+
+  Partial partial;
+  partial.big = 3;
+  ASSERT_TRUE(loadFromBinaryKeyValue(partial, buffer));
+  ASSERT_EQ(3, partial.big);
+  ASSERT_EQ("nine", partial.text);
+  ASSERT_EQ(7, partial.missing);
+}
+
+TEST(KVBinarySerializers, rejectsTruncatedInput) {
+  std::string buffer = storeToBinaryKeyValue(makeOuter());
+  for (size_t size = 0; size < buffer.size(); ++size) {
+    Outer loaded;
+    ASSERT_FALSE(loadFromBinaryKeyValue(loaded, buffer.substr(0, size))) << "size " << size;
+  }
+}